@@ -0,0 +1,741 @@
+/*
+ * GStreamer
+ * Copyright (C) 2005 Thomas Vander Stichele <thomas@apestaart.org>
+ * Copyright (C) 2005 Ronald S. Bultje <rbultje@ronald.bitfreak.net>
+ * Copyright (C) 2012 Simon Berg <ksb@users.sourceforge.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:audio-denoise
+ *
+ * Remove steady room noise by spectral subtraction
+ *
+ * <refsect2>
+ *
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/gst.h>
+
+#include "audiodenoise.h"
+#include "simd.h"
+#include <math.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC (audio_denoise_debug);
+#define GST_CAT_DEFAULT audio_denoise_debug
+
+#define DEFAULT_NOISE_LENGTH 0
+#define DEFAULT_LEAD_IN 0
+#define DEFAULT_REDUCTION 12.0
+
+/* Frames are at least this long, rounded up to a power of two */
+#define FRAME_TIME (20 * GST_MSECOND)
+/* The noise is scaled by this before subtracting, since it is often
+   above its mean */
+#define OVER_SUBTRACTION 2.0
+/* A falling gain keeps this much of its last value, so that bins
+   don't flicker in and out as musical noise */
+#define GAIN_RELEASE 0.5
+
+enum
+{
+  PROP_0 = 0,
+  PROP_NOISE_LENGTH,
+  PROP_LEAD_IN,
+  PROP_REDUCTION
+};
+
+#define AUDIO_PAD_CAPS "audio/x-raw-float,"	\
+"rate=(int)[ 8000, 192000 ],"			\
+"channels=(int)[ 1, 8 ],"			\
+"endianness= (int) BYTE_ORDER,"			\
+"width=(int)32"
+
+static GstStaticPadTemplate sink_factory =
+  GST_STATIC_PAD_TEMPLATE ("sink",
+			   GST_PAD_SINK,
+			   GST_PAD_ALWAYS,
+			   GST_STATIC_CAPS(AUDIO_PAD_CAPS) );
+
+static GstStaticPadTemplate src_factory =
+  GST_STATIC_PAD_TEMPLATE ("src",
+			   GST_PAD_SRC,
+			   GST_PAD_ALWAYS,
+			   GST_STATIC_CAPS(AUDIO_PAD_CAPS) );
+
+
+#define DEBUG_INIT(bla) \
+  GST_DEBUG_CATEGORY_INIT (audio_denoise_debug, "plugin", 0, "Audio denoise plugin");
+
+GST_BOILERPLATE_FULL (AudioDenoise, audio_denoise, GstElement,
+		      GST_TYPE_ELEMENT, DEBUG_INIT)
+
+/* Forward declarations */
+static void audio_denoise_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void audio_denoise_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static gboolean audio_denoise_set_sink_caps (GstPad * pad, GstCaps * caps);
+static GstFlowReturn audio_denoise_chain (GstPad * pad, GstBuffer * buf);
+static gboolean audio_denoise_event (GstPad * pad, GstEvent *event);
+static GstStateChangeReturn
+audio_denoise_change_state (GstElement *element, GstStateChange transition);
+
+static void
+free_stream(AudioDenoise *filter)
+{
+  guint c;
+  fft_free(filter->fft);
+  filter->fft = NULL;
+  g_free(filter->window);
+  filter->window = NULL;
+  g_free(filter->spectrum_re);
+  filter->spectrum_re = NULL;
+  g_free(filter->spectrum_im);
+  filter->spectrum_im = NULL;
+  g_free(filter->work);
+  filter->work = NULL;
+  for (c = 0; c < AUDIO_DENOISE_MAX_CHANNELS; c++) {
+    g_free(filter->noise[c]);
+    filter->noise[c] = NULL;
+    g_free(filter->gain[c]);
+    filter->gain[c] = NULL;
+    g_free(filter->input[c]);
+    filter->input[c] = NULL;
+    g_free(filter->output[c]);
+    filter->output[c] = NULL;
+  }
+}
+
+static gfloat
+gain_floor(AudioDenoise *filter)
+{
+  return pow(10, -filter->reduction / 20);
+}
+
+/* Start over, keeping the buffers for the current caps */
+static void
+reset_stream(AudioDenoise *filter)
+{
+  guint bins = filter->frame_length / 2 + 1;
+  gfloat floor = gain_floor(filter);
+  gint c;
+  filter->input_fill = 0;
+  filter->learned = FALSE;
+  filter->passthrough = FALSE;
+  g_array_set_size(filter->pending, 0);
+  g_array_set_size(filter->produced, 0);
+  filter->base_ts = GST_CLOCK_TIME_NONE;
+  filter->samples_in = 0;
+  filter->emitted = 0;
+  filter->samples_out = 0;
+  filter->lead_in_frames = 0;
+  filter->dropped = 0;
+  if (!filter->fft) return;
+  for (c = 0; c < filter->channels; c++) {
+    guint i;
+    /* The stream starts with noise */
+    for (i = 0; i < bins; i++) filter->gain[c][i] = floor;
+    memset(filter->input[c], 0, filter->frame_length * sizeof(gfloat));
+    memset(filter->output[c], 0, filter->frame_length * sizeof(gfloat));
+  }
+}
+
+static void
+setup_stream(AudioDenoise *filter)
+{
+  guint frame = 16;
+  guint bins;
+  guint i;
+  gint c;
+  free_stream(filter);
+  while (frame < gst_util_uint64_scale(FRAME_TIME, filter->sample_rate,
+				       GST_SECOND)) {
+    frame *= 2;
+  }
+  bins = frame / 2 + 1;
+  filter->frame_length = frame;
+  filter->hop = frame / 2;
+  filter->fft = fft_new(frame);
+  /* Squared, it's a Hann window, and those overlapping by half sum to
+     one */
+  filter->window = g_new(gfloat, frame);
+  for (i = 0; i < frame; i++) {
+    filter->window[i] = sqrt(0.5 - 0.5 * cos(2 * G_PI * i / frame));
+  }
+  filter->spectrum_re = g_new(gfloat, bins);
+  filter->spectrum_im = g_new(gfloat, bins);
+  filter->work = g_new(gfloat, frame);
+  for (c = 0; c < filter->channels; c++) {
+    filter->noise[c] = g_new0(gfloat, bins);
+    filter->gain[c] = g_new(gfloat, bins);
+    filter->input[c] = g_new(gfloat, frame);
+    filter->output[c] = g_new(gfloat, frame);
+  }
+  reset_stream(filter);
+}
+
+/* GObject vmethod implementations */
+static void
+audio_denoise_finalize (GObject *obj)
+{
+  AudioDenoise *filter = AUDIO_DENOISE (obj);
+  free_stream(filter);
+  g_array_free(filter->pending, TRUE);
+  g_array_free(filter->produced, TRUE);
+  G_OBJECT_CLASS (parent_class)->finalize (obj);
+}
+
+static void
+audio_denoise_base_init (gpointer gclass)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS (gclass);
+
+  gst_element_class_set_details_simple(element_class,
+				       "Noise reduction",
+				       "Filter/Effect/Audio",
+				       "Remove steady noise learned from the "
+				       "start of the stream",
+				       "Simon Berg <ksb@users.sourceforge.net>");
+
+  gst_element_class_add_pad_template(element_class,
+				     gst_static_pad_template_get(&sink_factory));
+  gst_element_class_add_pad_template(element_class,
+				     gst_static_pad_template_get(&src_factory));
+}
+
+static void
+audio_denoise_class_init (AudioDenoiseClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GParamSpec *pspec;
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+
+  gobject_class->set_property = audio_denoise_set_property;
+  gobject_class->get_property = audio_denoise_get_property;
+  gobject_class->finalize = audio_denoise_finalize;
+  gstelement_class->change_state = audio_denoise_change_state;
+
+  /* noise-length */
+  pspec = g_param_spec_uint64 ("noise-length",
+			       "Length of noise",
+			       "Length of the noise at the start of the stream "
+			       "to learn from, in ns. 0 passes the stream "
+			       "through unchanged.",
+			       0, G_MAXUINT64, DEFAULT_NOISE_LENGTH,
+			       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property(gobject_class, PROP_NOISE_LENGTH, pspec);
+
+  /* lead-in */
+  pspec = g_param_spec_uint64 ("lead-in",
+			       "Lead-in",
+			       "Length at the start of the stream that is "
+			       "only learned from and not output, in ns",
+			       0, G_MAXUINT64, DEFAULT_LEAD_IN,
+			       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property(gobject_class, PROP_LEAD_IN, pspec);
+
+  /* reduction */
+  pspec = g_param_spec_double ("reduction",
+			       "Noise reduction",
+			       "Largest attenuation of noise, in dB",
+			       0.0, 60.0, DEFAULT_REDUCTION,
+			       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property(gobject_class, PROP_REDUCTION, pspec);
+}
+
+static void
+audio_denoise_init (AudioDenoise * filter,
+		    AudioDenoiseClass * gclass)
+{
+  guint c;
+  filter->sinkpad = gst_pad_new_from_static_template (&sink_factory, "sink");
+  gst_pad_set_setcaps_function (filter->sinkpad,
+                                GST_DEBUG_FUNCPTR(audio_denoise_set_sink_caps));
+  gst_pad_set_getcaps_function (filter->sinkpad,
+                                GST_DEBUG_FUNCPTR(gst_pad_proxy_getcaps));
+  gst_pad_set_chain_function (filter->sinkpad,
+                              GST_DEBUG_FUNCPTR(audio_denoise_chain));
+  gst_pad_set_event_function (filter->sinkpad,
+			      GST_DEBUG_FUNCPTR(audio_denoise_event));
+  gst_element_add_pad (GST_ELEMENT (filter), filter->sinkpad);
+
+  filter->srcpad = gst_pad_new_from_static_template (&src_factory, "src");
+  gst_pad_set_getcaps_function (filter->srcpad,
+                                GST_DEBUG_FUNCPTR(gst_pad_proxy_getcaps));
+  gst_element_add_pad (GST_ELEMENT (filter), filter->srcpad);
+
+  filter->sample_rate = 48000;
+  filter->channels = 1;
+  filter->noise_length = DEFAULT_NOISE_LENGTH;
+  filter->lead_in = DEFAULT_LEAD_IN;
+  filter->reduction = DEFAULT_REDUCTION;
+  filter->fft = NULL;
+  filter->frame_length = 0;
+  filter->hop = 0;
+  filter->window = NULL;
+  filter->spectrum_re = NULL;
+  filter->spectrum_im = NULL;
+  filter->work = NULL;
+  for (c = 0; c < AUDIO_DENOISE_MAX_CHANNELS; c++) {
+    filter->noise[c] = NULL;
+    filter->gain[c] = NULL;
+    filter->input[c] = NULL;
+    filter->output[c] = NULL;
+  }
+  filter->pending = g_array_new(FALSE, FALSE, sizeof(gfloat));
+  filter->produced = g_array_new(FALSE, FALSE, sizeof(gfloat));
+  reset_stream(filter);
+}
+
+static void
+audio_denoise_set_property (GObject * object, guint prop_id,
+			    const GValue * value, GParamSpec * pspec)
+{
+  AudioDenoise *filter = AUDIO_DENOISE (object);
+
+  switch (prop_id) {
+  case PROP_NOISE_LENGTH:
+    filter->noise_length = g_value_get_uint64(value);
+    break;
+  case PROP_LEAD_IN:
+    filter->lead_in = g_value_get_uint64(value);
+    break;
+  case PROP_REDUCTION:
+    filter->reduction = g_value_get_double(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+audio_denoise_get_property (GObject * object, guint prop_id,
+			    GValue * value, GParamSpec * pspec)
+{
+  AudioDenoise *filter = AUDIO_DENOISE (object);
+
+  switch (prop_id) {
+  case PROP_NOISE_LENGTH:
+    g_value_set_uint64 (value, filter->noise_length);
+    break;
+  case PROP_LEAD_IN:
+    g_value_set_uint64 (value, filter->lead_in);
+    break;
+  case PROP_REDUCTION:
+    g_value_set_double (value, filter->reduction);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    break;
+  }
+}
+
+/* GstElement vmethod implementations */
+
+static gboolean
+audio_denoise_set_sink_caps (GstPad * pad, GstCaps * caps)
+{
+  AudioDenoise *filter;
+  GstStructure *caps_struct = gst_caps_get_structure (caps, 0);
+  filter = AUDIO_DENOISE (GST_OBJECT_PARENT (pad));
+  if (!gst_structure_get_int(caps_struct, "rate", &filter->sample_rate)
+      || !gst_structure_get_int(caps_struct, "channels", &filter->channels)) {
+    return FALSE;
+  }
+  if (!gst_pad_set_caps(filter->srcpad, caps)) return FALSE;
+  setup_stream(filter);
+  return TRUE;
+}
+
+static GstStateChangeReturn
+audio_denoise_change_state (GstElement *element, GstStateChange transition)
+{
+  AudioDenoise *filter = AUDIO_DENOISE (element);
+  switch(transition) {
+  case GST_STATE_CHANGE_READY_TO_PAUSED:
+    reset_stream(filter);
+    break;
+  default:
+    break;
+  }
+  return GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+}
+
+static void
+multiply(gfloat *out, const gfloat *a, const gfloat *b, guint n)
+{
+  guint i = 0;
+#ifdef HAVE_V4SF
+  for (; i + 4 <= n; i += 4) {
+    v4sf_store(out + i, v4sf_load(a + i) * v4sf_load(b + i));
+  }
+#endif
+  for (; i < n; i++) {
+    out[i] = a[i] * b[i];
+  }
+}
+
+static void
+multiply_add(gfloat *acc, const gfloat *a, const gfloat *b, guint n)
+{
+  guint i = 0;
+#ifdef HAVE_V4SF
+  for (; i + 4 <= n; i += 4) {
+    v4sf_store(acc + i,
+	       v4sf_load(acc + i) + v4sf_load(a + i) * v4sf_load(b + i));
+  }
+#endif
+  for (; i < n; i++) {
+    acc[i] += a[i] * b[i];
+  }
+}
+
+static void
+add_power(gfloat *acc, const gfloat *re, const gfloat *im, guint n)
+{
+  guint i = 0;
+#ifdef HAVE_V4SF
+  for (; i + 4 <= n; i += 4) {
+    v4sf r = v4sf_load(re + i);
+    v4sf m = v4sf_load(im + i);
+    v4sf_store(acc + i, v4sf_load(acc + i) + r * r + m * m);
+  }
+#endif
+  for (; i < n; i++) {
+    acc[i] += re[i] * re[i] + im[i] * im[i];
+  }
+}
+
+/* Attenuate each bin by the part of its power that is noise. The gain
+   follows a rise at once but falls slowly. */
+static void
+subtract_noise(gfloat *gain, const gfloat *noise, gfloat *re, gfloat *im,
+	       guint n, gfloat floor)
+{
+  guint i = 0;
+#ifdef HAVE_V4SF
+  const v4sf one = v4sf_set1(1.0);
+  const v4sf tiny = v4sf_set1(1e-20);
+  const v4sf vfloor = v4sf_set1(floor);
+  const v4sf release = v4sf_set1(GAIN_RELEASE);
+  for (; i + 4 <= n; i += 4) {
+    v4sf r = v4sf_load(re + i);
+    v4sf m = v4sf_load(im + i);
+    v4sf power = r * r + m * m + tiny;
+    v4sf g = v4sf_max(one - v4sf_load(noise + i) / power, vfloor);
+    g = v4sf_max(g, g + release * (v4sf_load(gain + i) - g));
+    v4sf_store(gain + i, g);
+    v4sf_store(re + i, r * g);
+    v4sf_store(im + i, m * g);
+  }
+#endif
+  for (; i < n; i++) {
+    gfloat power = re[i] * re[i] + im[i] * im[i] + 1e-20;
+    gfloat g = MAX(1.0 - noise[i] / power, floor);
+    g = MAX(g, g + GAIN_RELEASE * (gain[i] - g));
+    gain[i] = g;
+    re[i] *= g;
+    im[i] *= g;
+  }
+}
+
+/* Mean power spectrum of the frames that fit in n samples. Returns
+   FALSE if there isn't a single frame. */
+static gboolean
+learn_noise(AudioDenoise *filter, const gfloat *data, gsize n)
+{
+  guint frame = filter->frame_length;
+  guint bins = frame / 2 + 1;
+  guint frames = 0;
+  gsize start;
+  gint c;
+  for (c = 0; c < filter->channels; c++) {
+    memset(filter->noise[c], 0, bins * sizeof(gfloat));
+  }
+  for (start = 0; start + frame <= n; start += filter->hop) {
+    for (c = 0; c < filter->channels; c++) {
+      guint i;
+      for (i = 0; i < frame; i++) {
+	filter->work[i] = (data[(start + i) * filter->channels + c]
+			   * filter->window[i]);
+      }
+      fft_forward_real(filter->fft, filter->work,
+		       filter->spectrum_re, filter->spectrum_im);
+      add_power(filter->noise[c], filter->spectrum_re, filter->spectrum_im,
+		bins);
+    }
+    frames++;
+  }
+  if (frames == 0) return FALSE;
+  for (c = 0; c < filter->channels; c++) {
+    guint i;
+    for (i = 0; i < bins; i++) {
+      filter->noise[c][i] *= OVER_SUBTRACTION / frames;
+    }
+  }
+  GST_DEBUG_OBJECT(filter, "Learned noise from %u frames", frames);
+  return TRUE;
+}
+
+/* Run the last frame of input through the filter and move the hop
+   that is complete to the output. The first hop out is the zeros the
+   input started with, and is dropped. */
+static void
+process_frame(AudioDenoise *filter)
+{
+  guint frame = filter->frame_length;
+  guint hop = filter->hop;
+  guint bins = frame / 2 + 1;
+  gfloat floor = gain_floor(filter);
+  guint skip = 0;
+  guint count = hop;
+  gint c;
+  for (c = 0; c < filter->channels; c++) {
+    multiply(filter->work, filter->input[c], filter->window, frame);
+    fft_forward_real(filter->fft, filter->work,
+		     filter->spectrum_re, filter->spectrum_im);
+    subtract_noise(filter->gain[c], filter->noise[c],
+		   filter->spectrum_re, filter->spectrum_im, bins, floor);
+    fft_inverse_real(filter->fft, filter->spectrum_re, filter->spectrum_im,
+		     filter->work);
+    multiply_add(filter->output[c], filter->work, filter->window, frame);
+    memmove(filter->input[c], filter->input[c] + hop, hop * sizeof(gfloat));
+  }
+
+  if (filter->emitted < hop) skip = hop - filter->emitted;
+  /* Padding added at the end isn't output */
+  if (filter->emitted + count > filter->samples_in + hop) {
+    count = filter->samples_in + hop - filter->emitted;
+  }
+  if (count > skip) {
+    guint old_len = filter->produced->len;
+    gfloat *out;
+    guint i;
+    g_array_set_size(filter->produced,
+		     old_len + (count - skip) * filter->channels);
+    out = &g_array_index(filter->produced, gfloat, old_len);
+    for (i = skip; i < count; i++) {
+      for (c = 0; c < filter->channels; c++) {
+	*out++ = filter->output[c][i];
+      }
+    }
+  }
+  for (c = 0; c < filter->channels; c++) {
+    memmove(filter->output[c], filter->output[c] + hop, hop * sizeof(gfloat));
+    memset(filter->output[c] + hop, 0, hop * sizeof(gfloat));
+  }
+  filter->emitted += hop;
+  filter->input_fill = 0;
+}
+
+static void
+feed(AudioDenoise *filter, const gfloat *data, gsize n)
+{
+  gint channels = filter->channels;
+  guint hop = filter->hop;
+  filter->samples_in += n;
+  while (n > 0) {
+    guint m = MIN(hop - filter->input_fill, n);
+    gint c;
+    for (c = 0; c < channels; c++) {
+      gfloat *in = filter->input[c] + hop + filter->input_fill;
+      guint i;
+      for (i = 0; i < m; i++) in[i] = data[i * channels + c];
+    }
+    filter->input_fill += m;
+    data += m * channels;
+    n -= m;
+    if (filter->input_fill == hop) process_frame(filter);
+  }
+}
+
+static GstFlowReturn
+push_produced(AudioDenoise *filter)
+{
+  GstBuffer *buf;
+  guint64 n;
+  if (filter->dropped < filter->lead_in_frames) {
+    guint64 skip = MIN(filter->produced->len / filter->channels,
+		       filter->lead_in_frames - filter->dropped);
+    g_array_remove_range(filter->produced, 0, skip * filter->channels);
+    filter->dropped += skip;
+  }
+  if (filter->produced->len == 0) return GST_FLOW_OK;
+  n = filter->produced->len / filter->channels;
+  buf = gst_buffer_new_and_alloc(filter->produced->len * sizeof(gfloat));
+  memcpy(GST_BUFFER_DATA(buf), filter->produced->data,
+	 filter->produced->len * sizeof(gfloat));
+  gst_buffer_set_caps(buf, GST_PAD_CAPS(filter->srcpad));
+  GST_BUFFER_TIMESTAMP(buf) =
+    filter->base_ts + gst_util_uint64_scale(filter->samples_out, GST_SECOND,
+					    filter->sample_rate);
+  GST_BUFFER_DURATION(buf) =
+    (filter->base_ts + gst_util_uint64_scale(filter->samples_out + n,
+					     GST_SECOND, filter->sample_rate)
+     - GST_BUFFER_TIMESTAMP(buf));
+  GST_BUFFER_OFFSET(buf) = filter->samples_out;
+  GST_BUFFER_OFFSET_END(buf) = filter->samples_out + n;
+  filter->samples_out += n;
+  g_array_set_size(filter->produced, 0);
+  return gst_pad_push(filter->srcpad, buf);
+}
+
+/* Learn the noise from what has been held back and let it through */
+static GstFlowReturn
+flush_pending(AudioDenoise *filter)
+{
+  const gfloat *data = (const gfloat*)filter->pending->data;
+  gsize n = filter->pending->len / filter->channels;
+  gsize noise = gst_util_uint64_scale(filter->noise_length,
+				      filter->sample_rate, GST_SECOND);
+  filter->learned = TRUE;
+  if (learn_noise(filter, data, MIN(noise, n))) {
+    feed(filter, data, n);
+  } else {
+    GST_DEBUG_OBJECT(filter, "Too little noise to learn from");
+    filter->passthrough = TRUE;
+    g_array_append_vals(filter->produced, data, filter->pending->len);
+  }
+  g_array_set_size(filter->pending, 0);
+  return push_produced(filter);
+}
+
+/* Pad the end with silence until all input is out */
+static GstFlowReturn
+drain(AudioDenoise *filter)
+{
+  guint hop = filter->hop;
+  while (filter->emitted < filter->samples_in + hop) {
+    gint c;
+    for (c = 0; c < filter->channels; c++) {
+      memset(filter->input[c] + hop + filter->input_fill, 0,
+	     (hop - filter->input_fill) * sizeof(gfloat));
+    }
+    process_frame(filter);
+  }
+  return push_produced(filter);
+}
+
+/* chain function
+ * this function does the actual processing
+ */
+static GstFlowReturn
+audio_denoise_chain (GstPad * pad, GstBuffer * buf)
+{
+  AudioDenoise *filter = AUDIO_DENOISE (GST_OBJECT_PARENT (pad));
+  const gfloat *data;
+  gsize n;
+  if (!filter->fft) {
+    gst_buffer_unref(buf);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+  if (!GST_CLOCK_TIME_IS_VALID(filter->base_ts)) {
+    filter->base_ts = (GST_BUFFER_TIMESTAMP_IS_VALID(buf)
+		       ? GST_BUFFER_TIMESTAMP(buf) : 0);
+    filter->lead_in_frames = gst_util_uint64_scale(filter->lead_in,
+						   filter->sample_rate,
+						   GST_SECOND);
+    if (filter->noise_length == 0) filter->passthrough = TRUE;
+  }
+  if (filter->passthrough && filter->lead_in_frames == 0) {
+    return gst_pad_push(filter->srcpad, buf);
+  }
+  data = (const gfloat*)GST_BUFFER_DATA(buf);
+  n = GST_BUFFER_SIZE(buf) / (filter->channels * sizeof(gfloat));
+  if (filter->passthrough) {
+    /* Restamped, since the lead-in is cut away */
+    g_array_append_vals(filter->produced, data, n * filter->channels);
+    gst_buffer_unref(buf);
+    return push_produced(filter);
+  }
+  if (!filter->learned) {
+    gsize noise = gst_util_uint64_scale(filter->noise_length,
+					filter->sample_rate, GST_SECOND);
+    g_array_append_vals(filter->pending, data, n * filter->channels);
+    gst_buffer_unref(buf);
+    if (filter->pending->len / filter->channels < noise) return GST_FLOW_OK;
+    return flush_pending(filter);
+  }
+  feed(filter, data, n);
+  gst_buffer_unref(buf);
+  return push_produced(filter);
+}
+
+static gboolean
+audio_denoise_event (GstPad * pad, GstEvent *event)
+{
+  AudioDenoise *filter = AUDIO_DENOISE (GST_OBJECT_PARENT (pad));
+  switch (GST_EVENT_TYPE(event)) {
+  case GST_EVENT_EOS:
+    if (filter->fft && GST_CLOCK_TIME_IS_VALID(filter->base_ts)
+	&& !filter->passthrough) {
+      if (!filter->learned) flush_pending(filter);
+      if (!filter->passthrough) drain(filter);
+    }
+    break;
+  case GST_EVENT_FLUSH_STOP:
+    reset_stream(filter);
+    break;
+  default:
+    break;
+  }
+  return gst_pad_event_default (pad, event);
+}
+
+gboolean
+audio_denoise_plugin_init (GstPlugin *plugin)
+{
+  GST_DEBUG_CATEGORY_INIT (audio_denoise_debug, "audiodenoise",
+      0, "Audio denoise");
+
+  return gst_element_register (plugin, "audiodenoise", GST_RANK_NONE,
+			       GST_TYPE_AUDIO_DENOISE);
+}
@@ -0,0 +1,87 @@
+#ifndef __AUDIO_DENOISE_H__V2QX7NB4LS__
+#define __AUDIO_DENOISE_H__V2QX7NB4LS__
+
+#include <gst/gst.h>
+#include "fft.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_AUDIO_DENOISE \
+  (audio_denoise_get_type())
+#define AUDIO_DENOISE(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_AUDIO_DENOISE,AudioDenoise))
+#define AUDIO_DENOISE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_AUDIO_DENOISE,AudioDenoiseClass))
+#define IS_AUDIO_DENOISE(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_AUDIO_DENOISE))
+#define IS_AUDIO_DENOISE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_AUDIO_DENOISE))
+
+typedef struct _AudioDenoise      AudioDenoise;
+typedef struct _AudioDenoiseClass AudioDenoiseClass;
+
+#define AUDIO_DENOISE_MAX_CHANNELS 8
+
+/* Spectral subtraction. The first noise-length of the stream is
+   expected to contain only room noise, as the silence before speech
+   in a raw take. Its spectrum is learned before anything is output,
+   then subtracted from the whole stream. The first lead-in of the
+   stream is only learned from and isn't output, so more silence can
+   be used than is kept in front of the clip. */
+struct _AudioDenoise
+{
+  GstElement element;
+  GstPad *sinkpad, *srcpad;
+
+  /* Stream properties */
+  gint sample_rate;
+  gint channels;
+
+  /* Properties */
+  GstClockTime noise_length;
+  GstClockTime lead_in;
+  gdouble reduction; /* Largest attenuation, in dB */
+
+  /* Frames of frame_length samples, overlapping by half */
+  Fft *fft;
+  guint frame_length;
+  guint hop;
+  gfloat *window; /* Square root of a Hann window, used twice */
+  gfloat *spectrum_re;
+  gfloat *spectrum_im;
+  gfloat *work;
+  /* Per channel, frame_length / 2 + 1 bins */
+  gfloat *noise[AUDIO_DENOISE_MAX_CHANNELS]; /* Mean power */
+  gfloat *gain[AUDIO_DENOISE_MAX_CHANNELS]; /* Of the last frame */
+  /* Per channel, frame_length samples */
+  gfloat *input[AUDIO_DENOISE_MAX_CHANNELS]; /* Last frame of input */
+  gfloat *output[AUDIO_DENOISE_MAX_CHANNELS]; /* Overlap-add */
+  guint input_fill; /* New samples since the last frame */
+
+  gboolean learned; /* The noise profile is ready */
+  gboolean passthrough; /* No usable noise, stream is untouched */
+  GArray *pending; /* Interleaved input waiting for the profile */
+  GArray *produced; /* Interleaved output for the next buffer */
+
+  GstClockTime base_ts; /* Timestamp of the first input */
+  guint64 samples_in; /* Frames received */
+  guint64 emitted; /* Frames out of the overlap-add, including the
+		      leading hop that is dropped */
+  guint64 samples_out; /* Frames pushed */
+  guint64 lead_in_frames;
+  guint64 dropped; /* Frames of the lead-in dropped so far */
+};
+
+struct _AudioDenoiseClass
+{
+  GstElementClass parent_class;
+};
+
+GType audio_denoise_get_type (void);
+
+gboolean
+audio_denoise_plugin_init (GstPlugin *plugin);
+
+G_END_DECLS
+
+#endif /* __AUDIO_DENOISE_H__V2QX7NB4LS__ */
@@ -58,8 +58,10 @@
 #endif
 
 #include <gst/gst.h>
+#include <gst/audio/multichannel.h>
 
 #include "audiormspower.h"
+#include "simd.h"
 #include <math.h>
 #include <string.h>
 
@@ -68,11 +70,18 @@ GST_DEBUG_CATEGORY_STATIC (audio_rms_power_debug);
 
 static GQuark sub_block_message_quark = 0;
 static GQuark sub_block_power_quark = 0;
+static GQuark sub_block_peak_quark = 0;
+static GQuark sub_block_true_peak_quark = 0;
+static GQuark sub_block_channel_powers_quark = 0;
+static GQuark sub_block_channel_true_peaks_quark = 0;
 
 static GQuark analysis_message_quark = 0;
 static GQuark analysis_loudness_quark = 0;
 static GQuark analysis_trim_start_quark = 0;
 static GQuark analysis_trim_end_quark = 0;
+static GQuark analysis_speech_start_quark = 0;
+static GQuark analysis_sample_peak_quark = 0;
+static GQuark analysis_true_peak_quark = 0;
 
 
 
@@ -88,7 +97,9 @@ enum
 #define DEFAULT_SUB_BLOCK_MESSAGE FALSE
 #define DEFAULT_ANALYSIS_MESSAGE FALSE
 #define DEFAULT_TRIM_LEVEL 0.1
+#define DEFAULT_TRIM_MODE AUDIO_RMS_POWER_TRIM_MODE_VOICE
 #define DEFAULT_REGENERATE_TIMESTAMPS TRUE
+#define DEFAULT_METER_INTERVAL 0
 
 enum
 {
@@ -99,17 +110,37 @@ enum
   PROP_SUB_BLOCK_MESSAGE, /* Post a power level message for each sub block */
   PROP_ANALYSIS_MESSAGE, /* Post a analysis message at EOF */
   PROP_TRIM_LEVEL, /* Power level used for trimming */
-  PROP_POWER_BUFFERS /* A GList of GstBuffer containing power values for
+  PROP_TRIM_MODE,
+  PROP_POWER_BUFFERS, /* A GList of GstBuffer containing power values for
 			the last analysis */
+  PROP_METER_INTERVAL, /* Write meter values this often */
+  PROP_METER_RING /* Ring buffer receiving meter values */
 };
 
+/* Integer input is analyzed as is, saving a conversion to float and
+   back when the stream is recorded as integers. Channels are
+   interleaved. */
 #define AUDIO_PAD_CAPS "audio/x-raw-float,"	\
-"rate=(int)48000,"				\
-"channels= (int) 1,"				\
+"rate=(int)[ 8000, 192000 ],"				\
+"channels=(int)[ 1, 8 ],"			\
 "endianness= (int) BYTE_ORDER,"			\
 "signed=(boolean)TRUE,"				\
 "width=(int)32,"				\
-  "depth=(int)32"
+"depth=(int)32;"				\
+"audio/x-raw-int,"				\
+"rate=(int)[ 8000, 192000 ],"				\
+"channels=(int)[ 1, 8 ],"			\
+"endianness=(int){ LITTLE_ENDIAN, BIG_ENDIAN },"	\
+"signed=(boolean)TRUE,"				\
+"width=(int)16,"				\
+"depth=(int)16;"				\
+"audio/x-raw-int,"				\
+"rate=(int)[ 8000, 192000 ],"				\
+"channels=(int)[ 1, 8 ],"			\
+"endianness=(int){ LITTLE_ENDIAN, BIG_ENDIAN },"	\
+"signed=(boolean)TRUE,"				\
+"width=(int)32,"				\
+"depth=(int)32"
 
 static GstStaticPadTemplate sink_factory =
   GST_STATIC_PAD_TEMPLATE ("sink",
@@ -129,6 +160,25 @@ static GstStaticPadTemplate src_factory =
 
 GST_BOILERPLATE_FULL (AudioRmsPower, audio_rms_power, GstBaseTransform,
 		      GST_TYPE_BASE_TRANSFORM, DEBUG_INIT)
+
+#define AUDIO_RMS_POWER_TYPE_TRIM_MODE (audio_rms_power_trim_mode_get_type())
+static GType
+audio_rms_power_trim_mode_get_type (void)
+{
+  static GType trim_mode_type = 0;
+  static const GEnumValue trim_modes[] = {
+    {AUDIO_RMS_POWER_TRIM_MODE_POWER, "Power above trim level", "power"},
+    {AUDIO_RMS_POWER_TRIM_MODE_VOICE, "Voice activity", "voice"},
+    {0, NULL, NULL},
+  };
+
+  if (G_UNLIKELY (trim_mode_type == 0)) {
+    trim_mode_type = g_enum_register_static ("AudioRmsPowerTrimMode",
+					     trim_modes);
+  }
+  return trim_mode_type;
+}
+
 static void
 release_power_buffers(AudioRmsPower *filter)
 {
@@ -151,6 +201,13 @@ audio_rms_power_finalize (GObject *obj)
 {
   AudioRmsPower *filter = AUDIO_RMS_POWER (obj);
   release_power_buffers(filter);
+  meter_ring_free(filter->meter_ring);
+  filter->meter_ring = NULL;
+  g_array_free(filter->peaks, TRUE);
+  filter->peaks = NULL;
+  voice_detect_free(filter->voice_detect);
+  filter->voice_detect = NULL;
+  G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
 
 static void
@@ -217,6 +274,14 @@ audio_rms_power_class_init (AudioRmsPowerClass * klass)
       g_quark_from_static_string(AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE);
     sub_block_power_quark =
       g_quark_from_static_string(AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE_POWER);
+    sub_block_peak_quark =
+      g_quark_from_static_string(AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE_PEAK);
+    sub_block_true_peak_quark =
+      g_quark_from_static_string(AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE_TRUE_PEAK);
+    sub_block_channel_powers_quark =
+      g_quark_from_static_string(AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE_CHANNEL_POWERS);
+    sub_block_channel_true_peaks_quark =
+      g_quark_from_static_string(AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE_CHANNEL_TRUE_PEAKS);
     
     analysis_message_quark =
       g_quark_from_static_string(AUDIO_RMS_POWER_ANALYSIS_MESSAGE);
@@ -226,6 +291,12 @@ audio_rms_power_class_init (AudioRmsPowerClass * klass)
       g_quark_from_static_string(AUDIO_RMS_POWER_ANALYSIS_MESSAGE_TRIM_START);
     analysis_trim_end_quark =
       g_quark_from_static_string(AUDIO_RMS_POWER_ANALYSIS_MESSAGE_TRIM_END);
+    analysis_speech_start_quark =
+      g_quark_from_static_string(AUDIO_RMS_POWER_ANALYSIS_MESSAGE_SPEECH_START);
+    analysis_sample_peak_quark =
+      g_quark_from_static_string(AUDIO_RMS_POWER_ANALYSIS_MESSAGE_SAMPLE_PEAK);
+    analysis_true_peak_quark =
+      g_quark_from_static_string(AUDIO_RMS_POWER_ANALYSIS_MESSAGE_TRUE_PEAK);
   }
   /* transform_class->transform_caps = audio_rms_power_transform_caps; */
   /* sub-block-length */
@@ -283,6 +354,18 @@ audio_rms_power_class_init (AudioRmsPowerClass * klass)
   
   g_object_class_install_property(gobject_class, PROP_TRIM_LEVEL, pspec);
   
+  /* trim-mode */
+  pspec =  g_param_spec_enum ("trim-mode",
+			      "Trim mode",
+			      "How leading and trailing silence is found. "
+			      "Voice detection falls back to the power "
+			      "level if no speech is found.",
+			      AUDIO_RMS_POWER_TYPE_TRIM_MODE,
+			      DEFAULT_TRIM_MODE,
+			      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  
+  g_object_class_install_property(gobject_class, PROP_TRIM_MODE, pspec);
+  
   /* power-buffers */
   pspec =  g_param_spec_pointer ("power-buffers",
 				 "List of buffers containing power values.",
@@ -291,26 +374,112 @@ audio_rms_power_class_init (AudioRmsPowerClass * klass)
   
   g_object_class_install_property(gobject_class, PROP_POWER_BUFFERS, pspec);
   
+  /* meter-interval */
+  pspec =  g_param_spec_uint64 ("meter-interval",
+				"Meter interval",
+				"Write power and peak values to the meter ring "
+				"this often. In nanoseconds, 0 disables "
+				"metering.",
+				0, GST_SECOND, DEFAULT_METER_INTERVAL,
+				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  
+  g_object_class_install_property(gobject_class, PROP_METER_INTERVAL, pspec);
+  
+  /* meter-ring */
+  pspec =  g_param_spec_pointer ("meter-ring",
+				 "Meter ring",
+				 "A MeterRing receiving meter values from the "
+				 "streaming thread. Owned by the element.",
+				 G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  
+  g_object_class_install_property(gobject_class, PROP_METER_RING, pspec);
 }
 
 
+/* K-weighting as in ITU-R BS.1770, a high shelf followed by a high
+   pass. The biquads are designed for the current sample rate with the
+   bilinear transform and combined into a single fourth order filter. */
+static void
+setup_prefilter(AudioRmsPower *filter)
+{
+  gdouble rate = filter->sample_rate;
+  gdouble f0 = 1681.974450955533;
+  gdouble gain = 3.999843853973347;
+  gdouble q = 0.7071752369554196;
+  gdouble k = tan(G_PI * f0 / rate);
+  gdouble vh = pow(10.0, gain / 20.0);
+  gdouble vb = pow(vh, 0.4996667741545416);
+  gdouble norm = 1.0 + k / q + k * k;
+  gdouble sb[3];
+  gdouble sa[3];
+  gdouble hb[3] = {1.0, -2.0, 1.0};
+  gdouble ha[3];
+  gdouble *b = filter->prefilter_b;
+  gdouble *a = filter->prefilter_a;
+
+  sb[0] = (vh + vb * k / q + k * k) / norm;
+  sb[1] = 2.0 * (k * k - vh) / norm;
+  sb[2] = (vh - vb * k / q + k * k) / norm;
+  sa[0] = 1.0;
+  sa[1] = 2.0 * (k * k - 1.0) / norm;
+  sa[2] = (1.0 - k / q + k * k) / norm;
+
+  f0 = 38.13547087602444;
+  q = 0.5003270373238773;
+  k = tan(G_PI * f0 / rate);
+  norm = 1.0 + k / q + k * k;
+  ha[0] = 1.0;
+  ha[1] = 2.0 * (k * k - 1.0) / norm;
+  ha[2] = (1.0 - k / q + k * k) / norm;
+
+  b[0] = sb[0] * hb[0];
+  b[1] = sb[0] * hb[1] + sb[1] * hb[0];
+  b[2] = sb[0] * hb[2] + sb[1] * hb[1] + sb[2] * hb[0];
+  b[3] = sb[1] * hb[2] + sb[2] * hb[1];
+  b[4] = sb[2] * hb[2];
+  a[0] = 1.0;
+  a[1] = sa[0] * ha[1] + sa[1] * ha[0];
+  a[2] = sa[0] * ha[2] + sa[1] * ha[1] + sa[2] * ha[0];
+  a[3] = sa[1] * ha[2] + sa[2] * ha[1];
+  a[4] = sa[2] * ha[2];
+}
+
 static void
 setup_sub_block(AudioRmsPower *filter)
 {
   filter->sub_block_sample_count =
     (filter->sample_rate * filter->sub_block_length) / GST_SECOND;
+  filter->meter_sample_count =
+    (filter->sample_rate * filter->meter_interval) / GST_SECOND;
+  if (filter->meter_interval > 0 && filter->meter_sample_count == 0) {
+    filter->meter_sample_count = 1;
+  }
 }
 
 static void
 restart_analysis(AudioRmsPower * filter)
 {
   /* Clear filters */
+  guint c;
   memset(filter->prefilter_x, 0, sizeof(filter->prefilter_x));
   memset(filter->prefilter_y, 0, sizeof(filter->prefilter_y));
+  for (c = 0; c < AUDIO_RMS_POWER_MAX_CHANNELS; c++) {
+    true_peak_reset(&filter->true_peak[c]);
+  }
+  filter->sub_block_peak = 0.0;
+  filter->sub_block_true_peak = 0.0;
+  memset(filter->channel_true_peaks, 0, sizeof(filter->channel_true_peaks));
+  g_array_set_size(filter->peaks, 0);
   release_power_buffers(filter);
   filter->sub_block_samples_left = filter->sub_block_sample_count;
-  filter->square_acc = 0.0;
+  memset(filter->square_acc, 0, sizeof(filter->square_acc));
   filter->generated_offset = 0;
+  filter->meter_samples_left = filter->meter_sample_count;
+  filter->meter_acc = 0.0;
+  filter->meter_peak = 0.0;
+  filter->meter_true_peak = 0.0;
+  if (filter->voice_detect) voice_detect_reset(filter->voice_detect);
+  filter->voice_detect_start = 0;
 }
   
 static void
@@ -323,10 +492,22 @@ audio_rms_power_init (AudioRmsPower * filter, AudioRmsPowerClass * gclass)
   filter->sub_block_message = DEFAULT_SUB_BLOCK_MESSAGE;
   filter->analysis_message = DEFAULT_ANALYSIS_MESSAGE;
   filter->regenerate_timestamps = DEFAULT_REGENERATE_TIMESTAMPS;
+  filter->sample_rate = 48000;
+  filter->channels = 1;
+  filter->channel_weights[0] = 1.0;
+  setup_prefilter(filter);
+  filter->format = AUDIO_RMS_POWER_FORMAT_F32;
+  filter->sample_size = sizeof(gfloat);
+  filter->byte_swap = FALSE;
   filter->generated_offset = 0;
   filter->current_power_buffer = NULL;
   filter->power_buffers = NULL;
   filter->power_buffer_max_len = 32;
+  filter->meter_interval = DEFAULT_METER_INTERVAL;
+  filter->meter_ring = meter_ring_new();
+  filter->peaks = g_array_new(FALSE, FALSE, sizeof(gfloat));
+  filter->trim_mode = DEFAULT_TRIM_MODE;
+  filter->voice_detect = NULL;
   setup_sub_block(filter);
   restart_analysis(filter);
 }
@@ -357,9 +538,18 @@ audio_rms_power_get_property (GObject * object, guint prop_id,
   case PROP_TRIM_LEVEL:
     g_value_set_double (value, filter->trim_level);
     break;
+  case PROP_TRIM_MODE:
+    g_value_set_enum (value, filter->trim_mode);
+    break;
   case PROP_POWER_BUFFERS:
     g_value_set_pointer(value, filter->power_buffers);
     break;
+  case PROP_METER_INTERVAL:
+    g_value_set_uint64 (value, filter->meter_interval);
+    break;
+  case PROP_METER_RING:
+    g_value_set_pointer(value, filter->meter_ring);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     break;
@@ -392,6 +582,14 @@ audio_rms_power_set_property (GObject * object, guint prop_id,
   case PROP_TRIM_LEVEL:
     filter->trim_level = g_value_get_double (value);
     break;
+  case PROP_TRIM_MODE:
+    filter->trim_mode = g_value_get_enum (value);
+    break;
+  case PROP_METER_INTERVAL:
+    filter->meter_interval = g_value_get_uint64 (value);
+    setup_sub_block(filter);
+    filter->meter_samples_left = filter->meter_sample_count;
+    break;
     
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -399,6 +597,37 @@ audio_rms_power_set_property (GObject * object, guint prop_id,
   }
 }
 
+/* Channel weights from ITU-R BS.1770. Surround channels count 1.5 dB
+   more and LFE isn't measured. Without positions every channel is
+   weighted equally. */
+static void
+setup_channel_weights(AudioRmsPower *filter, const GstStructure *caps_struct)
+{
+  GstAudioChannelPosition *positions = NULL;
+  gint c;
+  if (gst_structure_has_field(caps_struct, "channel-positions")) {
+    positions = gst_audio_get_channel_positions((GstStructure*)caps_struct);
+  }
+  for (c = 0; c < filter->channels; c++) {
+    filter->channel_weights[c] = 1.0;
+    if (!positions) continue;
+    switch(positions[c]) {
+    case GST_AUDIO_CHANNEL_POSITION_LFE:
+      filter->channel_weights[c] = 0.0;
+      break;
+    case GST_AUDIO_CHANNEL_POSITION_REAR_LEFT:
+    case GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT:
+    case GST_AUDIO_CHANNEL_POSITION_SIDE_LEFT:
+    case GST_AUDIO_CHANNEL_POSITION_SIDE_RIGHT:
+      filter->channel_weights[c] = 1.41;
+      break;
+    default:
+      break;
+    }
+  }
+  g_free(positions);
+}
+
 static gboolean
 audio_rms_power_set_caps (GstBaseTransform *trans,
 			  GstCaps *incaps, GstCaps *outcaps)
@@ -406,8 +635,36 @@ audio_rms_power_set_caps (GstBaseTransform *trans,
   GstStructure *caps_struct;
   AudioRmsPower *filter = AUDIO_RMS_POWER (trans);
   caps_struct = gst_caps_get_structure (incaps, 0);
-  gst_structure_get_int(caps_struct, "rate", &filter->sample_rate);
+  if (!gst_structure_get_int(caps_struct, "rate", &filter->sample_rate)
+      || !gst_structure_get_int(caps_struct, "channels", &filter->channels)) {
+    return FALSE;
+  }
+  setup_channel_weights(filter, caps_struct);
+  setup_prefilter(filter);
+  /* The old state doesn't match the new coefficients */
+  memset(filter->prefilter_x, 0, sizeof(filter->prefilter_x));
+  memset(filter->prefilter_y, 0, sizeof(filter->prefilter_y));
+  if (gst_structure_has_name(caps_struct, "audio/x-raw-int")) {
+    gint width;
+    gint endianness;
+    if (!gst_structure_get_int(caps_struct, "width", &width)
+	|| !gst_structure_get_int(caps_struct, "endianness", &endianness)) {
+      return FALSE;
+    }
+    filter->format = (width == 16
+		      ? AUDIO_RMS_POWER_FORMAT_S16
+		      : AUDIO_RMS_POWER_FORMAT_S32);
+    filter->sample_size = width / 8;
+    filter->byte_swap = endianness != G_BYTE_ORDER;
+  } else {
+    filter->format = AUDIO_RMS_POWER_FORMAT_F32;
+    filter->sample_size = sizeof(gfloat);
+    filter->byte_swap = FALSE;
+  }
   setup_sub_block(filter);
+  filter->meter_samples_left = filter->meter_sample_count;
+  voice_detect_free(filter->voice_detect);
+  filter->voice_detect = voice_detect_new(filter->sample_rate);
   return TRUE;
 }
 
@@ -554,7 +811,8 @@ audio_rms_power_calculate_loudness(AudioRmsPower *filter)
 
 void
 audio_rms_power_trim_positions(AudioRmsPower *filter,
-			       GstClockTime *start_ts, GstClockTime *end_ts)
+			       GstClockTime *start_ts, GstClockTime *end_ts,
+			       GstClockTime *onset_ts)
 {
   GList *list = filter->power_buffers;
   if (list) {
@@ -562,6 +820,7 @@ audio_rms_power_trim_positions(AudioRmsPower *filter,
     /* Find first block above trim level */
     gint64 first = GST_BUFFER_TIMESTAMP(list->data);
     *start_ts = first;
+    *onset_ts = first;
     while(list) {
       GstBuffer *buf = (GstBuffer*)list->data;
       gfloat *start = (gfloat*)GST_BUFFER_DATA(buf);
@@ -569,8 +828,9 @@ audio_rms_power_trim_positions(AudioRmsPower *filter,
       gfloat *pos = start;
       while(pos < end) {
 	if (*pos > filter->trim_level) {
-	  *start_ts = (GST_BUFFER_TIMESTAMP(buf)
-		    + filter->sub_block_length * (pos - start - 1));
+	  *onset_ts = (GST_BUFFER_TIMESTAMP(buf)
+		       + filter->sub_block_length * (pos - start));
+	  *start_ts = *onset_ts - filter->sub_block_length;
 	  break;
 	}
 	pos++;
@@ -607,6 +867,63 @@ audio_rms_power_trim_positions(AudioRmsPower *filter,
 
 }
 
+/* Frames this far below trim-level are never speech */
+#define VOICE_POWER_RANGE 0.1
+
+/* Trim positions from voice activity detection, with the margin of a
+   sub block that the power levels give. Returns FALSE if no speech was
+   found. */
+static gboolean
+voice_trim_positions(AudioRmsPower *filter,
+		     GstClockTime *start_ts, GstClockTime *end_ts,
+		     GstClockTime *onset_ts)
+{
+  guint64 start;
+  guint64 end;
+  guint64 onset;
+  if (!filter->voice_detect
+      || !voice_detect_trim(filter->voice_detect,
+			    filter->sub_block_sample_count,
+			    filter->trim_level * VOICE_POWER_RANGE,
+			    &start, &end, &onset)) {
+    return FALSE;
+  }
+  *onset_ts = (filter->voice_detect_start
+	       + gst_util_uint64_scale(onset, GST_SECOND, filter->sample_rate));
+  *start_ts = (filter->voice_detect_start
+	       + gst_util_uint64_scale(start, GST_SECOND, filter->sample_rate));
+  *end_ts = (filter->voice_detect_start
+	     + gst_util_uint64_scale(end, GST_SECOND, filter->sample_rate));
+  return TRUE;
+}
+
+void
+audio_rms_power_peaks(AudioRmsPower *filter,
+		      GstClockTime start_ts, GstClockTime end_ts,
+		      gfloat *sample_peak, gfloat *true_peak)
+{
+  const gfloat *peaks = (const gfloat*)filter->peaks->data;
+  guint n = filter->peaks->len / 2;
+  guint first;
+  guint last;
+  GstClockTime offset;
+  *sample_peak = 0.0;
+  *true_peak = 0.0;
+  if (!filter->power_buffers || n == 0) return;
+  offset = GST_BUFFER_TIMESTAMP(filter->power_buffers->data);
+  if (start_ts < offset) start_ts = offset;
+  if (end_ts <= start_ts) return;
+  first = (start_ts - offset) / filter->sub_block_length;
+  last = ((end_ts - offset + filter->sub_block_length - 1)
+	  / filter->sub_block_length);
+  if (last > n) last = n;
+  while(first < last) {
+    if (peaks[2 * first] > *sample_peak) *sample_peak = peaks[2 * first];
+    if (peaks[2 * first + 1] > *true_peak) *true_peak = peaks[2 * first + 1];
+    first++;
+  }
+}
+
 static gboolean
 audio_rms_power_event (GstBaseTransform *trans, GstEvent *event)
 {
@@ -616,10 +933,17 @@ audio_rms_power_event (GstBaseTransform *trans, GstEvent *event)
     if (filter->analysis_message) {
       GstStructure *power_struct;
       GstMessage *msg;
-      GstClockTime start;
-      GstClockTime end;
+      GstClockTime start = 0;
+      GstClockTime end = 0;
+      GstClockTime onset = 0;
+      gfloat sample_peak;
+      gfloat true_peak;
       gfloat loudness = audio_rms_power_calculate_loudness(filter);
-      audio_rms_power_trim_positions(filter, &start, &end);
+      if (filter->trim_mode != AUDIO_RMS_POWER_TRIM_MODE_VOICE
+	  || !voice_trim_positions(filter, &start, &end, &onset)) {
+	audio_rms_power_trim_positions(filter, &start, &end, &onset);
+      }
+      audio_rms_power_peaks(filter, start, end, &sample_peak, &true_peak);
       power_struct = gst_structure_id_new(analysis_message_quark,
 					  analysis_loudness_quark,
 					  G_TYPE_DOUBLE, (gdouble)loudness,
@@ -627,6 +951,12 @@ audio_rms_power_event (GstBaseTransform *trans, GstEvent *event)
 					  GST_TYPE_CLOCK_TIME, start,
 					  analysis_trim_end_quark,
 					  GST_TYPE_CLOCK_TIME, end,
+					  analysis_speech_start_quark,
+					  GST_TYPE_CLOCK_TIME, onset,
+					  analysis_sample_peak_quark,
+					  G_TYPE_DOUBLE, (gdouble)sample_peak,
+					  analysis_true_peak_quark,
+					  G_TYPE_DOUBLE, (gdouble)true_peak,
 					  NULL);
       msg = gst_message_new_element (GST_OBJECT(filter), power_struct);
       gst_bus_post(GST_ELEMENT_BUS(filter), msg);
@@ -642,34 +972,271 @@ audio_rms_power_stop (GstBaseTransform *trans)
 }
 
 
-#define A1 -3.680706748016390
-#define A2 5.087045247971131
-#define A3 -3.131546351446730
-#define A4 0.725208888477870
-
-#define B0 1.53512485958697
-#define B1  -5.76194590858032
-#define B2  8.11691004925258
-#define B3 -5.08848181111208
-#define B4 1.19839281085285
-
 #define FILTER(x0, x1, x2, x3, x4, y1, y2, y3, y4)	\
-(B0*(x0) + B1*(x1) + B2*(x2) + B3*(x3) + B4*(x4)	\
- - A1*(y1) - A2*(y2) - A3*(y3) - A4*(y4))
+(b0*(x0) + b1*(x1) + b2*(x2) + b3*(x3) + b4*(x4)	\
+ - a1*(y1) - a2*(y2) - a3*(y3) - a4*(y4))
 
 #define X(i) x[i-1]
 #define Y(i) y[i-1]
 
+/* Run n samples of one channel through its filter, taking every
+   stride'th value from data. Returns the sum of the squared output and
+   the largest absolute input value. */
+static inline void
+filter_channel(AudioRmsPower *filter, guint channel,
+	       const gfloat *data, guint n, guint stride,
+	       gfloat *sum, gfloat *peak)
+{
+  const gfloat *end = data + n * stride;
+  gfloat *x = filter->prefilter_x[channel];
+  gfloat *y = filter->prefilter_y[channel];
+  const gdouble b0 = filter->prefilter_b[0];
+  const gdouble b1 = filter->prefilter_b[1];
+  const gdouble b2 = filter->prefilter_b[2];
+  const gdouble b3 = filter->prefilter_b[3];
+  const gdouble b4 = filter->prefilter_b[4];
+  const gdouble a1 = filter->prefilter_a[1];
+  const gdouble a2 = filter->prefilter_a[2];
+  const gdouble a3 = filter->prefilter_a[3];
+  const gdouble a4 = filter->prefilter_a[4];
+  gfloat acc = 0.0;
+  gfloat max = 0.0;
+  while(data != end) {
+    gfloat y0 = FILTER(*data, X(1), X(2), X(3), X(4), Y(1), Y(2), Y(3), Y(4));
+    gfloat a = fabsf(*data);
+    Y(4) = Y(3);
+    Y(3) = Y(2);
+    Y(2) = Y(1);
+    Y(1) = y0;
+    X(4) = X(3);
+    X(3) = X(2);
+    X(2) = X(1);
+    X(1) = *data;
+
+    acc += y0 * y0;
+    if (a > max) max = a;
+    data += stride;
+  }
+  *sum = acc;
+  *peak = max;
+}
+
+#ifdef HAVE_V4SF
+/* Filter up to four channels of n interleaved frames at once, with one
+   channel in each lane */
+static void
+filter_channel_group(AudioRmsPower *filter, guint first, guint lanes,
+		     const gfloat *data, guint n, gfloat *sums, gfloat *peak)
+{
+  const gfloat *end = data + n * filter->channels;
+  const v4df b0 = v4df_set1(filter->prefilter_b[0]);
+  const v4df b1 = v4df_set1(filter->prefilter_b[1]);
+  const v4df b2 = v4df_set1(filter->prefilter_b[2]);
+  const v4df b3 = v4df_set1(filter->prefilter_b[3]);
+  const v4df b4 = v4df_set1(filter->prefilter_b[4]);
+  const v4df a1 = v4df_set1(filter->prefilter_a[1]);
+  const v4df a2 = v4df_set1(filter->prefilter_a[2]);
+  const v4df a3 = v4df_set1(filter->prefilter_a[3]);
+  const v4df a4 = v4df_set1(filter->prefilter_a[4]);
+  v4df x[4];
+  v4df y[4];
+  v4df acc = v4df_set1(0.0);
+  gfloat max = *peak;
+  guint i;
+  guint l;
+  for (i = 0; i < 4; i++) {
+    x[i] = v4df_set1(0.0);
+    y[i] = v4df_set1(0.0);
+    for (l = 0; l < lanes; l++) {
+      x[i][l] = filter->prefilter_x[first + l][i];
+      y[i][l] = filter->prefilter_y[first + l][i];
+    }
+  }
+  data += first;
+  while(data < end) {
+    v4df x0 = v4df_set1(0.0);
+    v4df y0;
+    for (l = 0; l < lanes; l++) {
+      gfloat a = fabsf(data[l]);
+      x0[l] = data[l];
+      if (a > max) max = a;
+    }
+    y0 = FILTER(x0, X(1), X(2), X(3), X(4), Y(1), Y(2), Y(3), Y(4));
+    Y(4) = Y(3);
+    Y(3) = Y(2);
+    Y(2) = Y(1);
+    Y(1) = y0;
+    X(4) = X(3);
+    X(3) = X(2);
+    X(2) = X(1);
+    X(1) = x0;
+    acc += y0 * y0;
+    data += filter->channels;
+  }
+  for (l = 0; l < lanes; l++) {
+    for (i = 0; i < 4; i++) {
+      filter->prefilter_x[first + l][i] = x[i][l];
+      filter->prefilter_y[first + l][i] = y[i][l];
+    }
+    sums[first + l] = acc[l];
+  }
+  *peak = max;
+}
+#endif
+
+/* Run n frames through the filters. Returns the sum of the squared
+   output for each channel in sums and the largest absolute input value
+   of any channel. */
+static void
+filter_samples(AudioRmsPower *filter, const gfloat *data, guint n,
+	       gfloat *sums, gfloat *peak)
+{
+  guint c;
+  *peak = 0.0;
+  if (filter->channels == 1) {
+    filter_channel(filter, 0, data, n, 1, sums, peak);
+    return;
+  }
+#ifdef HAVE_V4SF
+  for (c = 0; c < filter->channels; c += 4) {
+    guint lanes = filter->channels - c < 4 ? filter->channels - c : 4;
+    filter_channel_group(filter, c, lanes, data, n, sums, peak);
+  }
+#else
+  for (c = 0; c < filter->channels; c++) {
+    gfloat p;
+    filter_channel(filter, c, data + c, n, filter->channels, sums + c, &p);
+    if (p > *peak) *peak = p;
+  }
+#endif
+}
+
+/* Filter state below this is treated as zero in GAP buffers. The
+   squared output is then far below the absolute gate. */
+#define SETTLE_FLOOR 1e-12f
+/* Samples to filter between checks while waiting for the state to
+   decay */
+#define SETTLE_SAMPLES 256
+
+/* Returns TRUE if silent input would give no measurable output from
+   the filters. The state is then cleared, so it stays exactly zero for
+   the rest of the silence. */
+static gboolean
+filters_settled(AudioRmsPower *filter)
+{
+  guint c;
+  guint i;
+  for (c = 0; c < filter->channels; c++) {
+    for (i = 0; i < 4; i++) {
+      if (fabsf(filter->prefilter_x[c][i]) > SETTLE_FLOOR
+	  || fabsf(filter->prefilter_y[c][i]) > SETTLE_FLOOR) {
+	return FALSE;
+      }
+    }
+  }
+  for (c = 0; c < filter->channels; c++) {
+    if (!true_peak_settle(&filter->true_peak[c], SETTLE_FLOOR)) return FALSE;
+  }
+  memset(filter->prefilter_x, 0, sizeof(filter->prefilter_x));
+  memset(filter->prefilter_y, 0, sizeof(filter->prefilter_y));
+  return TRUE;
+}
+
+#define S16_SCALE (1.0f / 32768.0f)
+#define S32_SCALE (1.0f / 2147483648.0f)
+
+/* Returns n samples from data as float, as fractions of full scale.
+   Float input is returned as is, integers are converted into
+   convert_buffer so n must not exceed AUDIO_RMS_POWER_CONVERT_LENGTH. */
+static const gfloat *
+convert_samples(AudioRmsPower *filter, const guint8 *data, guint n)
+{
+  gfloat *out = filter->convert_buffer;
+  guint i = 0;
+  switch(filter->format) {
+  case AUDIO_RMS_POWER_FORMAT_S16:
+    {
+      const gint16 *in = (const gint16*)data;
+      if (filter->byte_swap) {
+	for (; i < n; i++) {
+	  out[i] = (gint16)GUINT16_SWAP_LE_BE(in[i]) * S16_SCALE;
+	}
+	break;
+      }
+#ifdef HAVE_V4SF
+      for (; i + 4 <= n; i += 4) {
+	v4sf_store(out + i, v4sf_from_s16(in + i, S16_SCALE));
+      }
+#endif
+      for (; i < n; i++) out[i] = in[i] * S16_SCALE;
+    }
+    break;
+  case AUDIO_RMS_POWER_FORMAT_S32:
+    {
+      const gint32 *in = (const gint32*)data;
+      if (filter->byte_swap) {
+	for (; i < n; i++) {
+	  out[i] = (gint32)GUINT32_SWAP_LE_BE(in[i]) * S32_SCALE;
+	}
+	break;
+      }
+#ifdef HAVE_V4SF
+      for (; i + 4 <= n; i += 4) {
+	v4sf_store(out + i, v4sf_from_s32(in + i, S32_SCALE));
+      }
+#endif
+      for (; i < n; i++) out[i] = in[i] * S32_SCALE;
+    }
+    break;
+  default:
+    return (const gfloat*)data;
+  }
+  return out;
+}
+
+/* Values multiplied by scale, for message fields */
+static GValueArray *
+double_array(const gfloat *values, guint n, gdouble scale)
+{
+  GValueArray *array = g_value_array_new(n);
+  GValue value = {0};
+  guint i;
+  g_value_init(&value, G_TYPE_DOUBLE);
+  for (i = 0; i < n; i++) {
+    g_value_set_double(&value, values[i] * scale);
+    g_value_array_append(array, &value);
+  }
+  g_value_unset(&value);
+  return array;
+}
+
+/* Time of the sample samples_left from the end of the buffer */
+static inline GstClockTime
+buffer_position(AudioRmsPower *filter, GstBuffer *buf, guint samples_left)
+{
+  return (GST_BUFFER_TIMESTAMP(buf) + GST_BUFFER_DURATION(buf)
+	  - samples_left * GST_SECOND / filter->sample_rate);
+}
+
 static GstFlowReturn
 audio_rms_power_analyze(GstBaseTransform *trans, GstBuffer *buf)
 {
   AudioRmsPower *filter = AUDIO_RMS_POWER (trans);
   guint block_left = filter->sub_block_samples_left;
-  gfloat acc = filter->square_acc;
-  guint buffer_left = GST_BUFFER_SIZE(buf) / sizeof(gfloat);
-  const gfloat *data = (const gfloat*)GST_BUFFER_DATA(buf);
-  gfloat *x = filter->prefilter_x;
-  gfloat *y = filter->prefilter_y;
+  guint channels = filter->channels;
+  guint frame_size = filter->sample_size * channels;
+  guint buffer_left = GST_BUFFER_SIZE(buf) / frame_size; /* In frames */
+  const guint8 *data = GST_BUFFER_DATA(buf);
+  gboolean convert = filter->format != AUDIO_RMS_POWER_FORMAT_F32;
+  guint c;
+  gboolean meter = filter->meter_sample_count > 0;
+  /* Silence only needs filtering until the state from earlier audio
+     has died out, after that every value is zero */
+  gboolean gap = GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_GAP);
+  gboolean settled = FALSE;
+  /* Voice detection is only needed for the trim positions */
+  gboolean voice = (filter->voice_detect && filter->analysis_message
+		    && filter->trim_mode == AUDIO_RMS_POWER_TRIM_MODE_VOICE);
   if (filter->regenerate_timestamps) {
     GST_BUFFER_OFFSET(buf) = filter->generated_offset;
     GST_BUFFER_OFFSET_END(buf) = filter->generated_offset + buffer_left;
@@ -678,6 +1245,9 @@ audio_rms_power_analyze(GstBaseTransform *trans, GstBuffer *buf)
     GST_BUFFER_DURATION(buf) = buffer_left * GST_SECOND / filter->sample_rate;
     filter->generated_offset += buffer_left;
   }
+  if (voice && voice_detect_samples(filter->voice_detect) == 0) {
+    filter->voice_detect_start = GST_BUFFER_TIMESTAMP(buf);
+  }
 #if 0
   g_debug("size: %d, ts: %lld + %lld offset: %lld - %lld",
 	  GST_BUFFER_SIZE(buf),
@@ -685,52 +1255,123 @@ audio_rms_power_analyze(GstBaseTransform *trans, GstBuffer *buf)
 	  GST_BUFFER_OFFSET(buf), GST_BUFFER_OFFSET_END(buf));
 #endif
   while(buffer_left > 0) {
-    const gfloat *end;
-    if (block_left > buffer_left) {
-      end = data + buffer_left;
-      block_left -= buffer_left;
-      buffer_left = 0;
-    } else {
-      end = data + block_left;
-      buffer_left -= block_left;
-      block_left = 0;
+    guint n = buffer_left;
+    gfloat sums[AUDIO_RMS_POWER_MAX_CHANNELS];
+    gfloat sum = 0.0; /* Weighted sum of all channels */
+    gfloat peak = 0.0;
+    gfloat true_peak = 0.0;
+    const gfloat *samples = NULL;
+    if (n > block_left) n = block_left;
+    if (meter && n > filter->meter_samples_left) {
+      n = filter->meter_samples_left;
+    }
+    if (convert && n > AUDIO_RMS_POWER_CONVERT_LENGTH / channels) {
+      n = AUDIO_RMS_POWER_CONVERT_LENGTH / channels;
+    }
+    if (voice) {
+      /* The detector takes the weighted power one hop at a time */
+      guint hop_left = voice_detect_hop_left(filter->voice_detect);
+      if (n > hop_left) n = hop_left;
+    }
+    if (gap && !settled) {
+      settled = filters_settled(filter);
+      if (!settled && n > SETTLE_SAMPLES) n = SETTLE_SAMPLES;
     }
-    while(data != end) {
-      gfloat y0 = FILTER(*data, X(1), X(2), X(3), X(4), Y(1), Y(2), Y(3), Y(4));
-      Y(4) = Y(3);
-      Y(3) = Y(2);
-      Y(2) = Y(1);
-      Y(1) = y0;
-      X(4) = X(3);
-      X(3) = X(2);
-      X(2) = X(1);
-      X(1) = *data;
-
-      acc += y0 * y0;
-      data++;
+    if (!settled) {
+      samples = convert_samples(filter, data, n * channels);
+      filter_samples(filter, samples, n, sums, &peak);
+      true_peak = peak;
+      for (c = 0; c < channels; c++) {
+	gfloat tp = true_peak_process(&filter->true_peak[c], samples + c, n,
+				      channels, 0.0);
+	if (tp > filter->channel_true_peaks[c]) {
+	  filter->channel_true_peaks[c] = tp;
+	}
+	if (tp > true_peak) true_peak = tp;
+	filter->square_acc[c] += sums[c];
+	sum += filter->channel_weights[c] * sums[c];
+      }
+    }
+    if (voice) {
+      voice_detect_process(filter->voice_detect, samples, n, channels,
+			   filter->channel_weights, sum);
+    }
+    data += n * frame_size;
+    buffer_left -= n;
+    block_left -= n;
+    if (peak > filter->sub_block_peak) filter->sub_block_peak = peak;
+    if (true_peak > filter->sub_block_true_peak) {
+      filter->sub_block_true_peak = true_peak;
+    }
+    if (meter) {
+      filter->meter_acc += sum;
+      if (peak > filter->meter_peak) filter->meter_peak = peak;
+      if (true_peak > filter->meter_true_peak) {
+	filter->meter_true_peak = true_peak;
+      }
+      filter->meter_samples_left -= n;
+      if (filter->meter_samples_left == 0) {
+	MeterValue value;
+	value.timestamp = buffer_position(filter, buf, buffer_left);
+	value.power = filter->meter_acc / filter->meter_sample_count;
+	value.peak = filter->meter_peak;
+	value.true_peak = filter->meter_true_peak;
+	meter_ring_push(filter->meter_ring, &value);
+	filter->meter_samples_left = filter->meter_sample_count;
+	filter->meter_acc = 0.0;
+	filter->meter_peak = 0.0;
+	filter->meter_true_peak = 0.0;
+      }
     }
     if (block_left == 0) {
-      gfloat power = acc / filter->sub_block_sample_count;
+      gfloat power = 0.0;
+      for (c = 0; c < channels; c++) {
+	power += filter->channel_weights[c] * filter->square_acc[c];
+      }
+      power /= filter->sub_block_sample_count;
       add_power_value(filter, power,
-		      (GST_BUFFER_TIMESTAMP(buf) + GST_BUFFER_DURATION(buf)
-		       - (buffer_left + filter->sub_block_sample_count) * GST_SECOND / filter->sample_rate));
+		      buffer_position(filter, buf,
+				      (buffer_left
+				       + filter->sub_block_sample_count)));
+      g_array_append_val(filter->peaks, filter->sub_block_peak);
+      g_array_append_val(filter->peaks, filter->sub_block_true_peak);
       /* g_debug("Power: %f", 10*log10(power)); */
       if (filter->sub_block_message) {
 	GstStructure *power_struct;
 	GstMessage *msg;
+	GValueArray *channel_powers =
+	  double_array(filter->square_acc, channels,
+		       1.0 / filter->sub_block_sample_count);
+	GValueArray *channel_true_peaks =
+	  double_array(filter->channel_true_peaks, channels, 1.0);
 	power_struct = gst_structure_id_new(sub_block_message_quark,
 					    sub_block_power_quark,
 					    G_TYPE_DOUBLE, (gdouble)power,
+					    sub_block_peak_quark,
+					    G_TYPE_DOUBLE,
+					    (gdouble)filter->sub_block_peak,
+					    sub_block_true_peak_quark,
+					    G_TYPE_DOUBLE,
+					    (gdouble)filter->sub_block_true_peak,
+					    sub_block_channel_powers_quark,
+					    G_TYPE_VALUE_ARRAY, channel_powers,
+					    sub_block_channel_true_peaks_quark,
+					    G_TYPE_VALUE_ARRAY, channel_true_peaks,
 					    NULL);
+	g_value_array_free(channel_powers);
+	g_value_array_free(channel_true_peaks);
 	msg = gst_message_new_element (GST_OBJECT(filter), power_struct);
 	gst_bus_post(GST_ELEMENT_BUS(filter), msg);
       }
       block_left = filter->sub_block_sample_count;
-      acc = 0.0;
+      memset(filter->square_acc, 0, sizeof(filter->square_acc));
+      filter->sub_block_peak = 0.0;
+      filter->sub_block_true_peak = 0.0;
+      memset(filter->channel_true_peaks, 0,
+	     sizeof(filter->channel_true_peaks));
     }
   }
   filter->sub_block_samples_left = block_left;
-  filter->square_acc = acc;
   return GST_FLOW_OK;
 }
 gboolean
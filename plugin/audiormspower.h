@@ -1,5 +1,8 @@
 G_BEGIN_DECLS
 #include <gst/base/gstbasetransform.h>
+#include "meter_ring.h"
+#include "true_peak.h"
+#include "voice_detect.h"
 
 #define GST_TYPE_AUDIO_RMS_POWER \
   (audio_rms_power_get_type())
@@ -17,10 +20,33 @@ typedef struct _AudioRmsPowerClass AudioRmsPowerClass;
 
 typedef float Sample;
 
+typedef enum {
+  AUDIO_RMS_POWER_FORMAT_F32,
+  AUDIO_RMS_POWER_FORMAT_S16,
+  AUDIO_RMS_POWER_FORMAT_S32
+} AudioRmsPowerFormat;
+
+/* How the trim positions are found */
+typedef enum {
+  AUDIO_RMS_POWER_TRIM_MODE_POWER, /* Sub blocks above trim-level */
+  AUDIO_RMS_POWER_TRIM_MODE_VOICE /* Voice activity detection */
+} AudioRmsPowerTrimMode;
+
+#define AUDIO_RMS_POWER_MAX_CHANNELS 8
+
+/* Integer samples are converted to float this many at a time */
+#define AUDIO_RMS_POWER_CONVERT_LENGTH 1024
+
 struct _AudioRmsPower
 {
   GstBaseTransform base;
   gint sample_rate;
+  gint channels;
+  gfloat channel_weights[AUDIO_RMS_POWER_MAX_CHANNELS];
+  AudioRmsPowerFormat format;
+  guint sample_size; /* Bytes per sample */
+  gboolean byte_swap; /* Integer samples not in host byte order */
+  gfloat convert_buffer[AUDIO_RMS_POWER_CONVERT_LENGTH];
   gint64 sub_block_length;
   guint block_length;
   guint block_overlap;
@@ -28,19 +54,45 @@ struct _AudioRmsPower
   gboolean analysis_message;
   gfloat trim_level; /* Power level used for finding leading and
 			trailing silence */
+  AudioRmsPowerTrimMode trim_mode;
+  /* Only used with voice trimming and analysis messages */
+  VoiceDetect *voice_detect;
+  GstClockTime voice_detect_start; /* Timestamp of the first sample */
 
   /* Generate new timestamps and offsets, changing incoming buffers.
    */
   gboolean regenerate_timestamps;
   gint64 generated_offset;
   
+  /* Sample counts are in frames, one sample from each channel */
   guint sub_block_sample_count; /* Total number of samples in a sub block */
   guint sub_block_samples_left; /* Number of samples left before the sub block
 				   is done */
-  gfloat square_acc; /* Sum of squared samples */
+  /* Sum of squared filtered samples for each channel */
+  gfloat square_acc[AUDIO_RMS_POWER_MAX_CHANNELS];
 
-  gfloat prefilter_x[4];
-  gfloat prefilter_y[4];
+  /* K-weighting coefficients for sample_rate */
+  gdouble prefilter_b[5];
+  gdouble prefilter_a[5];
+  gfloat prefilter_x[AUDIO_RMS_POWER_MAX_CHANNELS][4];
+  gfloat prefilter_y[AUDIO_RMS_POWER_MAX_CHANNELS][4];
+
+  TruePeak true_peak[AUDIO_RMS_POWER_MAX_CHANNELS];
+  gfloat sub_block_peak; /* Max absolute sample in current sub block */
+  gfloat sub_block_true_peak;
+  /* Largest true-peak of each channel in current sub block */
+  gfloat channel_true_peaks[AUDIO_RMS_POWER_MAX_CHANNELS];
+  GArray *peaks; /* Sample peak and true-peak for each sub block,
+		    interleaved */
+
+  /* Metering */
+  GstClockTime meter_interval; /* 0 disables metering */
+  guint meter_sample_count; /* Total number of samples in a meter interval */
+  guint meter_samples_left;
+  gfloat meter_acc; /* Weighted sum of squared filtered samples */
+  gfloat meter_peak; /* Max absolute input sample */
+  gfloat meter_true_peak;
+  MeterRing *meter_ring;
 
   guint power_buffer_max_len; /* Max length for power buffers */
   GstBuffer *current_power_buffer;
@@ -55,14 +107,33 @@ struct _AudioRmsPowerClass
 
 #define AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE "sub-block-message"
 #define AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE_POWER "power"
+#define AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE_PEAK "peak"
+#define AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE_TRUE_PEAK "true-peak"
+/* GValueArray with the unweighted power of each channel */
+#define AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE_CHANNEL_POWERS "channel-powers"
+/* GValueArray with the true-peak of each channel */
+#define AUDIO_RMS_POWER_SUB_BLOCK_MESSAGE_CHANNEL_TRUE_PEAKS \
+  "channel-true-peaks"
 
 #define AUDIO_RMS_POWER_ANALYSIS_MESSAGE "analysis-message"
 #define AUDIO_RMS_POWER_ANALYSIS_MESSAGE_LOUDNESS "loudness"
 #define AUDIO_RMS_POWER_ANALYSIS_MESSAGE_TRIM_START "trim-start"
 #define AUDIO_RMS_POWER_ANALYSIS_MESSAGE_TRIM_END "trim-end"
+/* Where the speech starts, trim-start is a margin before it */
+#define AUDIO_RMS_POWER_ANALYSIS_MESSAGE_SPEECH_START "speech-start"
+/* Peaks between trim-start and trim-end, as fractions of full scale */
+#define AUDIO_RMS_POWER_ANALYSIS_MESSAGE_SAMPLE_PEAK "sample-peak"
+#define AUDIO_RMS_POWER_ANALYSIS_MESSAGE_TRUE_PEAK "true-peak"
 
 GType audio_rms_power_get_type (void);
 
+/* Largest sample peak and true-peak between start_ts and end_ts, at
+   sub block resolution */
+void
+audio_rms_power_peaks(AudioRmsPower *filter,
+		      GstClockTime start_ts, GstClockTime end_ts,
+		      gfloat *sample_peak, gfloat *true_peak);
+
 gboolean
 audio_rms_power_plugin_init (GstPlugin *plugin);
 
@@ -60,6 +60,7 @@
 #include <gst/gst.h>
 
 #include "audiotrim.h"
+#include "envelope.h"
 #include <math.h>
 
 GST_DEBUG_CATEGORY_STATIC (audio_trim_debug);
@@ -463,38 +464,31 @@ audio_trim_change_state (GstElement *element, GstStateChange transition)
 static guint64
 find_not_silence(AudioTrim *filter, GstBuffer *buf)
 {
-  gfloat *data = (gfloat*) GST_BUFFER_DATA(buf);
-  gfloat *end = (gfloat*) &((guint8*)data)[GST_BUFFER_SIZE(buf)];
+  const gfloat *data = (const gfloat*) GST_BUFFER_DATA(buf);
+  gsize n = GST_BUFFER_SIZE(buf) / sizeof(gfloat);
   gfloat f = filter->f0;
-  gfloat acc = filter->accumulator;
   gfloat t = filter->start_threshold / (100.0 * (1-f));
-  while(data < end && acc < t) {
-    acc = acc * f + fabsf(*data++);
-  }
-  filter->accumulator = acc;
-  if (data == end) return GST_BUFFER_OFFSET_NONE;
-  return GST_BUFFER_OFFSET(buf) + (end - data);
+  gsize consumed;
+  consumed = envelope_scan_forward(data, n, f, t, &filter->accumulator);
+  if (filter->accumulator < t) return GST_BUFFER_OFFSET_NONE;
+  return GST_BUFFER_OFFSET(buf) + consumed - 1;
 }
 
 static guint64
 find_not_silence_rev(AudioTrim *filter, GstBuffer *buf, gint64 end_offset)
 {
-  gfloat *start = (gfloat*) GST_BUFFER_DATA(buf);
-  gfloat *data;
+  const gfloat *start = (const gfloat*) GST_BUFFER_DATA(buf);
   gfloat f = filter->f0;
-  gfloat acc = filter->accumulator;
   gfloat t = filter->start_threshold / (100.0 * (1-f));
+  gsize n;
+  gsize consumed;
   if (end_offset <= GST_BUFFER_OFFSET(buf)) return GST_BUFFER_OFFSET_NONE;
   if (end_offset > GST_BUFFER_OFFSET_END(buf))
     end_offset = GST_BUFFER_OFFSET_END(buf);
-  data = &((gfloat*)start)[end_offset - GST_BUFFER_OFFSET(buf)];
-  while(data-- > start && acc < t) {
-    acc = acc * f + fabsf(*data);
-  }
-  data++;
-  filter->accumulator = acc;
-  if (data == start) return GST_BUFFER_OFFSET_NONE;
-  return GST_BUFFER_OFFSET(buf) + (data - start);
+  n = end_offset - GST_BUFFER_OFFSET(buf);
+  consumed = envelope_scan_backward(start, n, f, t, &filter->accumulator);
+  if (filter->accumulator < t) return GST_BUFFER_OFFSET_NONE;
+  return GST_BUFFER_OFFSET(buf) + (n - consumed);
 }
 
 static inline guint64
@@ -794,7 +788,7 @@ audio_trim_event (GstPad * pad, GstEvent *event)
   return gst_pad_event_default (pad, event);
 }
 
-static gboolean
+gboolean
 audio_trim_plugin_init (GstPlugin *plugin)
 {
   g_debug("audio_trim_plugin_init");
@@ -805,6 +799,7 @@ audio_trim_plugin_init (GstPlugin *plugin)
 			       GST_TYPE_AUDIO_TRIM);
 }
 
+#if 0
 /* PACKAGE: this is usually set by autotools depending on some _INIT macro
  * in configure.ac and then written into and defined in config.h, but we can
  * just set it ourselves here in case someone doesn't use autotools to
@@ -828,3 +823,4 @@ GST_PLUGIN_DEFINE (
     "Websync",
     "http://gstreamer.net/"
 )
+#endif
@@ -14,8 +14,6 @@ G_BEGIN_DECLS
 typedef struct _AudioTrim      AudioTrim;
 typedef struct _AudioTrimClass AudioTrimClass;
 
-typedef float Sample;
-
 
 
 enum AudioTrimState {
@@ -96,5 +94,8 @@ struct _AudioTrimClass
 
 GType audio_trim_get_type (void);
 
+gboolean
+audio_trim_plugin_init (GstPlugin *plugin);
+
 G_END_DECLS
 
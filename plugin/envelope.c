@@ -0,0 +1,147 @@
+#include "envelope.h"
+#include "simd.h"
+#include <math.h>
+
+/* Samples per chunk. Must be a multiple of 4. */
+#define CHUNK 16
+
+/* Since 0 <= f <= 1 and all inputs are non-negative the accumulator
+   can never exceed acc + sum(|x|) anywhere inside a chunk. If that
+   bound is below the threshold the whole chunk is skipped using
+   the closed form
+
+   acc' = acc * f^CHUNK + sum(f^(CHUNK-1-i) * |x[i]|)
+
+   Only a chunk where the bound reaches the threshold is run sample by
+   sample. */
+
+static void
+chunk_weights(gfloat f, gfloat *weights, gboolean reverse)
+{
+  gfloat w = 1.0;
+  guint i;
+  for (i = 0; i < CHUNK; i++) {
+    weights[reverse ? i : CHUNK - 1 - i] = w;
+    w *= f;
+  }
+}
+
+static inline void
+chunk_sums(const gfloat *data, const gfloat *weights,
+	   gfloat *sum, gfloat *weighted)
+{
+#ifdef HAVE_V4SF
+  v4sf s = v4sf_set1(0.0);
+  v4sf ws = v4sf_set1(0.0);
+  guint i;
+  for (i = 0; i < CHUNK; i += 4) {
+    v4sf x = v4sf_abs(v4sf_load(data + i));
+    s += x;
+    ws += x * v4sf_load(weights + i);
+  }
+  *sum = v4sf_hsum(s);
+  *weighted = v4sf_hsum(ws);
+#else
+  gfloat s = 0.0;
+  gfloat ws = 0.0;
+  guint i;
+  for (i = 0; i < CHUNK; i++) {
+    gfloat x = fabsf(data[i]);
+    s += x;
+    ws += x * weights[i];
+  }
+  *sum = s;
+  *weighted = ws;
+#endif
+}
+
+gsize
+envelope_scan_forward_scalar(const gfloat *data, gsize n, gfloat f,
+			     gfloat threshold, gfloat *acc)
+{
+  gsize i = 0;
+  gfloat a = *acc;
+  while(i < n && a < threshold) {
+    a = a * f + fabsf(data[i++]);
+  }
+  *acc = a;
+  return i;
+}
+
+gsize
+envelope_scan_backward_scalar(const gfloat *data, gsize n, gfloat f,
+			      gfloat threshold, gfloat *acc)
+{
+  gsize i = n;
+  gfloat a = *acc;
+  while(i > 0 && a < threshold) {
+    a = a * f + fabsf(data[--i]);
+  }
+  *acc = a;
+  return n - i;
+}
+
+gsize
+envelope_scan_forward(const gfloat *data, gsize n, gfloat f,
+		      gfloat threshold, gfloat *acc)
+{
+  gfloat weights[CHUNK];
+  gfloat f_chunk;
+  gfloat a = *acc;
+  gsize i = 0;
+  if (a >= threshold) return 0;
+  chunk_weights(f, weights, FALSE);
+  f_chunk = weights[0] * f;
+  while(i + CHUNK <= n) {
+    gfloat sum;
+    gfloat weighted;
+    chunk_sums(data + i, weights, &sum, &weighted);
+    if (a + sum >= threshold) {
+      gsize c = envelope_scan_forward_scalar(data + i, CHUNK, f,
+					     threshold, &a);
+      if (a >= threshold) {
+	*acc = a;
+	return i + c;
+      }
+    } else {
+      a = a * f_chunk + weighted;
+    }
+    i += CHUNK;
+  }
+  i += envelope_scan_forward_scalar(data + i, n - i, f, threshold, &a);
+  *acc = a;
+  return i;
+}
+
+gsize
+envelope_scan_backward(const gfloat *data, gsize n, gfloat f,
+		       gfloat threshold, gfloat *acc)
+{
+  gfloat weights[CHUNK];
+  gfloat f_chunk;
+  gfloat a = *acc;
+  gsize i = n;
+  gsize c;
+  if (a >= threshold) return 0;
+  chunk_weights(f, weights, TRUE);
+  f_chunk = weights[CHUNK - 1] * f;
+  while(i >= CHUNK) {
+    gfloat sum;
+    gfloat weighted;
+    chunk_sums(data + i - CHUNK, weights, &sum, &weighted);
+    if (a + sum >= threshold) {
+      c = envelope_scan_backward_scalar(data + i - CHUNK, CHUNK, f,
+					      threshold, &a);
+      if (a >= threshold) {
+	*acc = a;
+	return n - i + c;
+      }
+    } else {
+      a = a * f_chunk + weighted;
+    }
+    i -= CHUNK;
+  }
+  c = envelope_scan_backward_scalar(data, i, f, threshold, &a);
+  *acc = a;
+  return n - i + c;
+}
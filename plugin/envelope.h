@@ -0,0 +1,42 @@
+#ifndef __ENVELOPE_H__F3RZP0C8UB__
+#define __ENVELOPE_H__F3RZP0C8UB__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Leaky integrator envelope, acc = acc * f + |x|, used for finding
+   where sound starts or ends.
+
+   The scan functions run the integrator over the samples until the
+   accumulator reaches the threshold or the samples run out. The
+   accumulator is updated in place and the number of samples consumed
+   is returned. The threshold was reached iff *acc >= threshold after
+   the call, in which case the last consumed sample is the one that
+   crossed it.
+
+   envelope_scan_backward processes data[n-1] first and data[0] last,
+   so the crossing sample is data[n - returned value].
+*/
+
+gsize
+envelope_scan_forward(const gfloat *data, gsize n, gfloat f,
+		      gfloat threshold, gfloat *acc);
+
+gsize
+envelope_scan_backward(const gfloat *data, gsize n, gfloat f,
+		       gfloat threshold, gfloat *acc);
+
+/* Plain sample by sample versions, for reference */
+
+gsize
+envelope_scan_forward_scalar(const gfloat *data, gsize n, gfloat f,
+			     gfloat threshold, gfloat *acc);
+
+gsize
+envelope_scan_backward_scalar(const gfloat *data, gsize n, gfloat f,
+			      gfloat threshold, gfloat *acc);
+
+G_END_DECLS
+
+#endif /* __ENVELOPE_H__F3RZP0C8UB__ */
@@ -0,0 +1,129 @@
+/* Benchmark for the silence detection envelope scan.
+
+   Generates a block of synthetic material alternating between speech
+   like bursts and background noise, then scans it repeatedly until the
+   requested amount of audio has been processed. Each time the threshold
+   is crossed the accumulator is reset and scanning continues after the
+   crossing, the same way the trimmer restarts at every clip. Backward
+   scans consume the block from its end. */
+
+#include "envelope.h"
+#include <glib.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define SAMPLE_RATE 48000
+#define BLOCK_SECONDS 60
+#define F0 0.99
+#define THRESHOLD_PERCENT 10
+
+static gdouble hours = 2.0;
+static gint seed = 4711;
+
+static GOptionEntry entries[] = {
+  {"hours", 'H', 0, G_OPTION_ARG_DOUBLE, &hours,
+   "Hours of audio to scan", "H"},
+  {"seed", 's', 0, G_OPTION_ARG_INT, &seed,
+   "Random seed for the synthetic material", "N"},
+  {NULL}
+};
+
+static gfloat *
+generate_material(gsize n)
+{
+  GRand *rand = g_rand_new_with_seed(seed);
+  gfloat *data = g_new(gfloat, n);
+  gsize pos = 0;
+  gboolean speech = FALSE;
+  while(pos < n) {
+    /* Speech 0.3-3 s, pauses 0.2-5 s */
+    gsize len = (speech
+		 ? g_rand_double_range(rand, 0.3, 3.0)
+		 : g_rand_double_range(rand, 0.2, 5.0)) * SAMPLE_RATE;
+    gdouble freq = g_rand_double_range(rand, 90.0, 250.0);
+    gsize i;
+    if (len > n - pos) len = n - pos;
+    for (i = 0; i < len; i++) {
+      gdouble noise = g_rand_double_range(rand, -1.0, 1.0);
+      if (speech) {
+	/* Voiced fundamental with a syllable rate envelope */
+	gdouble env = 0.5 + 0.5 * sin(2 * G_PI * 4.0 * i / SAMPLE_RATE);
+	data[pos + i] = env * (0.3 * sin(2 * G_PI * freq * i / SAMPLE_RATE)
+			       + 0.05 * noise);
+      } else {
+	data[pos + i] = 0.001 * noise;
+      }
+    }
+    pos += len;
+    speech = !speech;
+  }
+  g_rand_free(rand);
+  return data;
+}
+
+typedef gsize (*ScanFunc)(const gfloat *data, gsize n, gfloat f,
+			  gfloat threshold, gfloat *acc);
+
+static void
+run(const gchar *name, ScanFunc scan, gboolean backward,
+    const gfloat *data, gsize n, guint64 total)
+{
+  const gfloat f = F0;
+  const gfloat t = THRESHOLD_PERCENT / (100.0 * (1 - f));
+  guint64 scanned = 0;
+  guint64 crossings = 0;
+  gint64 start;
+  gint64 elapsed;
+  gfloat acc = 0.0;
+  start = g_get_monotonic_time();
+  while(scanned < total) {
+    gsize pos = 0;
+    gsize len = n;
+    gsize block;
+    if (total - scanned < len) len = total - scanned;
+    block = len;
+    while(pos < len) {
+      if (backward) {
+	len -= scan(data, len, f, t, &acc);
+      } else {
+	pos += scan(data + pos, len - pos, f, t, &acc);
+      }
+      if (acc >= t) {
+	crossings++;
+	acc = 0.0;
+      }
+    }
+    scanned += block;
+  }
+  elapsed = g_get_monotonic_time() - start;
+  g_print("%-16s %8.3f ns/sample %10" G_GUINT64_FORMAT " crossings\n",
+	  name, elapsed * 1000.0 / scanned, crossings);
+}
+
+int
+main(int argc, char **argv)
+{
+  GError *err = NULL;
+  GOptionContext *ctxt;
+  gfloat *data;
+  gsize n = BLOCK_SECONDS * SAMPLE_RATE;
+  guint64 total;
+  ctxt = g_option_context_new(" - benchmark silence detection");
+  g_option_context_add_main_entries(ctxt, entries, NULL);
+  if (!g_option_context_parse(ctxt, &argc, &argv, &err)) {
+    g_printerr("Failed to parse options: %s\n", err->message);
+    g_clear_error(&err);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(ctxt);
+  total = hours * 3600 * SAMPLE_RATE;
+  data = generate_material(n);
+  g_print("Scanning %.2f hours (%" G_GUINT64_FORMAT " samples)\n",
+	  hours, total);
+  run("scalar", envelope_scan_forward_scalar, FALSE, data, n, total);
+  run("forward", envelope_scan_forward, FALSE, data, n, total);
+  run("backward-scalar", envelope_scan_backward_scalar, TRUE, data, n, total);
+  run("backward", envelope_scan_backward, TRUE, data, n, total);
+  g_free(data);
+  return EXIT_SUCCESS;
+}
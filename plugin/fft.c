@@ -0,0 +1,198 @@
+#include "fft.h"
+#include "simd.h"
+#include <math.h>
+
+struct _Fft
+{
+  guint n; /* Real length */
+  guint m; /* Complex length, n / 2 */
+  guint *bit_reverse;
+  /* Twiddles for the stage with half size h are at h to 2h - 1, so each
+     stage reads them in order */
+  gfloat *stage_re;
+  gfloat *stage_im;
+  /* exp(-2 pi i k / n) for k < m, for splitting the packed transform */
+  gfloat *split_re;
+  gfloat *split_im;
+  /* Work space for the complex transform */
+  gfloat *z_re;
+  gfloat *z_im;
+};
+
+Fft *
+fft_new(guint n)
+{
+  Fft *fft;
+  guint bits = 0;
+  guint i;
+  guint h;
+  g_return_val_if_fail(n >= 16 && (n & (n - 1)) == 0, NULL);
+  fft = g_new(Fft, 1);
+  fft->n = n;
+  fft->m = n / 2;
+  while ((1U << bits) < fft->m) bits++;
+  fft->bit_reverse = g_new(guint, fft->m);
+  for (i = 0; i < fft->m; i++) {
+    guint r = 0;
+    guint b;
+    for (b = 0; b < bits; b++) {
+      if (i & (1U << b)) r |= 1U << (bits - 1 - b);
+    }
+    fft->bit_reverse[i] = r;
+  }
+  fft->stage_re = g_new(gfloat, fft->m);
+  fft->stage_im = g_new(gfloat, fft->m);
+  fft->stage_re[0] = 1.0;
+  fft->stage_im[0] = 0.0;
+  for (h = 1; h < fft->m; h *= 2) {
+    guint j;
+    for (j = 0; j < h; j++) {
+      fft->stage_re[h + j] = cos(-G_PI * j / h);
+      fft->stage_im[h + j] = sin(-G_PI * j / h);
+    }
+  }
+  fft->split_re = g_new(gfloat, fft->m);
+  fft->split_im = g_new(gfloat, fft->m);
+  for (i = 0; i < fft->m; i++) {
+    fft->split_re[i] = cos(-2 * G_PI * i / n);
+    fft->split_im[i] = sin(-2 * G_PI * i / n);
+  }
+  fft->z_re = g_new(gfloat, fft->m);
+  fft->z_im = g_new(gfloat, fft->m);
+  return fft;
+}
+
+void
+fft_free(Fft *fft)
+{
+  if (!fft) return;
+  g_free(fft->bit_reverse);
+  g_free(fft->stage_re);
+  g_free(fft->stage_im);
+  g_free(fft->split_re);
+  g_free(fft->split_im);
+  g_free(fft->z_re);
+  g_free(fft->z_im);
+  g_free(fft);
+}
+
+guint
+fft_length(const Fft *fft)
+{
+  return fft->n;
+}
+
+/* In place forward transform of the bit reversed data in z_re, z_im */
+static void
+complex_transform(Fft *fft)
+{
+  gfloat *re = fft->z_re;
+  gfloat *im = fft->z_im;
+  guint m = fft->m;
+  guint h;
+  for (h = 1; h < m; h *= 2) {
+    const gfloat *w_re = fft->stage_re + h;
+    const gfloat *w_im = fft->stage_im + h;
+    guint b;
+    for (b = 0; b < m; b += 2 * h) {
+      guint j = 0;
+#ifdef HAVE_V4SF
+      for (; j + 4 <= h; j += 4) {
+	guint a = b + j;
+	guint c = a + h;
+	v4sf wr = v4sf_load(w_re + j);
+	v4sf wi = v4sf_load(w_im + j);
+	v4sf cr = v4sf_load(re + c);
+	v4sf ci = v4sf_load(im + c);
+	v4sf ar = v4sf_load(re + a);
+	v4sf ai = v4sf_load(im + a);
+	v4sf tr = wr * cr - wi * ci;
+	v4sf ti = wr * ci + wi * cr;
+	v4sf_store(re + c, ar - tr);
+	v4sf_store(im + c, ai - ti);
+	v4sf_store(re + a, ar + tr);
+	v4sf_store(im + a, ai + ti);
+      }
+#endif
+      for (; j < h; j++) {
+	guint a = b + j;
+	guint c = a + h;
+	gfloat tr = w_re[j] * re[c] - w_im[j] * im[c];
+	gfloat ti = w_re[j] * im[c] + w_im[j] * re[c];
+	re[c] = re[a] - tr;
+	im[c] = im[a] - ti;
+	re[a] += tr;
+	im[a] += ti;
+      }
+    }
+  }
+}
+
+/* Even samples go in the real part and odd in the imaginary part. Each
+   bin is then split into the transforms of the two halves,
+   E = (Z[k] + conj(Z[m-k])) / 2 and O = (Z[k] - conj(Z[m-k])) / 2i,
+   giving X[k] = E + w^k O. */
+void
+fft_forward_real(Fft *fft, const gfloat *in, gfloat *re, gfloat *im)
+{
+  guint m = fft->m;
+  guint k;
+  for (k = 0; k < m; k++) {
+    guint r = fft->bit_reverse[k];
+    fft->z_re[r] = in[2 * k];
+    fft->z_im[r] = in[2 * k + 1];
+  }
+  complex_transform(fft);
+  re[0] = fft->z_re[0] + fft->z_im[0];
+  im[0] = 0.0;
+  re[m] = fft->z_re[0] - fft->z_im[0];
+  im[m] = 0.0;
+  for (k = 1; k < m; k++) {
+    gfloat zr = fft->z_re[k];
+    gfloat zi = fft->z_im[k];
+    gfloat yr = fft->z_re[m - k];
+    gfloat yi = -fft->z_im[m - k];
+    gfloat er = 0.5 * (zr + yr);
+    gfloat ei = 0.5 * (zi + yi);
+    gfloat odd_r = 0.5 * (zi - yi);
+    gfloat odd_i = -0.5 * (zr - yr);
+    gfloat wr = fft->split_re[k];
+    gfloat wi = fft->split_im[k];
+    re[k] = er + wr * odd_r - wi * odd_i;
+    im[k] = ei + wr * odd_i + wi * odd_r;
+  }
+}
+
+/* E = (X[k] + conj(X[m-k])) / 2 and O = (X[k] - conj(X[m-k])) w^-k / 2
+   rebuild Z = E + iO. The inverse complex transform is done as
+   conj(FFT(conj(Z))) / m. */
+void
+fft_inverse_real(Fft *fft, const gfloat *re, const gfloat *im, gfloat *out)
+{
+  guint m = fft->m;
+  gfloat scale = 1.0 / m;
+  guint k;
+  for (k = 0; k < m; k++) {
+    guint r = fft->bit_reverse[k];
+    gfloat xr = re[k];
+    gfloat xi = k == 0 ? 0.0 : im[k];
+    gfloat yr = re[m - k];
+    gfloat yi = k == 0 ? 0.0 : -im[m - k];
+    gfloat er = 0.5 * (xr + yr);
+    gfloat ei = 0.5 * (xi + yi);
+    gfloat dr = 0.5 * (xr - yr);
+    gfloat di = 0.5 * (xi - yi);
+    gfloat wr = fft->split_re[k];
+    gfloat wi = -fft->split_im[k];
+    gfloat odd_r = dr * wr - di * wi;
+    gfloat odd_i = dr * wi + di * wr;
+    /* Conjugated for the forward transform */
+    fft->z_re[r] = er - odd_i;
+    fft->z_im[r] = -(ei + odd_r);
+  }
+  complex_transform(fft);
+  for (k = 0; k < m; k++) {
+    out[2 * k] = fft->z_re[k] * scale;
+    out[2 * k + 1] = -fft->z_im[k] * scale;
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef __FFT_H__P6KD3WZN8E__
+#define __FFT_H__P6KD3WZN8E__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Radix-2 FFT of real signals. The input is packed into a complex
+   transform of half the length, which runs four butterflies at a time
+   using the vectors from simd.h. */
+
+typedef struct _Fft Fft;
+
+/* n must be a power of two, at least 16 */
+Fft *
+fft_new(guint n);
+
+void
+fft_free(Fft *fft);
+
+guint
+fft_length(const Fft *fft);
+
+/* Transform n real samples. re and im get bins 0 to n/2 and must hold
+   n/2 + 1 values each. */
+void
+fft_forward_real(Fft *fft, const gfloat *in, gfloat *re, gfloat *im);
+
+/* The inverse of fft_forward_real, including the 1/n scaling. The
+   imaginary parts of bins 0 and n/2 are ignored. */
+void
+fft_inverse_real(Fft *fft, const gfloat *re, const gfloat *im, gfloat *out);
+
+G_END_DECLS
+
+#endif /* __FFT_H__P6KD3WZN8E__ */
@@ -263,6 +263,7 @@ gst_audio_test_src_init (GstAudioTestSrc * src, GstAudioTestSrcClass * g_class)
   src->can_activate_pull = DEFAULT_CAN_ACTIVATE_PULL;
 
   src->gen = NULL;
+  src->silence_buffer = NULL;
 
   src->wave = DEFAULT_WAVE;
   gst_base_src_set_blocksize (GST_BASE_SRC (src), -1);
@@ -277,6 +278,10 @@ gst_audio_test_src_finalize (GObject * object)
     g_rand_free (src->gen);
   src->gen = NULL;
 
+  if (src->silence_buffer)
+    gst_buffer_unref (src->silence_buffer);
+  src->silence_buffer = NULL;
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -317,6 +322,12 @@ gst_audio_test_src_setcaps (GstBaseSrc * basesrc, GstCaps * caps)
 
   GST_DEBUG_OBJECT (src, "negotiated to samplerate %d", src->samplerate);
 
+  /* the shared silence carries the old caps */
+  if (src->silence_buffer) {
+    gst_buffer_unref (src->silence_buffer);
+    src->silence_buffer = NULL;
+  }
+
   name = gst_structure_get_name (structure);
   if (strcmp (name, "audio/x-raw-int") == 0) {
     ret &= gst_structure_get_int (structure, "width", &width);
@@ -1070,6 +1081,13 @@ gst_audio_test_src_start (GstBaseSrc * basesrc)
 static gboolean
 gst_audio_test_src_stop (GstBaseSrc * basesrc)
 {
+  GstAudioTestSrc *src = GST_AUDIO_TEST_SRC (basesrc);
+
+  if (src->silence_buffer) {
+    gst_buffer_unref (src->silence_buffer);
+    src->silence_buffer = NULL;
+  }
+
   return TRUE;
 }
 
@@ -1140,6 +1158,29 @@ gst_audio_test_src_check_get_range (GstBaseSrc * basesrc)
   return src->can_activate_pull;
 }
 
+/* Silence is a read-only view of one zero filled buffer, so gaps cost
+ * neither an allocation nor a memset. The buffer only ever grows. */
+static GstBuffer *
+gst_audio_test_src_get_silence (GstAudioTestSrc * src, gint bytes)
+{
+  GstBuffer *buf;
+
+  if (!src->silence_buffer || GST_BUFFER_SIZE (src->silence_buffer) < bytes) {
+    if (src->silence_buffer)
+      gst_buffer_unref (src->silence_buffer);
+    src->silence_buffer = gst_buffer_new_and_alloc (bytes);
+    memset (GST_BUFFER_DATA (src->silence_buffer), 0, bytes);
+    GST_DEBUG_OBJECT (src, "allocated %d bytes of silence", bytes);
+  }
+  buf = gst_buffer_create_sub (src->silence_buffer, 0, bytes);
+  /* never let downstream write into the shared data, even when it holds
+   * the only reference to the sub buffer */
+  GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_READONLY);
+  gst_buffer_set_caps (buf, GST_PAD_CAPS (GST_BASE_SRC_PAD (src)));
+
+  return buf;
+}
+
 static GstFlowReturn
 gst_audio_test_src_create (GstBaseSrc * basesrc, guint64 offset,
     guint length, GstBuffer ** buffer)
@@ -1216,7 +1257,9 @@ gst_audio_test_src_create (GstBaseSrc * basesrc, guint64 offset,
 
   bytes = src->generate_samples_per_buffer * src->sample_size * src->channels;
 
-  if ((res = gst_pad_alloc_buffer (basesrc->srcpad, src->next_sample,
+  if (src->wave == GST_AUDIO_TEST_SRC_WAVE_SILENCE) {
+    buf = gst_audio_test_src_get_silence (src, bytes);
+  } else if ((res = gst_pad_alloc_buffer (basesrc->srcpad, src->next_sample,
               bytes, GST_PAD_CAPS (basesrc->srcpad), &buf)) != GST_FLOW_OK) {
     return res;
   }
@@ -1249,7 +1292,8 @@ gst_audio_test_src_create (GstBaseSrc * basesrc, guint64 offset,
       src->generate_samples_per_buffer,
       GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)));
 
-  src->process (src, GST_BUFFER_DATA (buf));
+  if (src->wave != GST_AUDIO_TEST_SRC_WAVE_SILENCE)
+    src->process (src, GST_BUFFER_DATA (buf));
 
   if (G_UNLIKELY ((src->wave == GST_AUDIO_TEST_SRC_WAVE_SILENCE)
           || (src->volume == 0.0))) {
@@ -142,6 +142,9 @@ struct _GstAudioTestSrc {
   GstPinkNoise pink;
   GstRedNoise red;
   gdouble wave_table[1024];
+
+  /* zero filled, silence is handed out as read-only sub buffers of it */
+  GstBuffer *silence_buffer;
 };
 
 struct _GstAudioTestSrcClass {
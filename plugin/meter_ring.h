@@ -0,0 +1,89 @@
+#ifndef __METER_RING_H__Q5J0ZB3HWE__
+#define __METER_RING_H__Q5J0ZB3HWE__
+
+#include <glib.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Single producer, single consumer ring of meter values.
+
+   The producer (a streaming thread) only writes head and the consumer
+   (normally the UI) only writes tail, so no locking is needed. When the
+   ring is full new values are dropped and counted as overruns rather
+   than blocking the producer. */
+
+#define METER_RING_SIZE 256 /* Must be a power of two */
+
+typedef struct _MeterValue MeterValue;
+typedef struct _MeterRing MeterRing;
+
+struct _MeterValue
+{
+  GstClockTime timestamp; /* End of the measured interval */
+  gfloat power; /* Mean square, as a fraction (not dB) */
+  gfloat peak; /* Largest absolute sample value */
+  gfloat true_peak; /* Largest absolute value at 4x oversampling */
+};
+
+struct _MeterRing
+{
+  volatile gint head; /* Next position to write */
+  volatile gint tail; /* Next position to read */
+  volatile gint overruns;
+  MeterValue values[METER_RING_SIZE];
+};
+
+static inline MeterRing *
+meter_ring_new(void)
+{
+  return g_new0(MeterRing, 1);
+}
+
+static inline void
+meter_ring_free(MeterRing *ring)
+{
+  g_free(ring);
+}
+
+/* Producer side. Returns FALSE if the ring is full. */
+static inline gboolean
+meter_ring_push(MeterRing *ring, const MeterValue *value)
+{
+  guint head = (guint)ring->head;
+  guint tail = (guint)g_atomic_int_get(&ring->tail);
+  if (head - tail >= METER_RING_SIZE) {
+    g_atomic_int_inc(&ring->overruns);
+    return FALSE;
+  }
+  ring->values[head & (METER_RING_SIZE - 1)] = *value;
+  g_atomic_int_set(&ring->head, (gint)(head + 1));
+  return TRUE;
+}
+
+/* Consumer side. Copies up to max values, oldest first, and returns
+   the number copied. */
+static inline guint
+meter_ring_pop(MeterRing *ring, MeterValue *values, guint max)
+{
+  guint tail = (guint)ring->tail;
+  guint head = (guint)g_atomic_int_get(&ring->head);
+  guint n = 0;
+  while(tail != head && n < max) {
+    values[n++] = ring->values[tail & (METER_RING_SIZE - 1)];
+    tail++;
+  }
+  g_atomic_int_set(&ring->tail, (gint)tail);
+  return n;
+}
+
+/* Consumer side. Discard all values currently in the ring. */
+static inline void
+meter_ring_clear(MeterRing *ring)
+{
+  g_atomic_int_set(&ring->tail, g_atomic_int_get(&ring->head));
+}
+
+G_END_DECLS
+
+#endif /* __METER_RING_H__Q5J0ZB3HWE__ */
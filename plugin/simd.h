@@ -0,0 +1,90 @@
+#ifndef __SIMD_H__K7W2QX9DLM__
+#define __SIMD_H__K7W2QX9DLM__
+
+#include <glib.h>
+#include <string.h>
+
+/* Four float lanes using the GCC/Clang vector extensions. The compiler
+   maps these to SSE, NEON or AltiVec as available and to scalar code
+   otherwise. Code using them must provide a plain C path when
+   HAVE_V4SF isn't defined. */
+
+#if defined(__GNUC__)
+#define HAVE_V4SF 1
+
+typedef gfloat v4sf __attribute__ ((vector_size (16)));
+typedef gint32 v4si __attribute__ ((vector_size (16)));
+
+/* Four double lanes, for recursive filters that need the precision.
+   Split into pairs of SSE2 registers when AVX isn't available. */
+typedef gdouble v4df __attribute__ ((vector_size (32)));
+
+static inline v4sf
+v4sf_load(const gfloat *p)
+{
+  v4sf v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void
+v4sf_store(gfloat *p, v4sf v)
+{
+  memcpy(p, &v, sizeof(v));
+}
+
+static inline v4sf
+v4sf_set1(gfloat x)
+{
+  v4sf v = {x, x, x, x};
+  return v;
+}
+
+static inline v4sf
+v4sf_abs(v4sf v)
+{
+  const v4si mask = {0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff};
+  return (v4sf)((v4si)v & mask);
+}
+
+static inline v4sf
+v4sf_max(v4sf a, v4sf b)
+{
+  return (v4sf)(((v4si)(a > b) & (v4si)a) | (~(v4si)(a > b) & (v4si)b));
+}
+
+/* A macro, since passing 32 byte vectors by value changes with AVX */
+#define v4df_set1(x) ((v4df){(x), (x), (x), (x)})
+
+/* Four integer samples converted to float and multiplied by scale */
+static inline v4sf
+v4sf_from_s16(const gint16 *p, gfloat scale)
+{
+  v4sf v = {p[0], p[1], p[2], p[3]};
+  return v * v4sf_set1(scale);
+}
+
+static inline v4sf
+v4sf_from_s32(const gint32 *p, gfloat scale)
+{
+  v4sf v = {p[0], p[1], p[2], p[3]};
+  return v * v4sf_set1(scale);
+}
+
+static inline gfloat
+v4sf_hsum(v4sf v)
+{
+  return (v[0] + v[1]) + (v[2] + v[3]);
+}
+
+static inline gfloat
+v4sf_hmax(v4sf v)
+{
+  gfloat a = v[0] > v[1] ? v[0] : v[1];
+  gfloat b = v[2] > v[3] ? v[2] : v[3];
+  return a > b ? a : b;
+}
+
+#endif /* __GNUC__ */
+
+#endif /* __SIMD_H__K7W2QX9DLM__ */
@@ -1,11 +1,15 @@
 #include "gstaudiotestsrc.h"
 #include "audiormspower.h"
+#include "audiodenoise.h"
+#include "audiotrim.h"
 
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
   if (!gst_audio_test_src_plugin_init (plugin)) return FALSE;
   if (!audio_rms_power_plugin_init (plugin)) return FALSE;
+  if (!audio_denoise_plugin_init (plugin)) return FALSE;
+  if (!audio_trim_plugin_init (plugin)) return FALSE;
   return TRUE;
 }
 
@@ -0,0 +1,103 @@
+#include "true_peak.h"
+#include "simd.h"
+#include <string.h>
+#include <math.h>
+
+#define PHASES 4
+#define CHUNK 64
+
+/* coeffs[j][p] is tap j of phase p, so each row can be loaded as one
+   vector computing all four phases at once */
+static const gfloat coeffs[TRUE_PEAK_TAPS][PHASES] =
+  {
+    { 0.0017089843750, -0.0291748046875, -0.0189208984375, -0.0083007812500},
+    { 0.0109863281250,  0.0292968750000,  0.0330810546875,  0.0148925781250},
+    {-0.0196533203125, -0.0517578125000, -0.0582275390625, -0.0266113281250},
+    { 0.0332031250000,  0.0891113281250,  0.1015625000000,  0.0476074218750},
+    {-0.0594482421875, -0.1665039062500, -0.2003173828125, -0.1022949218750},
+    { 0.1373291015625,  0.4650878906250,  0.7797851562500,  0.9721679687500},
+    { 0.9721679687500,  0.7797851562500,  0.4650878906250,  0.1373291015625},
+    {-0.1022949218750, -0.2003173828125, -0.1665039062500, -0.0594482421875},
+    { 0.0476074218750,  0.1015625000000,  0.0891113281250,  0.0332031250000},
+    {-0.0266113281250, -0.0582275390625, -0.0517578125000, -0.0196533203125},
+    { 0.0148925781250,  0.0330810546875,  0.0292968750000,  0.0109863281250},
+    {-0.0083007812500, -0.0189208984375, -0.0291748046875,  0.0017089843750}
+  };
+
+void
+true_peak_reset(TruePeak *tp)
+{
+  memset(tp->history, 0, sizeof(tp->history));
+}
+
+gboolean
+true_peak_settle(TruePeak *tp, gfloat floor)
+{
+  guint i;
+  for (i = 0; i < TRUE_PEAK_TAPS - 1; i++) {
+    if (fabsf(tp->history[i]) > floor) return FALSE;
+  }
+  true_peak_reset(tp);
+  return TRUE;
+}
+
+/* x points to TRUE_PEAK_TAPS - 1 samples of history followed by n new
+   samples */
+static gfloat
+interpolate(const gfloat *x, guint n, gfloat peak)
+{
+  guint i;
+#ifdef HAVE_V4SF
+  v4sf h[TRUE_PEAK_TAPS];
+  v4sf max = v4sf_set1(peak);
+  guint j;
+  for (j = 0; j < TRUE_PEAK_TAPS; j++) {
+    h[j] = v4sf_load(coeffs[j]);
+  }
+  for (i = 0; i < n; i++) {
+    const gfloat *newest = x + i + TRUE_PEAK_TAPS - 1;
+    v4sf acc = v4sf_set1(0.0);
+    for (j = 0; j < TRUE_PEAK_TAPS; j++) {
+      acc += v4sf_set1(newest[-(gint)j]) * h[j];
+    }
+    max = v4sf_max(max, v4sf_abs(acc));
+  }
+  return v4sf_hmax(max);
+#else
+  for (i = 0; i < n; i++) {
+    const gfloat *newest = x + i + TRUE_PEAK_TAPS - 1;
+    guint p;
+    for (p = 0; p < PHASES; p++) {
+      gfloat acc = 0.0;
+      guint j;
+      for (j = 0; j < TRUE_PEAK_TAPS; j++) {
+	acc += newest[-(gint)j] * coeffs[j][p];
+      }
+      acc = fabsf(acc);
+      if (acc > peak) peak = acc;
+    }
+  }
+  return peak;
+#endif
+}
+
+gfloat
+true_peak_process(TruePeak *tp, const gfloat *data, guint n, guint stride,
+		  gfloat peak)
+{
+  gfloat x[TRUE_PEAK_TAPS - 1 + CHUNK];
+  memcpy(x, tp->history, sizeof(tp->history));
+  while(n > 0) {
+    guint c = n < CHUNK ? n : CHUNK;
+    guint i;
+    for (i = 0; i < c; i++) {
+      x[TRUE_PEAK_TAPS - 1 + i] = *data;
+      data += stride;
+    }
+    peak = interpolate(x, c, peak);
+    memmove(x, x + c, sizeof(tp->history));
+    n -= c;
+  }
+  memcpy(tp->history, x, sizeof(tp->history));
+  return peak;
+}
@@ -0,0 +1,39 @@
+#ifndef __TRUE_PEAK_H__H2M8VR6TQA__
+#define __TRUE_PEAK_H__H2M8VR6TQA__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* True-peak measurement by 4x oversampling, using the 48 tap
+   polyphase interpolation filter from ITU-R BS.1770-4 Annex 2 */
+
+#define TRUE_PEAK_TAPS 12 /* Taps per phase */
+
+typedef struct _TruePeak TruePeak;
+
+struct _TruePeak
+{
+  /* Last input samples, oldest first */
+  gfloat history[TRUE_PEAK_TAPS - 1];
+};
+
+void
+true_peak_reset(TruePeak *tp);
+
+/* Returns TRUE if no history sample is larger than floor. The history
+   is then cleared, so that silent input gives exactly zero from here
+   on. */
+gboolean
+true_peak_settle(TruePeak *tp, gfloat floor);
+
+/* Interpolate n samples, taking every stride'th value from data.
+   Returns the largest absolute interpolated value, or peak if that is
+   larger. */
+gfloat
+true_peak_process(TruePeak *tp, const gfloat *data, guint n, guint stride,
+		  gfloat peak);
+
+G_END_DECLS
+
+#endif /* __TRUE_PEAK_H__H2M8VR6TQA__ */
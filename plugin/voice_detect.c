@@ -0,0 +1,379 @@
+#include "voice_detect.h"
+#include "fft.h"
+#include "simd.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOP_MS 10
+/* Bands in Hz */
+#define SPEECH_LOW 300
+#define SPEECH_HIGH 4000
+#define HIGH_BAND_HIGH 8000
+/* The noise floor of a band is this percentile of its frames */
+#define NOISE_PERCENTILE 10
+/* Speech is at least this much above the noise floor, 10dB */
+#define VOICE_SNR 10.0
+/* White noise has a flatness around 0.56, voiced speech well below */
+#define VOICE_FLATNESS 0.35
+/* Shorter voiced runs are clicks and bumps */
+#define MIN_VOICE_MS 50
+/* Unvoiced sounds at either end, such as fricatives, are included
+   for at most this long */
+#define EXTEND_MS 150
+/* How far a cut may move to reach a quiet point */
+#define REFINE_MS 20
+/* Samples in the moving energy used for finding quiet points */
+#define QUIET_WINDOW 32
+
+typedef struct
+{
+  gfloat speech; /* Mean square in the speech band */
+  gfloat high; /* Mean square above the speech band */
+  gfloat flatness; /* Of the speech band */
+  gfloat power; /* Mean of the caller's square sums over the frame */
+  guint64 quiet_pos; /* Quietest point of the hop */
+  gfloat quiet_energy;
+} VoiceFrame;
+
+struct _VoiceDetect
+{
+  guint hop;
+  guint ms; /* Samples per millisecond */
+  /* A frame of frame_length samples is analyzed for each hop */
+  guint frame_length;
+  Fft *fft;
+  gfloat *window;
+  gfloat power_scale; /* From bin power to mean square */
+  guint speech_low; /* Bins */
+  guint speech_high;
+  guint high_band_high;
+  gfloat *input; /* Last frame_length samples, mixed down */
+  guint fill; /* Samples of the next hop */
+  /* Square sums given by the caller for the current and the previous
+     hop */
+  gdouble square_acc;
+  gdouble last_square_acc;
+  gfloat *work;
+  gfloat *re;
+  gfloat *im;
+  /* Moving energy of the last QUIET_WINDOW samples */
+  gfloat quiet_ring[QUIET_WINDOW];
+  guint quiet_index;
+  gdouble quiet_sum;
+  gfloat quiet_min; /* In the current hop */
+  guint64 quiet_pos;
+  guint64 samples;
+  GArray *frames; /* VoiceFrame for each hop */
+};
+
+VoiceDetect *
+voice_detect_new(guint rate)
+{
+  VoiceDetect *vd = g_new(VoiceDetect, 1);
+  guint frame = 16;
+  guint bins;
+  gdouble window_power = 0.0;
+  guint i;
+  vd->hop = rate * HOP_MS / 1000;
+  vd->ms = rate / 1000;
+  /* A frame covers two hops */
+  while (frame < 2 * vd->hop) frame *= 2;
+  bins = frame / 2 + 1;
+  vd->frame_length = frame;
+  vd->fft = fft_new(frame);
+  vd->window = g_new(gfloat, frame);
+  for (i = 0; i < frame; i++) {
+    vd->window[i] = 0.5 - 0.5 * cos(2 * G_PI * i / frame);
+    window_power += vd->window[i] * vd->window[i];
+  }
+  /* Each bin except DC and Nyquist stands for a pair */
+  vd->power_scale = 2.0 / (frame * window_power);
+  vd->speech_low = MIN((guint64)SPEECH_LOW * frame / rate, bins);
+  vd->speech_high = MIN((guint64)SPEECH_HIGH * frame / rate, bins);
+  vd->high_band_high = MIN((guint64)HIGH_BAND_HIGH * frame / rate, bins);
+  vd->input = g_new(gfloat, frame);
+  vd->work = g_new(gfloat, frame);
+  vd->re = g_new(gfloat, bins);
+  vd->im = g_new(gfloat, bins);
+  vd->frames = g_array_new(FALSE, FALSE, sizeof(VoiceFrame));
+  voice_detect_reset(vd);
+  return vd;
+}
+
+void
+voice_detect_free(VoiceDetect *vd)
+{
+  if (!vd) return;
+  fft_free(vd->fft);
+  g_free(vd->window);
+  g_free(vd->input);
+  g_free(vd->work);
+  g_free(vd->re);
+  g_free(vd->im);
+  g_array_free(vd->frames, TRUE);
+  g_free(vd);
+}
+
+void
+voice_detect_reset(VoiceDetect *vd)
+{
+  memset(vd->input, 0, vd->frame_length * sizeof(gfloat));
+  vd->fill = 0;
+  vd->square_acc = 0.0;
+  vd->last_square_acc = 0.0;
+  memset(vd->quiet_ring, 0, sizeof(vd->quiet_ring));
+  vd->quiet_index = 0;
+  vd->quiet_sum = 0.0;
+  vd->quiet_min = G_MAXFLOAT;
+  vd->quiet_pos = 0;
+  vd->samples = 0;
+  g_array_set_size(vd->frames, 0);
+}
+
+guint64
+voice_detect_samples(const VoiceDetect *vd)
+{
+  return vd->samples;
+}
+
+/* Power of each bin, stored in re */
+static void
+bin_power(gfloat *re, const gfloat *im, guint n)
+{
+  guint i = 0;
+#ifdef HAVE_V4SF
+  for (; i + 4 <= n; i += 4) {
+    v4sf r = v4sf_load(re + i);
+    v4sf m = v4sf_load(im + i);
+    v4sf_store(re + i, r * r + m * m);
+  }
+#endif
+  for (; i < n; i++) {
+    re[i] = re[i] * re[i] + im[i] * im[i];
+  }
+}
+
+static gfloat
+band_sum(const gfloat *power, guint low, guint high)
+{
+  guint i = low;
+  gfloat sum = 0.0;
+#ifdef HAVE_V4SF
+  v4sf acc = v4sf_set1(0.0);
+  for (; i + 4 <= high; i += 4) {
+    acc += v4sf_load(power + i);
+  }
+  sum = v4sf_hsum(acc);
+#endif
+  for (; i < high; i++) {
+    sum += power[i];
+  }
+  return sum;
+}
+
+static void
+end_hop(VoiceDetect *vd)
+{
+  guint frame = vd->frame_length;
+  guint bins = frame / 2 + 1;
+  guint speech_bins = vd->speech_high - vd->speech_low;
+  VoiceFrame f;
+  gfloat speech_sum;
+  gdouble log_sum = 0.0;
+  guint i = 0;
+#ifdef HAVE_V4SF
+  for (; i + 4 <= frame; i += 4) {
+    v4sf_store(vd->work + i,
+	       v4sf_load(vd->input + i) * v4sf_load(vd->window + i));
+  }
+#endif
+  for (; i < frame; i++) {
+    vd->work[i] = vd->input[i] * vd->window[i];
+  }
+  fft_forward_real(vd->fft, vd->work, vd->re, vd->im);
+  bin_power(vd->re, vd->im, bins);
+  speech_sum = band_sum(vd->re, vd->speech_low, vd->speech_high);
+  f.speech = speech_sum * vd->power_scale;
+  f.high = (band_sum(vd->re, vd->speech_high, vd->high_band_high)
+	    * vd->power_scale);
+  /* The frame covers about the last two hops */
+  f.power = (vd->square_acc + vd->last_square_acc) / (2 * vd->hop);
+  /* Geometric over arithmetic mean */
+  for (i = vd->speech_low; i < vd->speech_high; i++) {
+    log_sum += log(vd->re[i] + 1e-20);
+  }
+  f.flatness = (speech_bins > 0
+		? (exp(log_sum / speech_bins)
+		   / (speech_sum / speech_bins + 1e-20))
+		: 1.0);
+  f.quiet_pos = vd->quiet_pos;
+  f.quiet_energy = vd->quiet_min;
+  g_array_append_val(vd->frames, f);
+
+  memmove(vd->input, vd->input + vd->hop,
+	  (frame - vd->hop) * sizeof(gfloat));
+  vd->fill = 0;
+  vd->last_square_acc = vd->square_acc;
+  vd->square_acc = 0.0;
+  vd->quiet_min = G_MAXFLOAT;
+}
+
+guint
+voice_detect_hop_left(const VoiceDetect *vd)
+{
+  return vd->hop - vd->fill;
+}
+
+void
+voice_detect_process(VoiceDetect *vd, const gfloat *data, guint n,
+		     guint channels, const gfloat *weights,
+		     gfloat square_sum)
+{
+  gfloat scale = 1.0 / channels;
+  guint i;
+  g_return_if_fail(n <= vd->hop - vd->fill);
+  vd->square_acc += square_sum;
+  for (i = 0; i < n; i++) {
+    gfloat x = 0.0;
+    gfloat e;
+    if (data) {
+      guint c;
+      for (c = 0; c < channels; c++) {
+	x += weights[c] * data[i * channels + c];
+      }
+      x *= scale;
+    }
+    vd->input[vd->frame_length - vd->hop + vd->fill] = x;
+    e = x * x;
+    vd->quiet_sum += e - vd->quiet_ring[vd->quiet_index];
+    vd->quiet_ring[vd->quiet_index] = e;
+    vd->quiet_index = (vd->quiet_index + 1) % QUIET_WINDOW;
+    if (vd->quiet_sum < vd->quiet_min) {
+      vd->quiet_min = vd->quiet_sum;
+      /* Middle of the window */
+      vd->quiet_pos = (vd->samples > QUIET_WINDOW / 2
+		       ? vd->samples - QUIET_WINDOW / 2 : 0);
+    }
+    vd->samples++;
+    if (++vd->fill == vd->hop) end_hop(vd);
+  }
+}
+
+static int
+compare_float(const void *a, const void *b)
+{
+  gfloat x = *(const gfloat*)a;
+  gfloat y = *(const gfloat*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/* The noise floor of the band at the given offset in VoiceFrame */
+static gfloat
+noise_floor(VoiceDetect *vd, gsize offset)
+{
+  guint n = vd->frames->len;
+  gfloat *values = g_new(gfloat, n);
+  gfloat floor;
+  guint i;
+  for (i = 0; i < n; i++) {
+    const VoiceFrame *f = &g_array_index(vd->frames, VoiceFrame, i);
+    values[i] = *(const gfloat*)((const guint8*)f + offset);
+  }
+  qsort(values, n, sizeof(gfloat), compare_float);
+  floor = values[n * NOISE_PERCENTILE / 100];
+  g_free(values);
+  return floor;
+}
+
+/* First sample of the hop at the middle of the frame analyzed after
+   hop k. Negative for the first frames, which are mostly padding. */
+static gint64
+frame_start(VoiceDetect *vd, guint k)
+{
+  return ((gint64)(k + 1) * vd->hop - vd->frame_length / 2
+	  - vd->hop / 2);
+}
+
+/* The quietest point between low and high, or target if no hop has
+   its quietest point there */
+static guint64
+quiet_point(VoiceDetect *vd, guint64 target, guint64 low, guint64 high)
+{
+  guint64 best = target;
+  gfloat best_energy = G_MAXFLOAT;
+  guint k;
+  for (k = low / vd->hop; k <= high / vd->hop && k < vd->frames->len; k++) {
+    const VoiceFrame *f = &g_array_index(vd->frames, VoiceFrame, k);
+    if (f->quiet_pos < low || f->quiet_pos > high) continue;
+    if (f->quiet_energy < best_energy) {
+      best_energy = f->quiet_energy;
+      best = f->quiet_pos;
+    }
+  }
+  return best;
+}
+
+gboolean
+voice_detect_trim(VoiceDetect *vd, guint64 margin, gfloat min_power,
+		  guint64 *start, guint64 *end, guint64 *onset_pos)
+{
+  const VoiceFrame *frames = (const VoiceFrame*)vd->frames->data;
+  guint n = vd->frames->len;
+  guint min_voice = MAX(MIN_VOICE_MS / HOP_MS, 1);
+  guint extend = EXTEND_MS / HOP_MS;
+  guint64 refine = REFINE_MS * vd->ms;
+  gfloat speech_floor;
+  gfloat high_floor;
+  guint first = n;
+  guint last = n;
+  guint run = 0;
+  guint64 onset;
+  guint64 offset;
+  guint64 target;
+  guint k;
+  if (n == 0) return FALSE;
+  speech_floor = noise_floor(vd, G_STRUCT_OFFSET(VoiceFrame, speech));
+  high_floor = noise_floor(vd, G_STRUCT_OFFSET(VoiceFrame, high));
+  for (k = 0; k < n; k++) {
+    if (frames[k].speech > VOICE_SNR * speech_floor
+	&& frames[k].flatness < VOICE_FLATNESS
+	&& frames[k].power > min_power) {
+      if (++run >= min_voice) {
+	if (first == n) first = k + 1 - min_voice;
+	last = k;
+      }
+    } else {
+      run = 0;
+    }
+  }
+  if (first == n) return FALSE;
+
+  /* Include unvoiced sounds next to the speech */
+  for (k = 0; k < extend && first > 0; k++) {
+    const VoiceFrame *f = &frames[first - 1];
+    if (f->power <= min_power
+	|| (f->speech <= VOICE_SNR * speech_floor
+	    && f->high <= VOICE_SNR * high_floor)) break;
+    first--;
+  }
+  for (k = 0; k < extend && last + 1 < n; k++) {
+    const VoiceFrame *f = &frames[last + 1];
+    if (f->power <= min_power
+	|| (f->speech <= VOICE_SNR * speech_floor
+	    && f->high <= VOICE_SNR * high_floor)) break;
+    last++;
+  }
+
+  onset = MAX(frame_start(vd, first), 0);
+  offset = MIN(MAX(frame_start(vd, last) + vd->hop, 0), vd->samples);
+  target = onset > margin ? onset - margin : 0;
+  *start = quiet_point(vd, target, target > refine ? target - refine : 0,
+		       MIN(target + refine, onset));
+  target = MIN(offset + margin, vd->samples);
+  *end = quiet_point(vd, target,
+		     target > offset + refine ? target - refine : offset,
+		     MIN(target + refine, vd->samples));
+  *onset_pos = onset;
+  return TRUE;
+}
@@ -0,0 +1,54 @@
+#ifndef __VOICE_DETECT_H__R8LW3MXC5J__
+#define __VOICE_DETECT_H__R8LW3MXC5J__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Voice activity detection for trimming recorded takes. Band energies
+   and the spectral flatness of the speech band are measured every 10ms
+   and kept until the end of the take, when the noise floor is known.
+   Speech is where the speech band is well above the noise floor and
+   its spectrum is peaked rather than flat, as for breaths and
+   ventilation noise. */
+
+typedef struct _VoiceDetect VoiceDetect;
+
+VoiceDetect *
+voice_detect_new(guint rate);
+
+void
+voice_detect_free(VoiceDetect *vd);
+
+void
+voice_detect_reset(VoiceDetect *vd);
+
+/* Analyze n frames of interleaved samples, mixing the channels down
+   using weights. NULL data is silence. square_sum is the sum of the
+   squared samples as the caller measures power, which is what
+   min_power of voice_detect_trim() is compared with. n must not exceed
+   voice_detect_hop_left(). */
+void
+voice_detect_process(VoiceDetect *vd, const gfloat *data, guint n,
+		     guint channels, const gfloat *weights,
+		     gfloat square_sum);
+
+/* Samples until the current hop ends */
+guint
+voice_detect_hop_left(const VoiceDetect *vd);
+
+/* Samples analyzed since the last reset */
+guint64
+voice_detect_samples(const VoiceDetect *vd);
+
+/* Sample positions for trimming the take, margin samples outside the
+   speech and moved to the quietest point nearby. onset is where the
+   speech itself starts. Frames with a power below min_power, from the
+   square sums given to voice_detect_process(), are never speech. Returns FALSE if no speech was found. */
+gboolean
+voice_detect_trim(VoiceDetect *vd, guint64 margin, gfloat min_power,
+		  guint64 *start, guint64 *end, guint64 *onset);
+
+G_END_DECLS
+
+#endif /* __VOICE_DETECT_H__R8LW3MXC5J__ */
@@ -0,0 +1,201 @@
+#include <clean_files.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define BATCH_SIZE 64
+
+GQuark
+clean_files_error_quark()
+{
+  static GQuark error_quark = 0;
+  if (error_quark == 0)
+    error_quark = g_quark_from_static_string ("clean-files-error-quark");
+  return error_quark;
+}
+
+struct _CleanFilesPlan
+{
+  gchar *directory; /* Local path */
+  GPtrArray *names;
+  guint64 size;
+};
+
+typedef struct
+{
+  CleanFilesPlan *plan;
+  GHashTable *keep;
+} PlanCtxt;
+
+typedef struct
+{
+  CleanFilesPlan *plan;
+  gboolean to_trash;
+  CleanFilesProgress progress;
+  CleanFilesDone done;
+  gpointer user_data;
+  /* Written by the worker, read in the main thread */
+  volatile gint removed;
+  GError *error;
+} CleanJob;
+
+static void
+keep_file(const gchar *filename, gpointer user_data)
+{
+  GHashTable *keep = user_data;
+  g_hash_table_add(keep, g_strdup(filename));
+}
+
+static void
+check_file(const WorkingDirIndexEntry *entry, gpointer user_data)
+{
+  PlanCtxt *ctxt = user_data;
+  gboolean keep;
+  if (entry->raw) {
+    gchar *name;
+    if (entry->mic > 0) {
+      name = g_strdup_printf("%s_%s_%u_m%u.wav", entry->reel, entry->spot,
+			     entry->version, entry->mic);
+    } else {
+      name = g_strdup_printf("%s_%s_%u.wav",
+			     entry->reel, entry->spot, entry->version);
+    }
+    keep = g_hash_table_contains(ctxt->keep, name);
+    g_free(name);
+  } else {
+    keep = g_hash_table_contains(ctxt->keep, entry->name);
+  }
+  if (keep) return;
+  g_ptr_array_add(ctxt->plan->names, g_strdup(entry->name));
+  ctxt->plan->size += entry->size;
+}
+
+CleanFilesPlan *
+clean_files_plan(SubtitleStore *store, WorkingDirIndex *index,
+		 CleanFilesMode mode)
+{
+  PlanCtxt ctxt;
+  CleanFilesPlan *plan;
+  g_return_val_if_fail(working_dir_index_is_ready(index), NULL);
+  plan = g_new(CleanFilesPlan, 1);
+  plan->directory = g_file_get_path(index->directory);
+  plan->names = g_ptr_array_new_with_free_func(g_free);
+  plan->size = 0;
+  ctxt.plan = plan;
+  ctxt.keep = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  subtitle_store_foreach_file(store, mode == CLEAN_FILES_NOT_SELECTED,
+			      keep_file, ctxt.keep);
+  working_dir_index_foreach(index, check_file, &ctxt);
+  g_hash_table_destroy(ctxt.keep);
+  return plan;
+}
+
+guint
+clean_files_plan_n_files(const CleanFilesPlan *plan)
+{
+  return plan->names->len;
+}
+
+guint64
+clean_files_plan_size(const CleanFilesPlan *plan)
+{
+  return plan->size;
+}
+
+void
+clean_files_plan_free(CleanFilesPlan *plan)
+{
+  g_free(plan->directory);
+  g_ptr_array_free(plan->names, TRUE);
+  g_free(plan);
+}
+
+static gboolean
+report_progress(gpointer user_data)
+{
+  CleanJob *job = user_data;
+  if (job->progress) {
+    job->progress(g_atomic_int_get(&job->removed), job->plan->names->len,
+		  job->user_data);
+  }
+  return FALSE;
+}
+
+static gboolean
+report_done(gpointer user_data)
+{
+  CleanJob *job = user_data;
+  if (job->done) {
+    job->done(job->removed, job->error, job->user_data);
+  }
+  g_clear_error(&job->error);
+  clean_files_plan_free(job->plan);
+  g_free(job);
+  return FALSE;
+}
+
+static gpointer
+clean_thread(gpointer user_data)
+{
+  CleanJob *job = user_data;
+  CleanFilesPlan *plan = job->plan;
+  gchar *trash = NULL;
+  guint i;
+  if (job->to_trash) {
+    trash = g_build_filename(plan->directory, CLEAN_FILES_TRASH_DIR, NULL);
+    if (g_mkdir_with_parents(trash, 0777) < 0) {
+      int errsv = errno;
+      g_set_error(&job->error, CLEAN_FILES_ERROR, CLEAN_FILES_ERROR_FAILED,
+		  "Failed to create %s: %s", trash, g_strerror(errsv));
+      g_free(trash);
+      g_idle_add(report_done, job);
+      return NULL;
+    }
+  }
+  for (i = 0; i < plan->names->len; i++) {
+    const gchar *name = g_ptr_array_index(plan->names, i);
+    gchar *path = g_build_filename(plan->directory, name, NULL);
+    int res;
+    if (trash) {
+      gchar *dest = g_build_filename(trash, name, NULL);
+      res = g_rename(path, dest);
+      g_free(dest);
+    } else {
+      res = g_unlink(path);
+    }
+    if (res < 0 && errno != ENOENT) {
+      int errsv = errno;
+      g_set_error(&job->error, CLEAN_FILES_ERROR, CLEAN_FILES_ERROR_FAILED,
+		  "Failed to remove %s: %s", path, g_strerror(errsv));
+      g_free(path);
+      break;
+    }
+    g_free(path);
+    g_atomic_int_inc(&job->removed);
+    if ((i + 1) % BATCH_SIZE == 0) {
+      g_idle_add(report_progress, job);
+    }
+  }
+  g_free(trash);
+  /* Runs after any pending progress reports */
+  g_idle_add(report_done, job);
+  return NULL;
+}
+
+void
+clean_files_run(CleanFilesPlan *plan, gboolean to_trash,
+		CleanFilesProgress progress, CleanFilesDone done,
+		gpointer user_data)
+{
+  GThread *thread;
+  CleanJob *job = g_new(CleanJob, 1);
+  job->plan = plan;
+  job->to_trash = to_trash;
+  job->progress = progress;
+  job->done = done;
+  job->user_data = user_data;
+  job->removed = 0;
+  job->error = NULL;
+  thread = g_thread_new("clean-files", clean_thread, job);
+  g_thread_unref(thread);
+}
@@ -0,0 +1,54 @@
+#ifndef __CLEAN_FILES_H__B2HX6RKQ9W__
+#define __CLEAN_FILES_H__B2HX6RKQ9W__
+
+#include <subtitle_store.h>
+#include <working_dir_index.h>
+
+#define CLEAN_FILES_ERROR (clean_files_error_quark())
+enum {
+  CLEAN_FILES_ERROR_FAILED = 1,
+};
+
+typedef enum
+{
+  CLEAN_FILES_NOT_IN_LIST, /* Files not in any spot's file list */
+  CLEAN_FILES_NOT_SELECTED /* Files not active for any spot */
+} CleanFilesMode;
+
+/* Raw recordings follow their processed file, they are kept if it is
+   kept */
+
+#define CLEAN_FILES_TRASH_DIR "trash"
+
+typedef struct _CleanFilesPlan CleanFilesPlan;
+
+/* Called in the main thread */
+typedef void (*CleanFilesProgress)(guint done, guint total,
+				   gpointer user_data);
+typedef void (*CleanFilesDone)(guint removed, const GError *error,
+			       gpointer user_data);
+
+/* Find the files to remove. The index must be ready. */
+CleanFilesPlan *
+clean_files_plan(SubtitleStore *store, WorkingDirIndex *index,
+		 CleanFilesMode mode);
+
+guint
+clean_files_plan_n_files(const CleanFilesPlan *plan);
+
+/* Disk space freed by removing the files */
+guint64
+clean_files_plan_size(const CleanFilesPlan *plan);
+
+void
+clean_files_plan_free(CleanFilesPlan *plan);
+
+/* Remove the files in a worker thread, or move them to
+   CLEAN_FILES_TRASH_DIR in the working directory. Takes ownership of
+   the plan. Stops at the first error. */
+void
+clean_files_run(CleanFilesPlan *plan, gboolean to_trash,
+		CleanFilesProgress progress, CleanFilesDone done,
+		gpointer user_data);
+
+#endif /* __CLEAN_FILES_H__B2HX6RKQ9W__ */
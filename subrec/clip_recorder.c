@@ -1,4 +1,8 @@
 #include <clip_recorder.h>
+#include <trace_log.h>
+#include <wav_file.h>
+#include <dropout_detector.h>
+#include <gst/app/gstappsink.h>
 #include <string.h>
 #include <math.h>
 
@@ -13,15 +17,41 @@ clip_recorder_error_quark()
 
 G_DEFINE_TYPE (ClipRecorder, clip_recorder, G_TYPE_OBJECT)
 
+static void
+session_free(ClipRecorderSession *session);
+
+static void
+multi_free(ClipRecorderMulti *multi);
+
 static void
 clip_recorder_finalize(GObject *obj)
 {
   ClipRecorder *recorder = CLIP_RECORDER(obj);
+  if (recorder->session_pipeline) {
+    gst_element_set_state(GST_ELEMENT(recorder->session_pipeline),
+			  GST_STATE_NULL);
+    g_clear_object(&recorder->session_pipeline);
+  }
+  if (recorder->session) {
+    session_free(recorder->session);
+    recorder->session = NULL;
+  }
+  if (recorder->multi_pipeline) {
+    gst_element_set_state(GST_ELEMENT(recorder->multi_pipeline),
+			  GST_STATE_NULL);
+    g_clear_object(&recorder->multi_pipeline);
+  }
+  if (recorder->multi) {
+    multi_free(recorder->multi);
+    recorder->multi = NULL;
+  }
   if (recorder->record_pipeline) {
     gst_element_set_state(GST_ELEMENT(recorder->record_pipeline),
 			  GST_STATE_NULL);
     g_clear_object(&recorder->record_pipeline);
   }
+  take_writer_free(recorder->take_writer);
+  g_array_free(recorder->dropouts, TRUE);
   if (recorder->playback_pipeline) {
     gst_element_set_state(GST_ELEMENT(recorder->playback_pipeline),
 			  GST_STATE_NULL);
@@ -38,6 +68,8 @@ clip_recorder_finalize(GObject *obj)
 #define DEFAULT_TRIM_LEVEL 0.1
 #define DEFAULT_PRE_SILENCE 0
 #define DEFAULT_POST_SILENCE 0
+#define DEFAULT_BUFFER_TIME 200000 /* Same as alsasrc */
+#define DEFAULT_LATENCY_TIME 10000
 
 enum
 {
@@ -45,6 +77,8 @@ enum
   PROP_TRIM_LEVEL,
   PROP_PRE_SILENCE,
   PROP_POST_SILENCE,
+  PROP_BUFFER_TIME,
+  PROP_LATENCY_TIME,
 };
 
 enum {
@@ -52,7 +86,10 @@ enum {
   RECORDING,
   PLAYING,
   STOPPED,
-  POWER,
+  TAKE_STATS,
+  SEGMENT_DETECTED,
+  SEGMENT_SAVED,
+  DROPOUTS,
   LAST_SIGNAL
 };
 
@@ -80,7 +117,29 @@ clip_recorder_stopped(ClipRecorder *recorder, gpointer user_data)
 }
 
 static void
-clip_recorder_power(ClipRecorder *recorder, gdouble power)
+clip_recorder_take_stats(ClipRecorder *recorder,
+			 const ClipRecorderTakeStats *stats,
+			 gpointer user_data)
+{
+}
+
+static void
+clip_recorder_segment_detected(ClipRecorder *recorder,
+			       ClipRecorderSegment *segment,
+			       gpointer user_data)
+{
+}
+
+static void
+clip_recorder_segment_saved(ClipRecorder *recorder,
+			    ClipRecorderSegment *segment,
+			    gpointer user_data)
+{
+}
+
+static void
+clip_recorder_dropouts(ClipRecorder *recorder, const GArray *dropouts,
+		       gpointer user_data)
 {
 }
 
@@ -104,7 +163,10 @@ clip_recorder_class_init(ClipRecorderClass *obj_class)
   obj_class->recording = clip_recorder_recording;
   obj_class->playing = clip_recorder_playing;
   obj_class->stopped = clip_recorder_stopped;
-  obj_class->power = clip_recorder_power;
+  obj_class->take_stats = clip_recorder_take_stats;
+  obj_class->segment_detected = clip_recorder_segment_detected;
+  obj_class->segment_saved = clip_recorder_segment_saved;
+  obj_class->dropouts = clip_recorder_dropouts;
 
   clip_recorder_signals[RUN_ERROR] =
     g_signal_new("run-error",
@@ -134,13 +196,34 @@ clip_recorder_class_init(ClipRecorderClass *obj_class)
 		 NULL, NULL,
 		 g_cclosure_marshal_VOID__VOID,
 		 G_TYPE_NONE, 0);
-  clip_recorder_signals[POWER] =
-    g_signal_new("power",
+  clip_recorder_signals[TAKE_STATS] =
+    g_signal_new("take-stats",
+		 G_OBJECT_CLASS_TYPE (obj_class), G_SIGNAL_RUN_LAST,
+		 G_STRUCT_OFFSET(ClipRecorderClass, take_stats),
+		 NULL, NULL,
+		 g_cclosure_marshal_VOID__POINTER,
+		 G_TYPE_NONE, 1, G_TYPE_POINTER);
+  clip_recorder_signals[SEGMENT_DETECTED] =
+    g_signal_new("segment-detected",
+		 G_OBJECT_CLASS_TYPE (obj_class), G_SIGNAL_RUN_LAST,
+		 G_STRUCT_OFFSET(ClipRecorderClass, segment_detected),
+		 NULL, NULL,
+		 g_cclosure_marshal_VOID__POINTER,
+		 G_TYPE_NONE, 1, G_TYPE_POINTER);
+  clip_recorder_signals[SEGMENT_SAVED] =
+    g_signal_new("segment-saved",
 		 G_OBJECT_CLASS_TYPE (obj_class), G_SIGNAL_RUN_LAST,
-		 G_STRUCT_OFFSET(ClipRecorderClass, power),
+		 G_STRUCT_OFFSET(ClipRecorderClass, segment_saved),
 		 NULL, NULL,
-		 g_cclosure_marshal_VOID__DOUBLE,
-		 G_TYPE_NONE, 1, G_TYPE_DOUBLE);
+		 g_cclosure_marshal_VOID__POINTER,
+		 G_TYPE_NONE, 1, G_TYPE_POINTER);
+  clip_recorder_signals[DROPOUTS] =
+    g_signal_new("dropouts",
+		 G_OBJECT_CLASS_TYPE (obj_class), G_SIGNAL_RUN_LAST,
+		 G_STRUCT_OFFSET(ClipRecorderClass, dropouts),
+		 NULL, NULL,
+		 g_cclosure_marshal_VOID__POINTER,
+		 G_TYPE_NONE, 1, G_TYPE_POINTER);
 
   /* Properties */
   
@@ -173,6 +256,26 @@ clip_recorder_class_init(ClipRecorderClass *obj_class)
 				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
   
   g_object_class_install_property(gobject_class, PROP_POST_SILENCE, pspec);
+
+  /* buffer-time */
+  pspec =  g_param_spec_int64 ("buffer-time",
+				"Capture buffer size",
+				"Given as microseconds.",
+				1, G_MAXINT64,
+				DEFAULT_BUFFER_TIME,
+				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  
+  g_object_class_install_property(gobject_class, PROP_BUFFER_TIME, pspec);
+
+  /* latency-time */
+  pspec =  g_param_spec_int64 ("latency-time",
+				"Capture period",
+				"Given as microseconds.",
+				1, G_MAXINT64,
+				DEFAULT_LATENCY_TIME,
+				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  
+  g_object_class_install_property(gobject_class, PROP_LATENCY_TIME, pspec);
 }
 
 
@@ -182,10 +285,38 @@ clip_recorder_init(ClipRecorder *recorder)
   recorder->record_pipeline = NULL;
   recorder->adjust_pipeline = NULL;
   recorder->playback_pipeline = NULL;
+  recorder->session_pipeline = NULL;
+  recorder->multi_pipeline = NULL;
   recorder->active_pipeline = NULL;
+  recorder->meter_ring = NULL;
+  recorder->session = NULL;
+  recorder->multi = NULL;
+  recorder->take_writer = NULL;
 
   recorder->trim_level = DEFAULT_TRIM_LEVEL;
+  recorder->buffer_time = DEFAULT_BUFFER_TIME;
+  recorder->latency_time = DEFAULT_LATENCY_TIME;
+  recorder->dropouts = g_array_new(FALSE, FALSE, sizeof(ClipRecorderDropout));
+  recorder->noise_length = 0;
+  recorder->noise_lead_in = 0;
+  recorder->loudness = 0.0;
+  recorder->true_peak = 0.0;
+  memset(&recorder->take_stats, 0, sizeof(recorder->take_stats));
+}
 
+/* Takes effect the next time the pipeline is started */
+static void
+set_input_times(ClipRecorder *recorder, GstPipeline *pipeline)
+{
+  GstElement *input;
+  if (!pipeline) return;
+  input = gst_bin_get_by_name(GST_BIN(pipeline), "input");
+  g_assert(input);
+  g_object_set(input,
+	       "buffer-time", recorder->buffer_time,
+	       "latency-time", recorder->latency_time,
+	       NULL);
+  g_object_unref(input);
 }
 
 static void
@@ -210,6 +341,18 @@ clip_recorder_set_property (GObject * object, guint prop_id,
   case PROP_POST_SILENCE:
     recorder->post_silence = g_value_get_int64 (value);
     break;
+  case PROP_BUFFER_TIME:
+    recorder->buffer_time = g_value_get_int64 (value);
+    set_input_times(recorder, recorder->record_pipeline);
+    set_input_times(recorder, recorder->session_pipeline);
+    set_input_times(recorder, recorder->multi_pipeline);
+    break;
+  case PROP_LATENCY_TIME:
+    recorder->latency_time = g_value_get_int64 (value);
+    set_input_times(recorder, recorder->record_pipeline);
+    set_input_times(recorder, recorder->session_pipeline);
+    set_input_times(recorder, recorder->multi_pipeline);
+    break;
     
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -234,6 +377,12 @@ clip_recorder_get_property (GObject * object, guint prop_id,
   case PROP_POST_SILENCE:
     g_value_set_int64 (value, recorder->post_silence);
     break;
+  case PROP_BUFFER_TIME:
+    g_value_set_int64 (value, recorder->buffer_time);
+    break;
+  case PROP_LATENCY_TIME:
+    g_value_set_int64 (value, recorder->latency_time);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     break;
@@ -244,32 +393,79 @@ static GstPipeline *
 get_adjust_pipeline(ClipRecorder *recorder, GError **err);
 
 #define TARGET_LOUDNESS 5.01187233627e-3 /* -23dB */
+#define TRUE_PEAK_CEILING 0.891250938134 /* -1dBTP */
+
+static gfloat
+get_amplification(gdouble loudness, gdouble true_peak)
+{
+  gfloat amplification;
+  if (loudness < 1e-10) {
+    amplification = 1.0;
+  } else {
+    amplification = sqrt(TARGET_LOUDNESS / loudness);
+  }
+  /* Keep peaks below the ceiling instead of limiting afterwards */
+  if (true_peak * amplification > TRUE_PEAK_CEILING) {
+    amplification = TRUE_PEAK_CEILING / true_peak;
+  }
+  return amplification;
+}
+
+/* Less silence than this gives a noise profile too uneven to subtract */
+#define MIN_NOISE_LENGTH (250 * GST_MSECOND)
+/* More than this doesn't improve the profile */
+#define MAX_NOISE_LENGTH (2 * GST_SECOND)
+
+/* The noise profile is learned from the silence in the raw take
+   before the speech, not just from what is kept before trim_start */
+static void
+set_noise_span(GstClockTime speech_start, GstClockTime trim_start,
+	       GstClockTime *noise_length, GstClockTime *lead_in)
+{
+  GstClockTime learn_start = (speech_start > MAX_NOISE_LENGTH
+			      ? speech_start - MAX_NOISE_LENGTH : 0);
+  if (learn_start > trim_start) learn_start = trim_start;
+  if (speech_start < learn_start + MIN_NOISE_LENGTH) {
+    *noise_length = 0;
+    *lead_in = 0;
+    return;
+  }
+  *noise_length = speech_start - learn_start;
+  *lead_in = trim_start - learn_start;
+}
+
 static void
 start_adjustment(ClipRecorder *recorder)
 {
   GstStateChangeReturn state_ret;
   GstPipeline *adjust;
   GstElement *filesrc;
+  GstElement *denoise;
   GstElement *amplifier;
   GstClockTimeDiff duration;
+  GstClockTime lead_in = recorder->noise_lead_in;
   gfloat amplification;
   duration = recorder->trim_end - recorder->trim_start;
   adjust = get_adjust_pipeline(recorder, NULL);
   g_assert(adjust);
   filesrc = gst_bin_get_by_name(GST_BIN(adjust), "filesrc");
   g_assert(filesrc);
+  /* The lead-in is only read for the denoiser, which drops it */
   g_object_set(filesrc,
 	       "start", (GstClockTime)0,
-	       "duration", duration,
-	       "media-start", recorder->trim_start,
-	       "media-duration", duration,
+	       "duration", duration + lead_in,
+	       "media-start", recorder->trim_start - lead_in,
+	       "media-duration", duration + lead_in,
 	       NULL);
   g_object_unref(filesrc);
-  if (recorder->loudness < 1e-10) {
-    amplification = 1.0;
-  } else {
-    amplification = sqrt(TARGET_LOUDNESS / recorder->loudness);
-  }
+  denoise = gst_bin_get_by_name(GST_BIN(adjust), "denoise");
+  g_assert(denoise);
+  g_object_set(denoise,
+	       "noise-length", recorder->noise_length,
+	       "lead-in", lead_in,
+	       NULL);
+  g_object_unref(denoise);
+  amplification = get_amplification(recorder->loudness, recorder->true_peak);
   g_debug("Amplify by %f", amplification);
   amplifier = gst_bin_get_by_name(GST_BIN(adjust), "amplify");
   g_assert(amplifier);
@@ -286,9 +482,630 @@ start_adjustment(ClipRecorder *recorder)
 		"Failed to set state of adjustment pipeline to PLAYING");
     g_signal_emit(recorder, clip_recorder_signals[RUN_ERROR], 0, err);
     g_error_free (err);
+    trace_end("recorder", "turnaround");
     return;
   }
   recorder->active_pipeline = adjust;
+  /* A multi-mic take is adjusted once for each group */
+  if (recorder->take_stats.adjust_started == 0) {
+    recorder->take_stats.adjust_started = g_get_monotonic_time();
+  }
+  recorder->take_stats.adjusted_length = duration;
+  trace_begin("recorder", "adjust");
+}
+
+/* The adjusted take is written, let the application move on and then
+   report how long it all took */
+static void
+take_done(ClipRecorder *recorder)
+{
+  ClipRecorderTakeStats *stats = &recorder->take_stats;
+  trace_end("recorder", "adjust");
+  stats->stopped = g_get_monotonic_time();
+  trace_begin("recorder", "stopped-handlers");
+  g_signal_emit(recorder, clip_recorder_signals[STOPPED], 0);
+  trace_end("recorder", "stopped-handlers");
+  stats->ready = g_get_monotonic_time();
+  trace_end("recorder", "turnaround");
+  g_signal_emit(recorder, clip_recorder_signals[TAKE_STATS], 0, stats);
+}
+
+/* The raw take is on disk, normalize it */
+static void
+take_written(TakeWriter *writer, const GError *error, gpointer user_data)
+{
+  ClipRecorder *recorder = user_data;
+  ClipRecorderTakeStats *stats = &recorder->take_stats;
+  trace_end("recorder", "take-write");
+  stats->writer_overruns = take_writer_overruns(writer);
+  stats->writer_high_water = take_writer_high_water(writer);
+  if (stats->writer_overruns > 0) {
+    g_warning("Take writer dropped %u buffers", stats->writer_overruns);
+  }
+  if (error) {
+    g_signal_emit(recorder, clip_recorder_signals[RUN_ERROR], 0, error);
+    trace_end("recorder", "turnaround");
+  } else {
+    start_adjustment(recorder);
+  }
+  take_writer_free(writer);
+  g_object_unref(recorder);
+}
+
+#define SESSION_RATE 48000
+#define SESSION_RING_LENGTH (60 * SESSION_RATE) /* Samples */
+/* Sub-blocks above the trim level needed to start a segment */
+#define SESSION_ONSET_BLOCKS 2
+/* Silence that ends a segment */
+#define SESSION_HANGOVER (600 * GST_MSECOND)
+
+struct _ClipRecorderSession
+{
+  GMutex lock; /* Protects samples and written */
+  gint16 *samples; /* Ring of SESSION_RING_LENGTH samples */
+  guint64 written; /* Samples received since the session started */
+
+  /* Only used from the main thread. Positions are in samples. */
+  GstClockTime block_length;
+  guint64 blocks; /* Sub-blocks analyzed */
+  guint run; /* Consecutive sub-blocks above the trim level */
+  gboolean in_speech;
+  guint64 speech_start;
+  guint64 speech_end;
+  gdouble power_sum; /* Of sub-blocks above the trim level */
+  guint power_blocks;
+  gdouble true_peak;
+  GQueue pending; /* SegmentJob waiting for samples */
+  GThreadPool *writer;
+};
+
+typedef struct
+{
+  ClipRecorder *recorder; /* Set when pushed to the writer */
+  ClipRecorderSegment *segment;
+  guint64 start;
+  guint64 end;
+  gfloat amplification;
+  gint16 *samples;
+  gsize n_samples;
+} SegmentJob;
+
+static inline guint64
+time_to_samples(GstClockTime t)
+{
+  return gst_util_uint64_scale(t, SESSION_RATE, GST_SECOND);
+}
+
+static inline GstClockTime
+samples_to_time(guint64 n)
+{
+  return gst_util_uint64_scale(n, GST_SECOND, SESSION_RATE);
+}
+
+static void
+segment_job_free(SegmentJob *job)
+{
+  ClipRecorderSegment *segment = job->segment;
+  if (segment->user_data_free) segment->user_data_free(segment->user_data);
+  g_clear_object(&segment->file);
+  g_clear_error(&segment->error);
+  g_free(segment);
+  g_free(job->samples);
+  if (job->recorder) g_object_unref(job->recorder);
+  g_free(job);
+}
+
+static gboolean
+segment_written(gpointer data)
+{
+  SegmentJob *job = data;
+  g_signal_emit(job->recorder, clip_recorder_signals[SEGMENT_SAVED], 0,
+		job->segment);
+  segment_job_free(job);
+  return FALSE;
+}
+
+/* Runs in the writer thread */
+static void
+write_segment(gpointer data, gpointer user_data)
+{
+  SegmentJob *job = data;
+  gsize i;
+  if (job->amplification != 1.0) {
+    for (i = 0; i < job->n_samples; i++) {
+      gfloat v = job->samples[i] * job->amplification;
+      job->samples[i] = lrintf(CLAMP(v, -32768.0, 32767.0));
+    }
+  }
+  wav_file_write_s16(job->segment->file, job->samples, job->n_samples, 1,
+		     SESSION_RATE, &job->segment->error);
+  g_idle_add(segment_written, job);
+}
+
+static void
+session_clear_pending(ClipRecorderSession *session)
+{
+  SegmentJob *job;
+  while((job = g_queue_pop_head(&session->pending))) {
+    segment_job_free(job);
+  }
+}
+
+static ClipRecorderSession *
+session_new(void)
+{
+  ClipRecorderSession *session = g_new0(ClipRecorderSession, 1);
+  g_mutex_init(&session->lock);
+  session->samples = g_new(gint16, SESSION_RING_LENGTH);
+  g_queue_init(&session->pending);
+  /* A single thread so the files are written in order */
+  session->writer = g_thread_pool_new(write_segment, NULL, 1, FALSE, NULL);
+  return session;
+}
+
+static void
+session_free(ClipRecorderSession *session)
+{
+  /* Queued jobs hold a reference to the recorder so the pool is idle */
+  g_thread_pool_free(session->writer, FALSE, TRUE);
+  session_clear_pending(session);
+  g_mutex_clear(&session->lock);
+  g_free(session->samples);
+  g_free(session);
+}
+
+static void
+session_reset(ClipRecorderSession *session)
+{
+  g_mutex_lock(&session->lock);
+  session->written = 0;
+  g_mutex_unlock(&session->lock);
+  session->blocks = 0;
+  session->run = 0;
+  session->in_speech = FALSE;
+  session_clear_pending(session);
+}
+
+/* Called from the streaming thread */
+static GstFlowReturn
+session_new_buffer(GstAppSink *sink, gpointer user_data)
+{
+  ClipRecorderSession *session = user_data;
+  GstBuffer *buffer = gst_app_sink_pull_buffer(sink);
+  const gint16 *data;
+  gsize n;
+  gsize skip;
+  gsize pos;
+  gsize first;
+  if (!buffer) return GST_FLOW_OK;
+  data = (const gint16*)GST_BUFFER_DATA(buffer);
+  n = GST_BUFFER_SIZE(buffer) / sizeof(gint16);
+  /* Only the last part of a huge buffer fits */
+  skip = n > SESSION_RING_LENGTH ? n - SESSION_RING_LENGTH : 0;
+  g_mutex_lock(&session->lock);
+  pos = (session->written + skip) % SESSION_RING_LENGTH;
+  first = MIN(n - skip, SESSION_RING_LENGTH - pos);
+  memcpy(session->samples + pos, data + skip, first * sizeof(gint16));
+  memcpy(session->samples, data + skip + first,
+	 (n - skip - first) * sizeof(gint16));
+  session->written += n;
+  g_mutex_unlock(&session->lock);
+  gst_buffer_unref(buffer);
+  return GST_FLOW_OK;
+}
+
+/* Hand segments whose samples have all arrived to the writer. At the
+   end of the stream the rest are cut short. */
+static void
+session_write_pending(ClipRecorder *recorder, gboolean eos)
+{
+  ClipRecorderSession *session = recorder->session;
+  SegmentJob *job;
+  while((job = g_queue_peek_head(&session->pending))) {
+    guint64 oldest;
+    gsize pos;
+    gsize first;
+    g_mutex_lock(&session->lock);
+    if (job->end > session->written) {
+      if (!eos) {
+	g_mutex_unlock(&session->lock);
+	break;
+      }
+      job->end = session->written;
+    }
+    oldest = (session->written > SESSION_RING_LENGTH
+	      ? session->written - SESSION_RING_LENGTH : 0);
+    if (job->start < oldest) {
+      g_warning("Segment longer than the session buffer, start is lost");
+      job->start = oldest;
+    }
+    if (job->start > job->end) job->start = job->end;
+    job->n_samples = job->end - job->start;
+    job->samples = g_new(gint16, job->n_samples);
+    pos = job->start % SESSION_RING_LENGTH;
+    first = MIN(job->n_samples, SESSION_RING_LENGTH - pos);
+    memcpy(job->samples, session->samples + pos, first * sizeof(gint16));
+    memcpy(job->samples + first, session->samples,
+	   (job->n_samples - first) * sizeof(gint16));
+    g_mutex_unlock(&session->lock);
+    g_queue_pop_head(&session->pending);
+    job->segment->start = samples_to_time(job->start);
+    job->segment->end = samples_to_time(job->end);
+    job->recorder = g_object_ref(recorder);
+    g_thread_pool_push(session->writer, job, NULL);
+  }
+}
+
+/* The current segment has ended, ask for a file to save it in */
+static void
+session_cut(ClipRecorder *recorder)
+{
+  ClipRecorderSession *session = recorder->session;
+  guint64 pre = time_to_samples(recorder->pre_silence);
+  SegmentJob *job = g_new0(SegmentJob, 1);
+  ClipRecorderSegment *segment = g_new0(ClipRecorderSegment, 1);
+  session->in_speech = FALSE;
+  job->segment = segment;
+  job->start = session->speech_start > pre ? session->speech_start - pre : 0;
+  job->end = session->speech_end + time_to_samples(recorder->post_silence);
+  job->amplification =
+    get_amplification(session->power_sum / session->power_blocks,
+		      session->true_peak);
+  segment->start = samples_to_time(job->start);
+  segment->end = samples_to_time(job->end);
+  g_signal_emit(recorder, clip_recorder_signals[SEGMENT_DETECTED], 0,
+		segment);
+  if (!segment->file) {
+    segment_job_free(job);
+    return;
+  }
+  g_queue_push_tail(&session->pending, job);
+}
+
+/* Speech detection with hysteresis. A segment starts after a few
+   sub-blocks above the trim level and ends after a stretch of silence.
+   Loudness is the mean power of the sub-blocks above the trim level. */
+static void
+session_sub_block(ClipRecorder *recorder, gdouble power, gdouble true_peak)
+{
+  ClipRecorderSession *session = recorder->session;
+  guint64 begin = time_to_samples(session->blocks * session->block_length);
+  guint64 end;
+  session->blocks++;
+  end = time_to_samples(session->blocks * session->block_length);
+  if (power > recorder->trim_level) {
+    if (session->run == 0 && !session->in_speech) {
+      session->speech_start = begin;
+      session->power_sum = 0.0;
+      session->power_blocks = 0;
+      session->true_peak = 0.0;
+    }
+    session->run++;
+    session->power_sum += power;
+    session->power_blocks++;
+    session->speech_end = end;
+    if (session->run >= SESSION_ONSET_BLOCKS) session->in_speech = TRUE;
+  } else {
+    session->run = 0;
+    if (session->in_speech
+	&& end - session->speech_end >= time_to_samples(SESSION_HANGOVER)) {
+      session_cut(recorder);
+    }
+  }
+  if (true_peak > session->true_peak) session->true_peak = true_peak;
+  session_write_pending(recorder, FALSE);
+}
+
+static void
+session_done(ClipRecorder *recorder)
+{
+  if (recorder->session->in_speech) session_cut(recorder);
+  session_write_pending(recorder, TRUE);
+}
+
+/* A group of channels in a multi-mic take, written to its own file */
+typedef struct
+{
+  GFile *file; /* Adjusted clip */
+  GFile *raw_file;
+  guint first; /* First input channel */
+  guint channels;
+  TakeWriter *writer;
+  /* Deinterleaved samples, only used from the streaming thread */
+  gint16 *samples;
+  gsize samples_len;
+  /* gfloat power and true-peak of each sub-block */
+  GArray *powers;
+  GArray *true_peaks;
+  /* Analysis results, as for a single take */
+  GstClockTime trim_start;
+  GstClockTime trim_end;
+  GstClockTime noise_length;
+  GstClockTime noise_lead_in;
+  gdouble loudness;
+  gdouble true_peak;
+} MultiGroup;
+
+struct _ClipRecorderMulti
+{
+  guint channels; /* Of the input */
+  guint n_groups;
+  MultiGroup groups[CLIP_RECORDER_MAX_GROUPS];
+  GstClockTime block_length;
+  guint closing; /* Writers that haven't finished yet */
+  GError *error; /* First error from a writer */
+  guint adjusting; /* Next group to adjust */
+  gboolean active; /* Until the last group is adjusted */
+  /* Changed when a take is cleared, so writers closed for an earlier
+     take are ignored */
+  guint generation;
+};
+
+/* Passed to multi_written() */
+typedef struct
+{
+  ClipRecorder *recorder;
+  guint generation;
+} MultiWriterDone;
+
+static ClipRecorderMulti *
+multi_new(void)
+{
+  ClipRecorderMulti *multi = g_new0(ClipRecorderMulti, 1);
+  guint g;
+  for (g = 0; g < CLIP_RECORDER_MAX_GROUPS; g++) {
+    multi->groups[g].powers = g_array_new(FALSE, FALSE, sizeof(gfloat));
+    multi->groups[g].true_peaks = g_array_new(FALSE, FALSE, sizeof(gfloat));
+  }
+  return multi;
+}
+
+/* Forget the last take. Writers still being closed belong to their
+   done callbacks. */
+static void
+multi_clear(ClipRecorderMulti *multi)
+{
+  guint g;
+  for (g = 0; g < multi->n_groups; g++) {
+    MultiGroup *group = &multi->groups[g];
+    g_clear_object(&group->file);
+    g_clear_object(&group->raw_file);
+    take_writer_free(group->writer);
+    group->writer = NULL;
+    g_array_set_size(group->powers, 0);
+    g_array_set_size(group->true_peaks, 0);
+  }
+  multi->n_groups = 0;
+  multi->closing = 0;
+  g_clear_error(&multi->error);
+  multi->active = FALSE;
+  multi->generation++;
+}
+
+static void
+multi_free(ClipRecorderMulti *multi)
+{
+  guint g;
+  multi_clear(multi);
+  for (g = 0; g < CLIP_RECORDER_MAX_GROUPS; g++) {
+    g_array_free(multi->groups[g].powers, TRUE);
+    g_array_free(multi->groups[g].true_peaks, TRUE);
+    g_free(multi->groups[g].samples);
+  }
+  g_free(multi);
+}
+
+/* Called from the streaming thread. Each group is deinterleaved and
+   pushed to its own writer. */
+static GstFlowReturn
+multi_new_buffer(GstAppSink *sink, gpointer user_data)
+{
+  ClipRecorderMulti *multi = user_data;
+  GstBuffer *buffer = gst_app_sink_pull_buffer(sink);
+  const gint16 *data;
+  gsize frames;
+  guint g;
+  if (!buffer) return GST_FLOW_OK;
+  data = (const gint16*)GST_BUFFER_DATA(buffer);
+  frames = GST_BUFFER_SIZE(buffer) / (multi->channels * sizeof(gint16));
+  for (g = 0; g < multi->n_groups; g++) {
+    MultiGroup *group = &multi->groups[g];
+    gsize n = frames * group->channels;
+    const gint16 *src = data + group->first;
+    gint16 *dst;
+    gsize f;
+    guint c;
+    if (!group->writer) continue;
+    if (group->channels == multi->channels) {
+      take_writer_push(group->writer, GST_BUFFER_DATA(buffer),
+		       GST_BUFFER_SIZE(buffer));
+      continue;
+    }
+    if (n > group->samples_len) {
+      g_free(group->samples);
+      group->samples = g_new(gint16, n);
+      group->samples_len = n;
+    }
+    dst = group->samples;
+    for (f = 0; f < frames; f++) {
+      for (c = 0; c < group->channels; c++) *dst++ = src[c];
+      src += multi->channels;
+    }
+    take_writer_push(group->writer, (const guint8*)group->samples,
+		     n * sizeof(gint16));
+  }
+  gst_buffer_unref(buffer);
+  return GST_FLOW_OK;
+}
+
+/* Sum the channel powers of each group and keep the largest true-peak */
+static void
+multi_sub_block(ClipRecorderMulti *multi, const GstStructure *s)
+{
+  const GValue *powers_value = gst_structure_get_value(s, "channel-powers");
+  const GValue *peaks_value = gst_structure_get_value(s, "channel-true-peaks");
+  GValueArray *powers;
+  GValueArray *peaks;
+  guint g;
+  if (!powers_value || !peaks_value) return;
+  powers = g_value_get_boxed(powers_value);
+  peaks = g_value_get_boxed(peaks_value);
+  if (powers->n_values < multi->channels
+      || peaks->n_values < multi->channels) return;
+  for (g = 0; g < multi->n_groups; g++) {
+    MultiGroup *group = &multi->groups[g];
+    gfloat power = 0.0;
+    gfloat true_peak = 0.0;
+    guint c;
+    for (c = group->first; c < group->first + group->channels; c++) {
+      gfloat peak = g_value_get_double(g_value_array_get_nth(peaks, c));
+      power += g_value_get_double(g_value_array_get_nth(powers, c));
+      if (peak > true_peak) true_peak = peak;
+    }
+    g_array_append_val(group->powers, power);
+    g_array_append_val(group->true_peaks, true_peak);
+  }
+}
+
+/* Trim positions, loudness and true-peak of a group. Trimmed like the
+   analyzer does with a sub-block of margin, loudness is the mean power
+   of the sub-blocks above the trim level as for sessions. */
+static void
+multi_analyze_group(ClipRecorder *recorder, MultiGroup *group)
+{
+  GstClockTime block_length = recorder->multi->block_length;
+  const gfloat *powers = (const gfloat*)group->powers->data;
+  const gfloat *true_peaks = (const gfloat*)group->true_peaks->data;
+  guint n = group->powers->len;
+  GstClockTime length = n * block_length;
+  guint first = n;
+  guint last = 0;
+  gdouble sum = 0.0;
+  guint count = 0;
+  guint i;
+  for (i = 0; i < n; i++) {
+    if (powers[i] > recorder->trim_level) {
+      if (first == n) first = i;
+      last = i;
+      sum += powers[i];
+      count++;
+    }
+  }
+  if (count == 0) {
+    group->trim_start = 0;
+    group->trim_end = length;
+    group->loudness = 0.0;
+  } else {
+    group->trim_start = first > 0 ? (first - 1) * block_length : 0;
+    group->trim_end = MIN((last + 2) * block_length, length);
+    group->loudness = sum / count;
+  }
+  if (recorder->pre_silence > group->trim_start) {
+    group->trim_start = 0;
+  } else {
+    group->trim_start -= recorder->pre_silence;
+  }
+  group->trim_end = MIN(group->trim_end + recorder->post_silence, length);
+  set_noise_span(count > 0 ? first * block_length : 0, group->trim_start,
+		 &group->noise_length, &group->noise_lead_in);
+  group->true_peak = 0.0;
+  for (i = group->trim_start / block_length;
+       i < n && i * block_length < group->trim_end; i++) {
+    if (true_peaks[i] > group->true_peak) group->true_peak = true_peaks[i];
+  }
+}
+
+/* Run the next group of a multi-mic take through the adjust pipeline.
+   Returns FALSE if there are no more groups. */
+static gboolean
+multi_adjust_next(ClipRecorder *recorder)
+{
+  ClipRecorderMulti *multi = recorder->multi;
+  MultiGroup *group;
+  GstPipeline *adjust;
+  GstElement *element;
+  gchar *uri;
+  if (!multi || !multi->active) return FALSE;
+  if (multi->adjusting == multi->n_groups) {
+    multi->active = FALSE;
+    return FALSE;
+  }
+  if (multi->adjusting > 0) trace_end("recorder", "adjust");
+  group = &multi->groups[multi->adjusting++];
+  adjust = get_adjust_pipeline(recorder, NULL);
+  g_assert(adjust);
+  element = gst_bin_get_by_name(GST_BIN(adjust), "filesrc");
+  g_assert(element);
+  uri = g_file_get_uri(group->raw_file);
+  g_object_set(element, "uri", uri, NULL);
+  g_free(uri);
+  g_object_unref(element);
+  element = gst_bin_get_by_name(GST_BIN(adjust), "filesink");
+  g_assert(element);
+  g_object_set(element, "file", group->file, NULL);
+  g_object_unref(element);
+  recorder->trim_start = group->trim_start;
+  recorder->trim_end = group->trim_end;
+  recorder->noise_length = group->noise_length;
+  recorder->noise_lead_in = group->noise_lead_in;
+  recorder->loudness = group->loudness;
+  recorder->true_peak = group->true_peak;
+  start_adjustment(recorder);
+  return TRUE;
+}
+
+/* When all raw files of a multi-mic take are written, the groups are
+   analyzed and adjusted one at a time */
+static void
+multi_written(TakeWriter *writer, const GError *error, gpointer user_data)
+{
+  MultiWriterDone *done = user_data;
+  ClipRecorder *recorder = done->recorder;
+  ClipRecorderMulti *multi = recorder->multi;
+  ClipRecorderTakeStats *stats = &recorder->take_stats;
+  guint g;
+  if (done->generation != multi->generation) {
+    /* The take was cancelled */
+    take_writer_free(writer);
+    g_object_unref(recorder);
+    g_free(done);
+    return;
+  }
+  stats->writer_overruns += take_writer_overruns(writer);
+  stats->writer_high_water = MAX(stats->writer_high_water,
+				 take_writer_high_water(writer));
+  if (error && !multi->error) multi->error = g_error_copy(error);
+  take_writer_free(writer);
+  if (multi->closing > 0 && --multi->closing == 0) {
+    trace_end("recorder", "take-write");
+    if (stats->writer_overruns > 0) {
+      g_warning("Take writers dropped %u buffers", stats->writer_overruns);
+    }
+    if (multi->error) {
+      g_signal_emit(recorder, clip_recorder_signals[RUN_ERROR], 0,
+		    multi->error);
+      multi->active = FALSE;
+      trace_end("recorder", "turnaround");
+    } else {
+      for (g = 0; g < multi->n_groups; g++) {
+	multi_analyze_group(recorder, &multi->groups[g]);
+      }
+      multi->adjusting = 0;
+      multi_adjust_next(recorder);
+    }
+  }
+  g_object_unref(recorder);
+  g_free(done);
+}
+
+static void
+report_dropouts(ClipRecorder *recorder)
+{
+  recorder->take_stats.dropouts = recorder->dropouts->len;
+  if (recorder->dropouts->len > 0) {
+    g_signal_emit(recorder, clip_recorder_signals[DROPOUTS], 0,
+		  recorder->dropouts);
+  }
 }
 
 static gboolean
@@ -302,6 +1119,14 @@ bus_call (GstBus     *bus,
   switch (GST_MESSAGE_TYPE (msg)) {
   case GST_MESSAGE_EOS:
     g_debug ("End-of-stream");
+    if (recorder->active_pipeline == recorder->record_pipeline
+	|| recorder->active_pipeline == recorder->multi_pipeline) {
+      recorder->take_stats.record_eos = g_get_monotonic_time();
+      trace_instant("recorder", "record-eos");
+    } else if (recorder->active_pipeline == recorder->adjust_pipeline) {
+      recorder->take_stats.adjust_eos = g_get_monotonic_time();
+      trace_instant("recorder", "adjust-eos");
+    }
     gst_element_set_state(GST_ELEMENT(recorder->active_pipeline),
 			  GST_STATE_READY);
     break;
@@ -320,9 +1145,46 @@ bus_call (GstBus     *bus,
     }
     gst_element_set_state(GST_ELEMENT(recorder->active_pipeline),
 			  GST_STATE_NULL);
+    if (recorder->active_pipeline == recorder->record_pipeline) {
+      take_writer_free(recorder->take_writer);
+      recorder->take_writer = NULL;
+    }
+    /* Also when adjusting a group, the rest of the take is dropped */
+    if (recorder->multi && recorder->multi->active) {
+      multi_clear(recorder->multi);
+    }
     recorder->active_pipeline = NULL;
     break;
   }
+  case GST_MESSAGE_WARNING: {
+    gchar *debug = NULL;
+    GError *err = NULL;
+    gst_message_parse_warning (msg, &err, &debug);
+    g_warning("%s", err->message);
+    if (debug) {
+      g_debug("Warning details: %s", debug);
+      g_free (debug);
+    }
+    g_error_free (err);
+    /* Overruns are reported by the source as warnings */
+    if ((recorder->active_pipeline == recorder->record_pipeline
+	 || recorder->active_pipeline == recorder->session_pipeline
+	 || recorder->active_pipeline == recorder->multi_pipeline)
+	&& strcmp(GST_OBJECT_NAME(msg->src), "input") == 0) {
+      ClipRecorderDropout dropout;
+      GstFormat format = GST_FORMAT_TIME;
+      gint64 pos;
+      if (gst_element_query_position(GST_ELEMENT(recorder->active_pipeline),
+				     &format, &pos)) {
+	dropout.position = pos;
+      } else {
+	dropout.position = GST_CLOCK_TIME_NONE;
+      }
+      dropout.length = 0;
+      g_array_append_val(recorder->dropouts, dropout);
+    }
+    break;
+  }
   case GST_MESSAGE_STATE_CHANGED:
     {
       GstState old_state;
@@ -336,14 +1198,48 @@ bus_call (GstBus     *bus,
 				  GST_STATE_NULL);
 	    recorder->active_pipeline = NULL;
 	    if (msg->src == (GstObject*)recorder->record_pipeline) {
-	      start_adjustment(recorder);
+	      TakeWriter *writer = recorder->take_writer;
+	      report_dropouts(recorder);
+	      recorder->take_stats.record_stopped = g_get_monotonic_time();
+	      trace_end("recorder", "record-drain");
+	      recorder->take_writer = NULL;
+	      trace_begin("recorder", "take-write");
+	      take_writer_close(writer, take_written, g_object_ref(recorder));
+	    } else if (msg->src == (GstObject*)recorder->session_pipeline) {
+	      report_dropouts(recorder);
+	      session_done(recorder);
+	      g_signal_emit(recorder, clip_recorder_signals[STOPPED], 0);
+	    } else if (msg->src == (GstObject*)recorder->multi_pipeline) {
+	      ClipRecorderMulti *multi = recorder->multi;
+	      guint g;
+	      report_dropouts(recorder);
+	      recorder->take_stats.record_stopped = g_get_monotonic_time();
+	      trace_end("recorder", "record-drain");
+	      trace_begin("recorder", "take-write");
+	      multi->closing = multi->n_groups;
+	      for (g = 0; g < multi->n_groups; g++) {
+		TakeWriter *writer = multi->groups[g].writer;
+		MultiWriterDone *done = g_new(MultiWriterDone, 1);
+		done->recorder = g_object_ref(recorder);
+		done->generation = multi->generation;
+		multi->groups[g].writer = NULL;
+		take_writer_close(writer, multi_written, done);
+	      }
+	    } else if (msg->src == (GstObject*)recorder->adjust_pipeline) {
+	      if (!multi_adjust_next(recorder)) take_done(recorder);
 	    } else {
 	      g_signal_emit(recorder, clip_recorder_signals[STOPPED], 0);
 	    }
 	  }
 	break;
 	case GST_STATE_PLAYING:
-	  if (msg->src == (GstObject*)recorder->record_pipeline) {
+	  if (msg->src == (GstObject*)recorder->record_pipeline
+	      || msg->src == (GstObject*)recorder->multi_pipeline) {
+	    recorder->take_stats.record_started = g_get_monotonic_time();
+	  }
+	  if (msg->src == (GstObject*)recorder->record_pipeline
+	      || msg->src == (GstObject*)recorder->session_pipeline
+	      || msg->src == (GstObject*)recorder->multi_pipeline) {
 	    g_signal_emit(recorder, clip_recorder_signals[RECORDING], 0);
 	  } else if (msg->src == (GstObject*)recorder->playback_pipeline) {
 	    g_signal_emit(recorder, clip_recorder_signals[PLAYING], 0);
@@ -358,25 +1254,62 @@ bus_call (GstBus     *bus,
   case GST_MESSAGE_ELEMENT:
     {
       const gchar *name = gst_structure_get_name(msg->structure);
-      if (strcmp(name, "sub-block-message") == 0) {
+      if (strcmp(name, DROPOUT_MESSAGE) == 0) {
+	ClipRecorderDropout dropout = {GST_CLOCK_TIME_NONE, 0};
+	if (recorder->active_pipeline != recorder->record_pipeline
+	    && recorder->active_pipeline != recorder->session_pipeline
+	    && recorder->active_pipeline != recorder->multi_pipeline) break;
+	/* A malformed message says nothing useful about the take */
+	if (!gst_structure_get_clock_time (msg->structure,
+					   DROPOUT_MESSAGE_POSITION,
+					   &dropout.position)
+	    || !gst_structure_get_clock_time (msg->structure,
+					      DROPOUT_MESSAGE_LENGTH,
+					      &dropout.length)) {
+	  g_warning("Ignoring incomplete dropout message");
+	  break;
+	}
+	g_array_append_val(recorder->dropouts, dropout);
+      } else if (strcmp(name, "sub-block-message") == 0) {
 	gdouble power;
-	if (gst_structure_get_double (msg->structure, "power", &power)) {
-	  g_signal_emit(recorder, clip_recorder_signals[POWER], 0, power);
+	gdouble true_peak;
+	if (recorder->active_pipeline == recorder->multi_pipeline) {
+	  multi_sub_block(recorder->multi, msg->structure);
+	  break;
+	}
+	if (recorder->active_pipeline != recorder->session_pipeline) break;
+	if (!gst_structure_get_double (msg->structure, "power", &power)) break;
+	if (!gst_structure_get_double (msg->structure, "true-peak",
+				       &true_peak)) {
+	  true_peak = 0.0;
 	}
+	session_sub_block(recorder, power, true_peak);
       } else if (strcmp(name, "analysis-message") == 0) {
 	GstFormat format = GST_FORMAT_TIME;
 	gint64 raw_end;
+	GstClockTime speech_start;
 	gst_structure_get_double (msg->structure, "loudness",
 				  &recorder->loudness);
+	if (!gst_structure_get_double (msg->structure, "true-peak",
+				       &recorder->true_peak)) {
+	  recorder->true_peak = 0.0;
+	}
 	gst_structure_get_clock_time (msg->structure, "trim-start",
 				      &recorder->trim_start);
 	gst_structure_get_clock_time (msg->structure, "trim-end",
 				      &recorder->trim_end);
+	/* Without a known onset there's no silence to learn noise from */
+	if (!gst_structure_get_clock_time (msg->structure, "speech-start",
+					   &speech_start)) {
+	  speech_start = 0;
+	}
 	if (recorder->pre_silence > recorder->trim_start) {
 	  recorder->trim_start = 0;
 	} else {
 	  recorder->trim_start -= recorder->pre_silence;
 	}
+	set_noise_span(speech_start, recorder->trim_start,
+		       &recorder->noise_length, &recorder->noise_lead_in);
 	g_assert(gst_element_query_position(GST_ELEMENT(msg->src),
 					    &format, &raw_end));
 	if (recorder->post_silence + recorder->trim_end > raw_end) {
@@ -396,17 +1329,31 @@ bus_call (GstBus     *bus,
   return TRUE;
 }
 
+/* Called from the streaming thread */
+static GstFlowReturn
+record_new_buffer(GstAppSink *sink, gpointer user_data)
+{
+  ClipRecorder *recorder = user_data;
+  GstBuffer *buffer = gst_app_sink_pull_buffer(sink);
+  if (!buffer) return GST_FLOW_OK;
+  if (recorder->take_writer) {
+    take_writer_push(recorder->take_writer,
+		     GST_BUFFER_DATA(buffer), GST_BUFFER_SIZE(buffer));
+  }
+  gst_buffer_unref(buffer);
+  return GST_FLOW_OK;
+}
+
 static GstPipeline *
 get_record_pipeline(ClipRecorder *recorder, GError **err)
 {
+  static GstAppSinkCallbacks sink_callbacks = {NULL, NULL, record_new_buffer};
   GstElement *pipeline;
   GstBus *bus;
   GstElement *input;
-  GstElement *convert1;
+  GstElement *convert;
   GstElement *analyze;
-  GstElement *convert2;
-  GstElement *wavenc;
-  GstElement *filesink;
+  GstElement *sink;
   GstCaps *output_filter;
   
   if (!recorder->record_pipeline) {
@@ -423,17 +1370,24 @@ get_record_pipeline(ClipRecorder *recorder, GError **err)
       gst_object_unref(pipeline);
       return NULL;
     }
+    g_object_set(input,
+		 "buffer-time", recorder->buffer_time,
+		 "latency-time", recorder->latency_time,
+		 NULL);
+    dropout_detector_attach(input);
     gst_bin_add(GST_BIN(pipeline), input);
 
-    convert1 = gst_element_factory_make ("audioconvert", "convert1");
-    if (!convert1) {
+    /* Passes the buffers through untouched when the input already
+       delivers the output format */
+    convert = gst_element_factory_make ("audioconvert", "convert");
+    if (!convert) {
       g_set_error(err, CLIP_RECORDER_ERROR,
 		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
 		  "Failed to create audio converter");
       gst_object_unref(pipeline);
       return NULL;
     }
-    gst_bin_add(GST_BIN(pipeline), convert1);
+    gst_bin_add(GST_BIN(pipeline), convert);
 
     analyze = gst_element_factory_make ("audiormspower", "analyze");
     if (!analyze) {
@@ -445,64 +1399,51 @@ get_record_pipeline(ClipRecorder *recorder, GError **err)
     }
     g_object_set(analyze, "analysis-message", TRUE, NULL);
     g_object_set(analyze, "trim-level", recorder->trim_level, NULL);
+    g_object_set(analyze, "meter-interval", CLIP_RECORDER_METER_INTERVAL,
+		 NULL);
     gst_bin_add(GST_BIN(pipeline), analyze);
 
-    
-    convert2 = gst_element_factory_make ("audioconvert", "convert2");
-    if (!convert2) {
+    /* Written by a take writer so capture never waits for the disk */
+    sink = gst_element_factory_make ("appsink", "sink");
+    if (!sink) {
       g_set_error(err, CLIP_RECORDER_ERROR,
 		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
-		  "Failed to create audio converter");
+		  "Failed to create application sink");
       gst_object_unref(pipeline);
       return NULL;
     }
-    gst_bin_add(GST_BIN(pipeline), convert2);
-
-    wavenc = gst_element_factory_make ("wavenc", "wavenc");
-    if (!wavenc) {
-      g_set_error(err, CLIP_RECORDER_ERROR,
-		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
-		  "Failed to create WAV encoder");
-      gst_object_unref(pipeline);
-      return NULL;
-    }
-    gst_bin_add(GST_BIN(pipeline), wavenc);
-
-    
-    filesink = gst_element_factory_make ("giosink", "file");
-    if (!filesink) {
-      g_set_error(err, CLIP_RECORDER_ERROR,
-		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
-		  "Failed to create file sink");
-      gst_object_unref(pipeline);
-      return NULL;
-    }
-    gst_bin_add(GST_BIN(pipeline), filesink);
+    g_object_set(sink, "sync", FALSE, NULL);
+    gst_app_sink_set_callbacks(GST_APP_SINK(sink), &sink_callbacks,
+			       recorder, NULL);
+    gst_bin_add(GST_BIN(pipeline), sink);
 
-    if (!gst_element_link_many(input, convert1, analyze, convert2,
-			       NULL)) {
+    if (!gst_element_link(input, convert)) {
       g_set_error(err, CLIP_RECORDER_ERROR,
 		  CLIP_RECORDER_ERROR_LINK_FAILED,
 		  "Failed to link record pipeline (first part)");
       gst_object_unref(pipeline);
       return NULL;
     }
+    /* The analyzer takes the samples in the format they are written
+       in, so they are only converted if the input needs it */
     output_filter = gst_caps_new_simple("audio/x-raw-int",
 					"rate", G_TYPE_INT, 48000,
+					"width", G_TYPE_INT, 16,
 					"depth", G_TYPE_INT, 16,
+					"signed", G_TYPE_BOOLEAN, TRUE,
+					"endianness", G_TYPE_INT, G_LITTLE_ENDIAN,
 					"channels", G_TYPE_INT, 1,
 					NULL);
-    if (!gst_element_link_filtered(convert2, wavenc, output_filter)) {
+    if (!gst_element_link_filtered(convert, analyze, output_filter)) {
       gst_caps_unref(output_filter);
       g_set_error(err, CLIP_RECORDER_ERROR,
 		  CLIP_RECORDER_ERROR_LINK_FAILED,
-		  "Failed to link record pipeline (middle part)");
+		  "Failed to link record pipeline (analyzer)");
       gst_object_unref(pipeline);
       return NULL;
     }
-      gst_caps_unref(output_filter);
-    
-    if (!gst_element_link(wavenc, filesink)) {
+    gst_caps_unref(output_filter);
+    if (!gst_element_link(analyze, sink)) {
       g_set_error(err, CLIP_RECORDER_ERROR,
 		  CLIP_RECORDER_ERROR_LINK_FAILED,
 		  "Failed to link record pipeline (last part)");
@@ -541,8 +1482,8 @@ get_adjust_pipeline(ClipRecorder *recorder, GError **err)
   GstElement *filesrc;
   GstElement *composition;
   GstElement *high_pass;
+  GstElement *denoise;
   GstElement *amplify;
-  GstElement *limit;
   GstElement *convert1;
   GstElement *convert2;
   GstElement *wavenc;
@@ -596,6 +1537,16 @@ get_adjust_pipeline(ClipRecorder *recorder, GError **err)
     }
     g_object_set(high_pass, "mode", 1, "poles", 2, "cutoff", (gfloat)100, NULL);
     gst_bin_add(GST_BIN(pipeline), high_pass);
+
+    denoise = gst_element_factory_make ("audiodenoise", "denoise");
+    if (!denoise) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create noise reduction");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    gst_bin_add(GST_BIN(pipeline), denoise);
     
     amplify = gst_element_factory_make ("audioamplify", "amplify");
     if (!amplify) {
@@ -610,16 +1561,6 @@ get_adjust_pipeline(ClipRecorder *recorder, GError **err)
     g_signal_connect(composition, "pad-added",
 		     (GCallback)output_pad_added, convert1);
      
-    limit = gst_element_factory_make ("rglimiter", "limit");
-    if (!limit) {
-      g_set_error(err, CLIP_RECORDER_ERROR,
-		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
-		  "Failed to create limiter");
-      gst_object_unref(pipeline);
-      return NULL;
-    }
-    gst_bin_add(GST_BIN(pipeline), limit);
-    
     convert2 = gst_element_factory_make ("audioconvert", "convert2");
     if (!convert2) {
       g_set_error(err, CLIP_RECORDER_ERROR,
@@ -652,7 +1593,7 @@ get_adjust_pipeline(ClipRecorder *recorder, GError **err)
     gst_bin_add(GST_BIN(pipeline), filesink);
 
 
-    if (!gst_element_link_many(convert1, high_pass, amplify, limit,
+    if (!gst_element_link_many(convert1, high_pass, denoise, amplify,
 			       convert2, NULL)) {
       g_set_error(err, CLIP_RECORDER_ERROR,
 		  CLIP_RECORDER_ERROR_LINK_FAILED,
@@ -660,10 +1601,10 @@ get_adjust_pipeline(ClipRecorder *recorder, GError **err)
       gst_object_unref(pipeline);
       return NULL;
     }
+    /* Any number of channels, for the groups of multi-mic takes */
     output_filter = gst_caps_new_simple("audio/x-raw-int",
 					"rate", G_TYPE_INT, 48000,
 					"depth", G_TYPE_INT, 16,
-					"channels", G_TYPE_INT, 1,
 					NULL);
     if (!gst_element_link_filtered(convert2, wavenc, output_filter)) {
       gst_caps_unref(output_filter);
@@ -767,6 +1708,253 @@ get_playback_pipeline(ClipRecorder *recorder, GError **err)
   return recorder->playback_pipeline;
 }
 
+static GstPipeline *
+get_session_pipeline(ClipRecorder *recorder, GError **err)
+{
+  static GstAppSinkCallbacks sink_callbacks = {NULL, NULL, session_new_buffer};
+  GstElement *pipeline;
+  GstBus *bus;
+  GstElement *input;
+  GstElement *convert1;
+  GstElement *analyze;
+  GstElement *high_pass;
+  GstElement *convert2;
+  GstElement *sink;
+  GstCaps *output_filter;
+  gint64 block_length;
+
+  if (!recorder->session_pipeline) {
+    if (!recorder->session) recorder->session = session_new();
+    pipeline = gst_pipeline_new ("session");
+    bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+    gst_bus_add_watch (bus, bus_call, recorder);
+    gst_object_unref (bus);
+
+    input = gst_element_factory_make ("alsasrc", "input");
+    if (!input) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create audio input (ALSA)");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    g_object_set(input,
+		 "buffer-time", recorder->buffer_time,
+		 "latency-time", recorder->latency_time,
+		 NULL);
+    dropout_detector_attach(input);
+    gst_bin_add(GST_BIN(pipeline), input);
+
+    convert1 = gst_element_factory_make ("audioconvert", "convert1");
+    if (!convert1) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create audio converter");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    gst_bin_add(GST_BIN(pipeline), convert1);
+
+    analyze = gst_element_factory_make ("audiormspower", "analyze");
+    if (!analyze) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create audio analyzer");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    g_object_set(analyze, "sub-block-message", TRUE, NULL);
+    g_object_set(analyze, "meter-interval", CLIP_RECORDER_METER_INTERVAL,
+		 NULL);
+    g_object_get(analyze, "sub-block-length", &block_length, NULL);
+    recorder->session->block_length = block_length;
+    gst_bin_add(GST_BIN(pipeline), analyze);
+
+    /* Filtered here since the clips are cut from this stream */
+    high_pass = gst_element_factory_make ("audiocheblimit", "highpass");
+    if (!high_pass) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create high pass filter");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    g_object_set(high_pass, "mode", 1, "poles", 2, "cutoff", (gfloat)100, NULL);
+    gst_bin_add(GST_BIN(pipeline), high_pass);
+
+    convert2 = gst_element_factory_make ("audioconvert", "convert2");
+    if (!convert2) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create audio converter");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    gst_bin_add(GST_BIN(pipeline), convert2);
+
+    sink = gst_element_factory_make ("appsink", "sink");
+    if (!sink) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create application sink");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    g_object_set(sink, "sync", FALSE, NULL);
+    gst_app_sink_set_callbacks(GST_APP_SINK(sink), &sink_callbacks,
+			       recorder->session, NULL);
+    gst_bin_add(GST_BIN(pipeline), sink);
+
+    if (!gst_element_link_many(input, convert1, analyze, high_pass, convert2,
+			       NULL)) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_LINK_FAILED,
+		  "Failed to link session pipeline (first part)");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    output_filter = gst_caps_new_simple("audio/x-raw-int",
+					"rate", G_TYPE_INT, SESSION_RATE,
+					"width", G_TYPE_INT, 16,
+					"depth", G_TYPE_INT, 16,
+					"signed", G_TYPE_BOOLEAN, TRUE,
+					"endianness", G_TYPE_INT, G_BYTE_ORDER,
+					"channels", G_TYPE_INT, 1,
+					NULL);
+    if (!gst_element_link_filtered(convert2, sink, output_filter)) {
+      gst_caps_unref(output_filter);
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_LINK_FAILED,
+		  "Failed to link session pipeline (last part)");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    gst_caps_unref(output_filter);
+
+    recorder->session_pipeline = GST_PIPELINE(pipeline);
+  }
+  return recorder->session_pipeline;
+}
+
+static GstPipeline *
+get_multi_pipeline(ClipRecorder *recorder, GError **err)
+{
+  static GstAppSinkCallbacks sink_callbacks = {NULL, NULL, multi_new_buffer};
+  GstElement *pipeline;
+  GstBus *bus;
+  GstElement *input;
+  GstElement *convert;
+  GstElement *format;
+  GstElement *analyze;
+  GstElement *sink;
+  gint64 block_length;
+
+  if (!recorder->multi_pipeline) {
+    if (!recorder->multi) recorder->multi = multi_new();
+    pipeline = gst_pipeline_new ("multi");
+    bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+    gst_bus_add_watch (bus, bus_call, recorder);
+    gst_object_unref (bus);
+
+    input = gst_element_factory_make ("alsasrc", "input");
+    if (!input) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create audio input (ALSA)");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    g_object_set(input,
+		 "buffer-time", recorder->buffer_time,
+		 "latency-time", recorder->latency_time,
+		 NULL);
+    dropout_detector_attach(input);
+    gst_bin_add(GST_BIN(pipeline), input);
+
+    convert = gst_element_factory_make ("audioconvert", "convert");
+    if (!convert) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create audio converter");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    gst_bin_add(GST_BIN(pipeline), convert);
+
+    /* Caps are set for each take, since the channel count may change */
+    format = gst_element_factory_make ("capsfilter", "format");
+    if (!format) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create caps filter");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    gst_bin_add(GST_BIN(pipeline), format);
+
+    /* Analyzes all channels in one pass */
+    analyze = gst_element_factory_make ("audiormspower", "analyze");
+    if (!analyze) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create audio analyzer");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    g_object_set(analyze, "sub-block-message", TRUE, NULL);
+    g_object_set(analyze, "meter-interval", CLIP_RECORDER_METER_INTERVAL,
+		 NULL);
+    g_object_get(analyze, "sub-block-length", &block_length, NULL);
+    recorder->multi->block_length = block_length;
+    gst_bin_add(GST_BIN(pipeline), analyze);
+
+    sink = gst_element_factory_make ("appsink", "sink");
+    if (!sink) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_CREATE_ELEMENT_FAILED,
+		  "Failed to create application sink");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+    g_object_set(sink, "sync", FALSE, NULL);
+    gst_app_sink_set_callbacks(GST_APP_SINK(sink), &sink_callbacks,
+			       recorder->multi, NULL);
+    gst_bin_add(GST_BIN(pipeline), sink);
+
+    if (!gst_element_link_many(input, convert, format, analyze, sink,
+			       NULL)) {
+      g_set_error(err, CLIP_RECORDER_ERROR,
+		  CLIP_RECORDER_ERROR_LINK_FAILED,
+		  "Failed to link multi-mic pipeline");
+      gst_object_unref(pipeline);
+      return NULL;
+    }
+
+    recorder->multi_pipeline = GST_PIPELINE(pipeline);
+  }
+  return recorder->multi_pipeline;
+}
+
+static void
+reset_dropouts(ClipRecorder *recorder, GstPipeline *pipeline)
+{
+  GstElement *input = gst_bin_get_by_name(GST_BIN(pipeline), "input");
+  g_assert(input);
+  dropout_detector_reset(input);
+  g_object_unref(input);
+  g_array_set_size(recorder->dropouts, 0);
+}
+
+/* The meter follows the analyzer of the pipeline being started */
+static void
+use_meter_ring(ClipRecorder *recorder, GstPipeline *pipeline)
+{
+  GstElement *analyze = gst_bin_get_by_name(GST_BIN(pipeline), "analyze");
+  g_assert(analyze);
+  g_object_get(analyze, "meter-ring", &recorder->meter_ring, NULL);
+  g_object_unref(analyze);
+}
+
 static void
 cancel_active_pipeline(ClipRecorder *recorder)
 {
@@ -779,6 +1967,11 @@ cancel_active_pipeline(ClipRecorder *recorder)
 			    NULL, GST_CLOCK_TIME_NONE);
     }
   }
+  /* A multi-mic take may be between its pipelines, writing or
+     adjusting */
+  if (recorder->multi && recorder->multi->active) {
+    multi_clear(recorder->multi);
+  }
 }
 
 
@@ -789,13 +1982,6 @@ clip_recorder_new(void)
   return recorder;
 }
 
-static gboolean
-signal_connected(gpointer instance, guint signal_id)
-{
-  return g_signal_handler_find (instance, G_SIGNAL_MATCH_ID, signal_id, 0, NULL,
-				NULL, NULL) != 0;
-}
-
 static GFile *
 create_raw_file(GFile *orig)
 {
@@ -824,10 +2010,8 @@ clip_recorder_record(ClipRecorder *recorder, GFile *file,GError **err)
   GstStateChangeReturn state_ret;
   GstPipeline *pipeline;
   GstPipeline *adjust;
-  GstElement *filesink;
   GstElement *adjustsrc;
   GstElement *adjustsink;
-  GstElement *analyze;
   GFile *raw_file;
   char *uri;
   cancel_active_pipeline(recorder);
@@ -843,10 +2027,12 @@ clip_recorder_record(ClipRecorder *recorder, GFile *file,GError **err)
 
   raw_file = create_raw_file(file);
   
-  filesink = gst_bin_get_by_name(GST_BIN(pipeline), "file");
-  g_assert(filesink);
-  g_object_set(filesink, "file", raw_file, NULL);
-  g_object_unref(filesink);
+  take_writer_free(recorder->take_writer);
+  recorder->take_writer = take_writer_new(raw_file, 48000, 1, err);
+  if (!recorder->take_writer) {
+    g_object_unref(raw_file);
+    return FALSE;
+  }
 
   adjustsrc = gst_bin_get_by_name(GST_BIN(adjust), "filesrc");
   g_assert(adjustsrc);
@@ -863,18 +2049,130 @@ clip_recorder_record(ClipRecorder *recorder, GFile *file,GError **err)
   g_object_set(adjustsink, "file", file, NULL);
   g_object_unref(adjustsink);
   
-  analyze = gst_bin_get_by_name(GST_BIN(pipeline), "analyze");
-  g_object_set(analyze,"sub-block-message",
-	       signal_connected(recorder, clip_recorder_signals[POWER]), NULL);
-  g_object_unref(analyze);
+  use_meter_ring(recorder, pipeline);
+  meter_ring_clear(recorder->meter_ring);
+  reset_dropouts(recorder, pipeline);
+  memset(&recorder->take_stats, 0, sizeof(recorder->take_stats));
   
   state_ret = gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_PLAYING);
   if (state_ret == GST_STATE_CHANGE_FAILURE) {
     g_set_error(err, CLIP_RECORDER_ERROR, CLIP_RECORDER_ERROR_STATE,
 		"Failed to set state of recording pipeline to PLAYING");
     gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
+    take_writer_free(recorder->take_writer);
+    recorder->take_writer = NULL;
+    return FALSE;
+  }
+  recorder->active_pipeline = pipeline;
+  return TRUE;
+}
+
+gboolean
+clip_recorder_record_session(ClipRecorder *recorder, GError **err)
+{
+  GstStateChangeReturn state_ret;
+  GstPipeline *pipeline;
+  cancel_active_pipeline(recorder);
+  pipeline = get_session_pipeline(recorder, err);
+  if (!pipeline) {
+    return FALSE;
+  }
+  session_reset(recorder->session);
+  use_meter_ring(recorder, pipeline);
+  meter_ring_clear(recorder->meter_ring);
+  reset_dropouts(recorder, pipeline);
+  state_ret = gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_PLAYING);
+  if (state_ret == GST_STATE_CHANGE_FAILURE) {
+    g_set_error(err, CLIP_RECORDER_ERROR, CLIP_RECORDER_ERROR_STATE,
+		"Failed to set state of session pipeline to PLAYING");
+    gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
+    return FALSE;
+  }
+  recorder->active_pipeline = pipeline;
+  return TRUE;
+}
+
+gboolean
+clip_recorder_record_multi(ClipRecorder *recorder,
+			   GFile **files, const guint *group_channels,
+			   guint n_files, GError **err)
+{
+  GstStateChangeReturn state_ret;
+  GstPipeline *pipeline;
+  ClipRecorderMulti *multi;
+  GstElement *format;
+  GstCaps *caps;
+  guint channels = 0;
+  guint g;
+  g_return_val_if_fail(n_files > 0 && n_files <= CLIP_RECORDER_MAX_GROUPS,
+		       FALSE);
+  for (g = 0; g < n_files; g++) {
+    g_return_val_if_fail(group_channels[g] > 0, FALSE);
+    channels += group_channels[g];
+  }
+  if (channels > CLIP_RECORDER_MAX_CHANNELS) {
+    g_set_error(err, CLIP_RECORDER_ERROR, CLIP_RECORDER_ERROR_FAILED,
+		"Can't record %u channels, the limit is %u",
+		channels, CLIP_RECORDER_MAX_CHANNELS);
+    return FALSE;
+  }
+  cancel_active_pipeline(recorder);
+  pipeline = get_multi_pipeline(recorder, err);
+  if (!pipeline) {
+    return FALSE;
+  }
+  /* Just create the pipeline and catch any errors */
+  if (!get_adjust_pipeline(recorder, err)) {
+    return FALSE;
+  }
+
+  multi = recorder->multi;
+  multi_clear(multi);
+  multi->channels = channels;
+  for (g = 0; g < n_files; g++) {
+    MultiGroup *group = &multi->groups[g];
+    group->first = (g == 0 ? 0
+		    : multi->groups[g - 1].first + multi->groups[g - 1].channels);
+    group->channels = group_channels[g];
+    group->file = g_object_ref(files[g]);
+    group->raw_file = create_raw_file(files[g]);
+    multi->n_groups = g + 1;
+    group->writer = take_writer_new(group->raw_file, 48000, group->channels,
+				    err);
+    if (!group->writer) {
+      multi_clear(multi);
+      return FALSE;
+    }
+  }
+
+  format = gst_bin_get_by_name(GST_BIN(pipeline), "format");
+  g_assert(format);
+  caps = gst_caps_new_simple("audio/x-raw-int",
+			     "rate", G_TYPE_INT, 48000,
+			     "width", G_TYPE_INT, 16,
+			     "depth", G_TYPE_INT, 16,
+			     "signed", G_TYPE_BOOLEAN, TRUE,
+			     "endianness", G_TYPE_INT, G_LITTLE_ENDIAN,
+			     "channels", G_TYPE_INT, channels,
+			     NULL);
+  g_object_set(format, "caps", caps, NULL);
+  gst_caps_unref(caps);
+  g_object_unref(format);
+
+  use_meter_ring(recorder, pipeline);
+  meter_ring_clear(recorder->meter_ring);
+  reset_dropouts(recorder, pipeline);
+  memset(&recorder->take_stats, 0, sizeof(recorder->take_stats));
+
+  state_ret = gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_PLAYING);
+  if (state_ret == GST_STATE_CHANGE_FAILURE) {
+    g_set_error(err, CLIP_RECORDER_ERROR, CLIP_RECORDER_ERROR_STATE,
+		"Failed to set state of multi-mic pipeline to PLAYING");
+    gst_element_set_state(GST_ELEMENT(pipeline), GST_STATE_NULL);
+    multi_clear(multi);
     return FALSE;
   }
+  multi->active = TRUE;
   recorder->active_pipeline = pipeline;
   return TRUE;
 }
@@ -910,18 +2208,54 @@ clip_recorder_stop(ClipRecorder *recorder, GError **err)
 {
   if (recorder->active_pipeline) {
     GstEvent *eos = gst_event_new_eos ();
+    if (recorder->active_pipeline == recorder->record_pipeline
+	|| recorder->active_pipeline == recorder->multi_pipeline) {
+      recorder->take_stats.stop_requested = g_get_monotonic_time();
+      trace_begin("recorder", "turnaround");
+      trace_begin("recorder", "record-drain");
+    }
     gst_element_send_event(GST_ELEMENT(recorder->active_pipeline), eos);
   }
   return TRUE;
 }
 
+gboolean
+clip_recorder_is_active(ClipRecorder *recorder)
+{
+  return recorder->active_pipeline != NULL;
+}
+
 GstClockTimeDiff clip_recorder_recorded_length(ClipRecorder *recorder)
 {
   return recorder->trim_end - recorder->trim_start;
 }
 
+GstClockTimeDiff
+clip_recorder_group_length(ClipRecorder *recorder, guint group)
+{
+  MultiGroup *g;
+  g_return_val_if_fail(recorder->multi && group < recorder->multi->n_groups,
+		       0);
+  g = &recorder->multi->groups[group];
+  return g->trim_end - g->trim_start;
+}
+
 double
 clip_recorder_get_trim_level(ClipRecorder *recorder)
 {
   return recorder->trim_level;
 }
+
+const ClipRecorderDropout *
+clip_recorder_get_dropouts(ClipRecorder *recorder, guint *n_dropouts)
+{
+  *n_dropouts = recorder->dropouts->len;
+  return (const ClipRecorderDropout*)recorder->dropouts->data;
+}
+
+guint
+clip_recorder_read_meter(ClipRecorder *recorder, MeterValue *values, guint max)
+{
+  if (!recorder->meter_ring) return 0;
+  return meter_ring_pop(recorder->meter_ring, values, max);
+}
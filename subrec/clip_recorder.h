@@ -3,6 +3,8 @@
 #include <glib-object.h>
 #include <gst/gst.h>
 #include <gio/gio.h>
+#include <meter_ring.h>
+#include <take_writer.h>
 
 #define CLIP_RECORDER_ERROR (clip_recorder_error_quark())
 enum {
@@ -21,6 +23,51 @@ enum {
 
 typedef struct _ClipRecorder        ClipRecorder;
 typedef struct _ClipRecorderClass   ClipRecorderClass;
+typedef struct _ClipRecorderTakeStats ClipRecorderTakeStats;
+typedef struct _ClipRecorderSegment ClipRecorderSegment;
+typedef struct _ClipRecorderSession ClipRecorderSession;
+typedef struct _ClipRecorderDropout ClipRecorderDropout;
+typedef struct _ClipRecorderMulti ClipRecorderMulti;
+
+/* Timestamps for one recorded take, from g_get_monotonic_time().
+   Points that weren't reached are 0. */
+struct _ClipRecorderTakeStats
+{
+  gint64 record_started; /* Record pipeline reached PLAYING */
+  gint64 stop_requested; /* clip_recorder_stop() called */
+  gint64 record_eos;
+  gint64 record_stopped; /* Record pipeline back in READY */
+  gint64 adjust_started; /* Adjust pipeline set to PLAYING */
+  gint64 adjust_eos;
+  gint64 stopped; /* Before "stopped" is emitted */
+  gint64 ready; /* After all "stopped" handlers have returned */
+  GstClockTime adjusted_length; /* Length of the adjusted clip */
+  guint writer_overruns; /* Buffers dropped by the take writer */
+  gsize writer_high_water; /* Most bytes waiting to be written */
+  guint dropouts; /* Discontinuities in the captured stream */
+};
+
+/* A discontinuity in the captured stream */
+struct _ClipRecorderDropout
+{
+  /* From the start of the recording, GST_CLOCK_TIME_NONE if unknown */
+  GstClockTime position;
+  GstClockTime length; /* Missing time, 0 if unknown */
+};
+
+/* A stretch of speech found while recording a session. Times are
+   from the start of the session and include pre- and post-silence. */
+struct _ClipRecorderSegment
+{
+  GstClockTime start;
+  GstClockTime end;
+  /* Set by a "segment-detected" handler, otherwise the segment is
+     dropped. Owned by the segment. */
+  GFile *file;
+  gpointer user_data;
+  GDestroyNotify user_data_free;
+  GError *error; /* Set if writing the file failed */
+};
 
 struct _ClipRecorder
 {
@@ -30,16 +77,37 @@ struct _ClipRecorder
   GstPipeline *record_pipeline;
   GstPipeline *adjust_pipeline;
   GstPipeline *playback_pipeline;
+  GstPipeline *session_pipeline;
+  GstPipeline *multi_pipeline;
   GstPipeline *active_pipeline;
 
+  /* Owned by the analyzer in the record or session pipeline */
+  MeterRing *meter_ring;
+
   gdouble trim_level;
   GstClockTimeDiff pre_silence;
   GstClockTimeDiff post_silence;
+  gint64 buffer_time; /* Capture buffer, in microseconds */
+  gint64 latency_time; /* Capture period, in microseconds */
 
   /* Analysis results */
   GstClockTime trim_start;
   GstClockTime trim_end;
+  /* Raw silence before the speech that the denoiser learns from, 0 to
+     not denoise. The first noise_lead_in of it is before trim_start. */
+  GstClockTime noise_length;
+  GstClockTime noise_lead_in;
   gdouble loudness;
+  gdouble true_peak; /* Between trim_start and trim_end */
+  GArray *dropouts; /* ClipRecorderDropout in the last recording */
+
+  ClipRecorderTakeStats take_stats;
+
+  ClipRecorderSession *session;
+  ClipRecorderMulti *multi;
+
+  /* Writes the raw take, pushed to from the streaming thread */
+  TakeWriter *take_writer;
 };
 
 struct _ClipRecorderClass
@@ -53,16 +121,61 @@ struct _ClipRecorderClass
   void (*recording)(ClipRecorder *recorder, gpointer user_data);
   void (*playing)(ClipRecorder *recorder, gpointer user_data);
   void (*stopped)(ClipRecorder *recorder, gpointer user_data);
-  void (*power)(ClipRecorder *recorder, gdouble power);
+  /* Emitted after "stopped" when a recorded take is done */
+  void (*take_stats)(ClipRecorder *recorder,
+		     const ClipRecorderTakeStats *stats, gpointer user_data);
+  /* Emitted when a segment ends while recording a session */
+  void (*segment_detected)(ClipRecorder *recorder,
+			   ClipRecorderSegment *segment, gpointer user_data);
+  /* Emitted when the file of a segment is written, or failed to be */
+  void (*segment_saved)(ClipRecorder *recorder,
+			ClipRecorderSegment *segment, gpointer user_data);
+  /* Emitted when a recording with dropouts has ended. The array
+     contains ClipRecorderDropout. */
+  void (*dropouts)(ClipRecorder *recorder, const GArray *dropouts,
+		   gpointer user_data);
 };
 
+#define CLIP_RECORDER_METER_INTERVAL (20 * GST_MSECOND)
+
+/* Limits for multi-mic recording */
+#define CLIP_RECORDER_MAX_CHANNELS 8
+#define CLIP_RECORDER_MAX_GROUPS CLIP_RECORDER_MAX_CHANNELS
+
 ClipRecorder *clip_recorder_new(void);
 
 gboolean clip_recorder_record(ClipRecorder *recorder, GFile *file,GError **err);
+/* Record continuously until stopped. Speech is detected using the
+   trim level and each segment is written to the file set by the
+   "segment-detected" handler. */
+gboolean clip_recorder_record_session(ClipRecorder *recorder, GError **err);
+/* Record several microphones from one multichannel input. The channels
+   are split into n_files consecutive groups, group i having
+   group_channels[i] channels. Each group is trimmed and normalized on
+   its own and written to files[i]. "stopped" is emitted when all files
+   are written. */
+gboolean
+clip_recorder_record_multi(ClipRecorder *recorder,
+			   GFile **files, const guint *group_channels,
+			   guint n_files, GError **err);
 gboolean clip_recorder_play(ClipRecorder *recorder, GFile *file, GError **err);
 gboolean clip_recorder_stop(ClipRecorder *recorder, GError **err);
+/* TRUE while recording, playing or adjusting a take */
+gboolean clip_recorder_is_active(ClipRecorder *recorder);
 
 GstClockTimeDiff clip_recorder_recorded_length(ClipRecorder *recorder);
+/* Length of the file written for a group of the last multi-mic take */
+GstClockTimeDiff
+clip_recorder_group_length(ClipRecorder *recorder, guint group);
 double clip_recorder_get_trim_level(ClipRecorder *recorder);
 
+/* Dropouts found in the last recording */
+const ClipRecorderDropout *
+clip_recorder_get_dropouts(ClipRecorder *recorder, guint *n_dropouts);
+
+/* Read meter values written since the last call, oldest first. Never
+   blocks, so it's safe to call every frame while recording. */
+guint
+clip_recorder_read_meter(ClipRecorder *recorder, MeterValue *values, guint max);
+
 #endif /* __CLIP_RECORDER_H__NQKIV1K2IA__ */
@@ -0,0 +1,69 @@
+#include <dropout_detector.h>
+
+#define DETECTOR_KEY "dropout-detector"
+
+typedef struct
+{
+  GstElement *element; /* Not referenced, owns the detector */
+  GstClockTime next; /* Expected timestamp of the next buffer */
+} DropoutDetector;
+
+static void
+post_dropout(DropoutDetector *detector,
+	     GstClockTime position, GstClockTime length)
+{
+  GstStructure *s = gst_structure_new(DROPOUT_MESSAGE,
+				      DROPOUT_MESSAGE_POSITION,
+				      G_TYPE_UINT64, position,
+				      DROPOUT_MESSAGE_LENGTH,
+				      G_TYPE_UINT64, length,
+				      NULL);
+  gst_element_post_message(detector->element,
+			   gst_message_new_element(GST_OBJECT(detector->element),
+						   s));
+}
+
+/* Called from the streaming thread */
+static gboolean
+buffer_probe(GstPad *pad, GstBuffer *buffer, gpointer user_data)
+{
+  DropoutDetector *detector = user_data;
+  GstClockTime ts = GST_BUFFER_TIMESTAMP(buffer);
+  if (GST_CLOCK_TIME_IS_VALID(detector->next)) {
+    if (GST_CLOCK_TIME_IS_VALID(ts)
+	&& ts > detector->next + DROPOUT_TOLERANCE) {
+      post_dropout(detector, detector->next, ts - detector->next);
+    } else if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT)) {
+      post_dropout(detector, GST_CLOCK_TIME_IS_VALID(ts) ? ts : detector->next,
+		   0);
+    }
+  }
+  /* The first buffer is always DISCONT, so it's not checked */
+  if (GST_CLOCK_TIME_IS_VALID(ts) && GST_BUFFER_DURATION_IS_VALID(buffer)) {
+    detector->next = ts + GST_BUFFER_DURATION(buffer);
+  }
+  return TRUE;
+}
+
+void
+dropout_detector_attach(GstElement *element)
+{
+  DropoutDetector *detector;
+  GstPad *pad = gst_element_get_static_pad(element, "src");
+  g_return_if_fail(pad != NULL);
+  detector = g_new(DropoutDetector, 1);
+  detector->element = element;
+  detector->next = GST_CLOCK_TIME_NONE;
+  g_object_set_data_full(G_OBJECT(element), DETECTOR_KEY, detector, g_free);
+  gst_pad_add_buffer_probe(pad, G_CALLBACK(buffer_probe), detector);
+  gst_object_unref(pad);
+}
+
+void
+dropout_detector_reset(GstElement *element)
+{
+  DropoutDetector *detector = g_object_get_data(G_OBJECT(element),
+						DETECTOR_KEY);
+  g_return_if_fail(detector != NULL);
+  detector->next = GST_CLOCK_TIME_NONE;
+}
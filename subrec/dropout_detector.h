@@ -0,0 +1,26 @@
+#ifndef __DROPOUT_DETECTOR_H__W2HN6QXE5P__
+#define __DROPOUT_DETECTOR_H__W2HN6QXE5P__
+
+#include <gst/gst.h>
+
+/* Finds discontinuities in a live audio stream: buffers flagged
+   DISCONT and gaps between buffer timestamps. Each one is posted as an
+   element message from the watched element. */
+
+#define DROPOUT_MESSAGE "dropout"
+#define DROPOUT_MESSAGE_POSITION "position" /* Start of the gap */
+#define DROPOUT_MESSAGE_LENGTH "length" /* Missing time, 0 if unknown */
+
+/* Gaps shorter than this are timestamp jitter */
+#define DROPOUT_TOLERANCE (GST_MSECOND / 2)
+
+/* Watch the buffers leaving the source pad of element */
+void
+dropout_detector_attach(GstElement *element);
+
+/* Forget the last buffer. Call before the stream is restarted, when
+   no buffers are flowing. */
+void
+dropout_detector_reset(GstElement *element);
+
+#endif /* __DROPOUT_DETECTOR_H__W2HN6QXE5P__ */
@@ -0,0 +1,388 @@
+/* Benchmark for sequence export.
+
+   Generates a synthetic project of N reels with M spots each, writes a
+   WAV clip for every spot and exports the whole sequence with
+   SaveSequence. Every clip sample carries a value derived from the clip
+   number and offset, so the exported file can be checked sample by
+   sample against the layout it was generated from.
+
+   Reports wall time, samples per second, source switch overhead and
+   peak RSS. Exits with failure if the output doesn't match. */
+
+#include <save_sequence.h>
+#include <subtitle_store.h>
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <sys/resource.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define SAMPLE_RATE 48000
+
+static gint n_reels = 4;
+static gint n_spots = 50;
+static gdouble gap_mean = 2.0;
+static gdouble clip_mean = 3.0;
+static gchar *gap_distribution = NULL;
+static gint seed = 4711;
+static gboolean keep = FALSE;
+
+static GOptionEntry entries[] = {
+  {"reels", 'r', 0, G_OPTION_ARG_INT, &n_reels,
+   "Number of reels", "N"},
+  {"spots", 'n', 0, G_OPTION_ARG_INT, &n_spots,
+   "Number of spots per reel", "M"},
+  {"gap", 'g', 0, G_OPTION_ARG_DOUBLE, &gap_mean,
+   "Mean gap between clips in seconds", "S"},
+  {"clip", 'c', 0, G_OPTION_ARG_DOUBLE, &clip_mean,
+   "Mean clip length in seconds", "S"},
+  {"distribution", 'd', 0, G_OPTION_ARG_STRING, &gap_distribution,
+   "Gap distribution, uniform or exponential", "D"},
+  {"seed", 's', 0, G_OPTION_ARG_INT, &seed,
+   "Random seed for the layout", "N"},
+  {"keep", 'k', 0, G_OPTION_ARG_NONE, &keep,
+   "Keep the generated files", NULL},
+  {NULL}
+};
+
+typedef struct
+{
+  guint64 start; /* Global sample offset */
+  guint64 length;
+  guint index;
+} Clip;
+
+static GMainLoop *main_loop = NULL;
+static gboolean export_failed = FALSE;
+
+static inline gint16
+clip_sample(guint index, guint64 offset)
+{
+  /* Never zero, so clips can be told apart from silence */
+  return ((index * 7919 + offset) % 32000) + 1;
+}
+
+static inline GstClockTime
+sample_to_ns(guint64 sample)
+{
+  return gst_util_uint64_scale_int_round(sample, GST_SECOND, SAMPLE_RATE);
+}
+
+static guint64
+random_gap(GRand *rand, gboolean exponential)
+{
+  gdouble s;
+  if (exponential) {
+    s = -gap_mean * log(1.0 - g_rand_double(rand));
+  } else {
+    s = g_rand_double_range(rand, 0.0, 2.0 * gap_mean);
+  }
+  return s * SAMPLE_RATE;
+}
+
+static void
+put_le32(guint8 *p, guint32 v)
+{
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static void
+put_le16(guint8 *p, guint16 v)
+{
+  p[0] = v; p[1] = v >> 8;
+}
+
+static gboolean
+write_clip(const gchar *filename, const Clip *clip, GError **err)
+{
+  gsize data_size = clip->length * 2;
+  guint8 *buffer = g_malloc(44 + data_size);
+  guint64 i;
+  gboolean ret;
+  memcpy(buffer, "RIFF", 4);
+  put_le32(buffer + 4, 36 + data_size);
+  memcpy(buffer + 8, "WAVEfmt ", 8);
+  put_le32(buffer + 16, 16);
+  put_le16(buffer + 20, 1); /* PCM */
+  put_le16(buffer + 22, 1);
+  put_le32(buffer + 24, SAMPLE_RATE);
+  put_le32(buffer + 28, SAMPLE_RATE * 2);
+  put_le16(buffer + 32, 2);
+  put_le16(buffer + 34, 16);
+  memcpy(buffer + 36, "data", 4);
+  put_le32(buffer + 40, data_size);
+  for (i = 0; i < clip->length; i++) {
+    put_le16(buffer + 44 + 2 * i, clip_sample(clip->index, i));
+  }
+  ret = g_file_set_contents(filename, (gchar*)buffer, 44 + data_size, err);
+  g_free(buffer);
+  return ret;
+}
+
+/* Creates the project in the store and the clip files in dir. Returns
+   the clips in sequence order, sets *end to the last sample of the
+   sequence. */
+static GArray *
+generate_project(SubtitleStore *store, const gchar *dir, guint64 *end,
+		 GError **err)
+{
+  GRand *rand = g_rand_new_with_seed(seed);
+  gboolean exponential = (g_strcmp0(gap_distribution, "exponential") == 0);
+  GArray *clips = g_array_new(FALSE, FALSE, sizeof(Clip));
+  guint64 reel_start = 0;
+  gint r;
+  for (r = 0; r < n_reels; r++) {
+    GtkTreeIter reel_iter;
+    gchar id[16];
+    guint64 pos = 0;
+    gint s;
+    GArray *reel_clips = g_array_new(FALSE, FALSE, sizeof(Clip));
+    /* Lay out the reel first, it has to be inserted with its length */
+    for (s = 0; s < n_spots; s++) {
+      Clip clip;
+      pos += random_gap(rand, exponential);
+      clip.start = pos;
+      clip.length = (g_rand_double_range(rand, 0.5, 1.5) * clip_mean
+		     * SAMPLE_RATE);
+      if (clip.length == 0) clip.length = 1;
+      clip.index = clips->len + reel_clips->len;
+      g_array_append_val(reel_clips, clip);
+      pos += clip.length;
+    }
+    pos += random_gap(rand, exponential) + 1;
+    g_snprintf(id, sizeof(id), "%d", r + 1);
+    subtitle_store_insert(store, sample_to_ns(reel_start),
+			  sample_to_ns(reel_start + pos), id, 0,
+			  NULL, &reel_iter);
+    for (s = 0; s < n_spots; s++) {
+      GtkTreeIter spot_iter;
+      Clip *clip = &g_array_index(reel_clips, Clip, s);
+      gchar *name;
+      gchar *path;
+      g_snprintf(id, sizeof(id), "%d", s + 1);
+      subtitle_store_insert(store, sample_to_ns(clip->start),
+			    sample_to_ns(clip->start + clip->length), id, 0,
+			    &reel_iter, &spot_iter);
+      name = g_strdup_printf("%d_%d_1.wav", r + 1, s + 1);
+      path = g_build_filename(dir, name, NULL);
+      if (!write_clip(path, clip, err)) {
+	g_free(path);
+	g_free(name);
+	g_array_free(reel_clips, TRUE);
+	g_array_free(clips, TRUE);
+	g_rand_free(rand);
+	return NULL;
+      }
+      g_free(path);
+      subtitle_store_set_file(store, &spot_iter, name,
+			      sample_to_ns(clip->length));
+      g_free(name);
+      clip->start += reel_start;
+    }
+    g_array_append_vals(clips, reel_clips->data, reel_clips->len);
+    g_array_free(reel_clips, TRUE);
+    reel_start += pos;
+  }
+  *end = reel_start;
+  g_rand_free(rand);
+  return clips;
+}
+
+static guint32
+get_le32(const guint8 *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((guint32)p[3] << 24);
+}
+
+/* Returns the number of mismatching samples, or -1 if the file can't
+   be read */
+static gint64
+verify_output(const gchar *filename, const GArray *clips, guint64 end)
+{
+  gchar *contents;
+  gsize length;
+  const guint8 *p;
+  const guint8 *data = NULL;
+  guint64 n_samples = 0;
+  guint64 s;
+  guint c = 0;
+  gint64 errors = 0;
+  GError *err = NULL;
+  if (!g_file_get_contents(filename, &contents, &length, &err)) {
+    g_printerr("Failed to read output: %s\n", err->message);
+    g_error_free(err);
+    return -1;
+  }
+  /* Find the data chunk */
+  p = (const guint8*)contents + 12;
+  while(p + 8 <= (const guint8*)contents + length) {
+    guint32 size = get_le32(p + 4);
+    if (memcmp(p, "data", 4) == 0) {
+      data = p + 8;
+      n_samples = MIN(size, (const guint8*)contents + length - data) / 2;
+      break;
+    }
+    p += 8 + size + (size & 1);
+  }
+  if (!data) {
+    g_printerr("No data chunk in output\n");
+    g_free(contents);
+    return -1;
+  }
+  if (n_samples != end) {
+    g_printerr("Output has %" G_GUINT64_FORMAT " samples, expected %"
+	       G_GUINT64_FORMAT "\n", n_samples, end);
+    errors += (n_samples > end) ? n_samples - end : end - n_samples;
+  }
+  for (s = 0; s < MIN(n_samples, end); s++) {
+    gint16 expected = 0;
+    gint16 v = data[2 * s] | (data[2 * s + 1] << 8);
+    while (c < clips->len
+	   && s >= (g_array_index(clips, Clip, c).start
+		    + g_array_index(clips, Clip, c).length)) {
+      c++;
+    }
+    if (c < clips->len && s >= g_array_index(clips, Clip, c).start) {
+      const Clip *clip = &g_array_index(clips, Clip, c);
+      expected = clip_sample(clip->index, s - clip->start);
+    }
+    if (v != expected) {
+      if (errors == 0) {
+	g_printerr("First mismatch at sample %" G_GUINT64_FORMAT
+		   ": %d, expected %d\n", s, v, expected);
+      }
+      errors++;
+    }
+  }
+  g_free(contents);
+  return errors;
+}
+
+static void
+run_error_cb(SaveSequence *sseq, GError *err, gpointer user_data)
+{
+  g_printerr("Export failed: %s\n", err->message);
+  export_failed = TRUE;
+  g_main_loop_quit(main_loop);
+}
+
+static void
+done_cb(SaveSequence *sseq, gpointer user_data)
+{
+  g_main_loop_quit(main_loop);
+}
+
+static void
+remove_files(const gchar *dir)
+{
+  GDir *d = g_dir_open(dir, 0, NULL);
+  const gchar *name;
+  if (!d) return;
+  while((name = g_dir_read_name(d))) {
+    gchar *path = g_build_filename(dir, name, NULL);
+    g_unlink(path);
+    g_free(path);
+  }
+  g_dir_close(d);
+  g_rmdir(dir);
+}
+
+int
+main(int argc, char *argv[])
+{
+  GOptionContext *context;
+  GError *err = NULL;
+  SubtitleStore *store;
+  SaveSequence *sseq;
+  const SaveSequenceStats *stats;
+  GArray *clips;
+  gchar *dir;
+  gchar *output_path;
+  GFile *working_directory;
+  GFile *output;
+  guint64 end;
+  gint64 start_time;
+  gdouble elapsed;
+  gint64 errors;
+  struct rusage usage;
+
+  context = g_option_context_new(" - export benchmark");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("%s\n", err->message);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+  if (n_reels < 1 || n_spots < 1) {
+    g_printerr("Need at least one reel and one spot\n");
+    return EXIT_FAILURE;
+  }
+
+  dir = g_dir_make_tmp("export_bench-XXXXXX", &err);
+  if (!dir) {
+    g_printerr("%s\n", err->message);
+    return EXIT_FAILURE;
+  }
+  store = subtitle_store_new();
+  clips = generate_project(store, dir, &end, &err);
+  if (!clips) {
+    g_printerr("Failed to generate project: %s\n", err->message);
+    return EXIT_FAILURE;
+  }
+  g_print("%d reels, %d spots per reel, %.1f s of audio in %s\n",
+	  n_reels, n_spots, (gdouble)end / SAMPLE_RATE, dir);
+
+  working_directory = g_file_new_for_path(dir);
+  output_path = g_build_filename(dir, "export.wav", NULL);
+  output = g_file_new_for_path(output_path);
+
+  main_loop = g_main_loop_new(NULL, FALSE);
+  sseq = save_sequence_new(&err);
+  g_signal_connect(sseq, "run-error", G_CALLBACK(run_error_cb), NULL);
+  g_signal_connect(sseq, "done", G_CALLBACK(done_cb), NULL);
+
+  start_time = g_get_monotonic_time();
+  if (!save_sequence(sseq, output, store, working_directory,
+		     0, sample_to_ns(end), &err)) {
+    g_printerr("Failed to start export: %s\n", err->message);
+    return EXIT_FAILURE;
+  }
+  g_main_loop_run(main_loop);
+  elapsed = (g_get_monotonic_time() - start_time) * 1e-6;
+  stats = save_sequence_get_stats(sseq);
+
+  getrusage(RUSAGE_SELF, &usage);
+  g_print("Wall time: %.3f s\n", elapsed);
+  g_print("Throughput: %.0f samples/s (%.1fx real time)\n",
+	  end / elapsed, end / elapsed / SAMPLE_RATE);
+  if (stats->switches > 0) {
+    g_print("Switches: %u, mean %.3f ms, max %.3f ms, %.1f%% of wall time\n",
+	    stats->switches,
+	    stats->switch_time_total * 1e-3 / stats->switches,
+	    stats->switch_time_max * 1e-3,
+	    stats->switch_time_total * 1e-4 / elapsed);
+  }
+  g_print("Peak RSS: %ld kB\n", usage.ru_maxrss);
+
+  errors = export_failed ? -1 : verify_output(output_path, clips, end);
+  if (errors == 0) {
+    g_print("Output verified\n");
+  } else if (errors > 0) {
+    g_print("%" G_GINT64_FORMAT " samples differ\n", errors);
+  }
+
+  g_object_unref(sseq);
+  g_object_unref(store);
+  g_object_unref(output);
+  g_object_unref(working_directory);
+  g_main_loop_unref(main_loop);
+  if (!keep) {
+    remove_files(dir);
+  }
+  g_free(output_path);
+  g_free(dir);
+  g_array_free(clips, TRUE);
+  return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,6 +1,7 @@
 
 #include "gtkcellrenderertime.h"
 #include <time_string.h>
+#include <string.h>
 
 static GObjectClass *parent_class = NULL;
 
@@ -15,11 +16,17 @@ enum {
 static void
 update_text(GtkCellRendererTime *renderer)
 {
-  gchar buffer[20];
-  time_string_format(buffer, sizeof(buffer),
-		     (renderer->time + renderer->time_plus
-		      + renderer->time_minus));
-  g_object_set(renderer, "text", buffer , NULL);
+  GtkCellRendererTimeCacheEntry *entry;
+  gint64 time = renderer->time + renderer->time_plus + renderer->time_minus;
+  /* Fibonacci hashing */
+  guint slot = (((guint64)time * G_GUINT64_CONSTANT(0x9e3779b97f4a7c15))
+		>> 32) & (GTK_CELL_RENDERER_TIME_CACHE_SIZE - 1);
+  entry = &renderer->cache[slot];
+  if (entry->text[0] == '\0' || entry->time != time) {
+    time_string_format(entry->text, sizeof(entry->text), time);
+    entry->time = time;
+  }
+  g_object_set(renderer, "text", entry->text, NULL);
 }
 
 static void
@@ -111,6 +118,7 @@ gtk_cell_renderer_time_init(GtkCellRendererTime *renderer)
   renderer->time = 0LL;
   renderer->time_plus = 0LL;
   renderer->time_minus = 0LL;
+  memset(renderer->cache, 0, sizeof(renderer->cache));
 }
 
 GType
@@ -12,14 +12,26 @@ G_BEGIN_DECLS
 
 #define GTK_CELL_RENDERER_TIME_INVALID G_MININT64
 
+#define GTK_CELL_RENDERER_TIME_CACHE_SIZE 64 /* Power of two */
+
 typedef struct _GtkCellRendererTime GtkCellRendererTime;
 typedef struct _GtkCellRendererTimeClass GtkCellRendererTimeClass;
+typedef struct _GtkCellRendererTimeCacheEntry GtkCellRendererTimeCacheEntry;
+
+struct _GtkCellRendererTimeCacheEntry
+{
+  gint64 time; /* Sum of time, time_plus and time_minus */
+  gchar text[32]; /* Empty if unused */
+};
+
 struct _GtkCellRendererTime
 {
   GtkCellRendererText parent;
   gint64 time;
   gint64 time_plus;
   gint64 time_minus;
+  /* Recently formatted times, indexed by a hash of the time */
+  GtkCellRendererTimeCacheEntry cache[GTK_CELL_RENDERER_TIME_CACHE_SIZE];
 };
 
 struct _GtkCellRendererTimeClass
@@ -16,6 +16,11 @@
 #include <preferences_dialog.h>
 #include <preferences.h>
 #include <save_sequence.h>
+#include <trace_log.h>
+#include <working_dir_index.h>
+#include <recover_files.h>
+#include <clean_files.h>
+#include <time_compress.h>
 #include <string.h>
 #include <math.h>
 #include <glib/gi18n.h>
@@ -42,6 +47,7 @@ subrec_error_quark()
 
 #define dB(x) (powf(10.0,((x)/10.0)))
 #define DEFAULT_TOP_LEVEL dB(-3)
+#define DEFAULT_PEAK_LEVEL dB(-1) /* Compared to the squared true-peak */
 
 typedef struct
 {
@@ -98,14 +104,29 @@ typedef struct
   PackingList *packing_list;
   CompositionPlaylist *cpl;
   GtkTreeView *subtitle_list_view;
+  GtkTreeViewColumn *text_column;
+  GtkCellRenderer *text_render;
   GtkTreeSelection *subtitle_selection;
   GtkTextBuffer *subtitle_text_buffer;
   GtkTextView *subtitle_text_view;
+  GtkWidget *find_bar;
+  GtkEntry *find_entry;
+  GtkLabel *find_status;
+  GPtrArray *find_results; /* NULL if the store changed since searching */
+  guint find_pos;
   ClipRecorder *recorder;
   guint record_timer;
+  guint meter_tick;
   GFile *recorded_file;
+  /* Files of a multi-mic take, one for each group */
+  GFile *mic_files[CLIP_RECORDER_MAX_GROUPS];
+  guint n_mic_files;
+  gboolean recording_session;
+  /* The last spot of the session has got its segment */
+  gboolean session_spots_used;
   double normal_level;
   GFile *working_directory;
+  WorkingDirIndex *dir_index;
   SaveSequence *save_sequence;
 } InstanceContext;
 
@@ -126,13 +147,25 @@ instance_create(AppContext *app_ctxt)
   inst->subtitle_store = NULL;
   inst->active_subtitle = NULL;
   inst->subtitle_list_view = NULL;
+  inst->text_column = NULL;
+  inst->text_render = NULL;
   inst->subtitle_selection = NULL;
   inst->subtitle_text_buffer = NULL;
   inst->subtitle_text_view = NULL;
+  inst->find_bar = NULL;
+  inst->find_entry = NULL;
+  inst->find_status = NULL;
+  inst->find_results = NULL;
+  inst->find_pos = 0;
   inst->recorder = NULL;
   inst->record_timer = 0;
+  inst->meter_tick = 0;
   inst->recorded_file = NULL;
+  inst->n_mic_files = 0;
+  inst->recording_session = FALSE;
+  inst->session_spots_used = FALSE;
   inst->working_directory = NULL;
+  inst->dir_index = NULL;
   inst->save_sequence = NULL;
   inst->app_actions = NULL;
   inst->instance_actions = NULL;
@@ -141,9 +174,15 @@ instance_create(AppContext *app_ctxt)
   return inst;
 }
 
+static void
+clear_mic_files(InstanceContext *inst);
+
 static void
 instance_free(InstanceContext *inst)
 {
+  g_signal_handlers_disconnect_matched(inst->app_ctxt->settings,
+				       G_SIGNAL_MATCH_DATA, 0, 0,
+				       NULL, NULL, inst);
   if (inst->record_timer != 0) {
     g_source_remove(inst->record_timer);
     inst->record_timer = 0;
@@ -160,15 +199,32 @@ instance_free(InstanceContext *inst)
   g_clear_object(&inst->asset_map);
   g_clear_object(&inst->packing_list);
   g_clear_object(&inst->cpl);
+  if (inst->subtitle_store) {
+    g_signal_handlers_disconnect_matched(inst->subtitle_store,
+					 G_SIGNAL_MATCH_DATA, 0, 0,
+					 NULL, NULL, inst);
+  }
   g_clear_object(&inst->subtitle_store);
   if (inst->active_subtitle) {
     gtk_tree_path_free(inst->active_subtitle);
     inst->active_subtitle = NULL;
   }
   g_clear_object(&inst->subtitle_text_buffer);
+  if (inst->find_results) {
+    g_ptr_array_unref(inst->find_results);
+    inst->find_results = NULL;
+  }
+  if (inst->recorder) {
+    /* Segments still being written report after the instance is gone */
+    g_signal_handlers_disconnect_matched(inst->recorder,
+					 G_SIGNAL_MATCH_DATA, 0, 0,
+					 NULL, NULL, inst);
+  }
   g_clear_object(&inst->recorder);
   g_clear_object(&inst->save_sequence);
   g_clear_object(&inst->recorded_file);
+  clear_mic_files(inst);
+  g_clear_object(&inst->dir_index);
   g_clear_object(&inst->working_directory);
   g_free(inst);
   g_debug("Instance freed");
@@ -473,6 +529,8 @@ set_working_directory(InstanceContext *inst, GFile *wd, GError **err)
   }
   inst->working_directory = wd;
   g_object_ref(inst->working_directory);
+  g_clear_object(&inst->dir_index);
+  inst->dir_index = working_dir_index_new(wd);
   file = get_list_file(inst);
   subtitle_store_remove(inst->subtitle_store, NULL);
   subtitle_file = g_file_get_child (wd, "SUBTITLES.xml");
@@ -481,6 +539,7 @@ set_working_directory(InstanceContext *inst, GFile *wd, GError **err)
     g_object_unref(file);
     if (!ret)  {
       inst->working_directory = NULL;
+      g_clear_object(&inst->dir_index);
     }
   }
   g_object_unref(subtitle_file);
@@ -515,6 +574,150 @@ activate_save(GSimpleAction *action,
   save_list(inst);
 }
 
+/* user_data is a reference to the main window */
+static void
+recover_files_done(guint n_recovered, gpointer user_data)
+{
+  GtkWindow *win = user_data;
+  GtkWidget *dialog;
+  if (gtk_widget_in_destruction(GTK_WIDGET(win))) win = NULL;
+  dialog = gtk_message_dialog_new(win, GTK_DIALOG_DESTROY_WITH_PARENT,
+				  GTK_MESSAGE_INFO, GTK_BUTTONS_CLOSE,
+				  "Recovered %u files", n_recovered);
+  g_signal_connect(dialog, "response", G_CALLBACK(gtk_widget_destroy), NULL);
+  gtk_widget_show(dialog);
+  g_object_unref(user_data);
+}
+
+static void
+activate_recover_files(GSimpleAction *action,
+		       GVariant      *parameter,
+		       gpointer user_data)
+{
+  InstanceContext *inst = user_data;
+  if (!inst->working_directory || !inst->dir_index) {
+    show_error_msg(inst, "No working directory set",
+		   "Select a directory using the menu");
+    return;
+  }
+  if (!working_dir_index_is_ready(inst->dir_index)) {
+    show_error_msg(inst, "Working directory not ready",
+		   "Still reading the working directory, try again later");
+    return;
+  }
+  /* Files already in a list are skipped when attaching, so running
+     this again before it's done is harmless */
+  g_object_ref(inst->main_win);
+  recover_files(inst->subtitle_store, inst->dir_index,
+		recover_files_done, inst->main_win);
+}
+
+#define CLEAN_RESPONSE_TRASH 1
+#define CLEAN_RESPONSE_DELETE 2
+
+static void
+clean_files_progress(guint done, guint total, gpointer user_data)
+{
+  g_debug("Cleaned %u of %u files", done, total);
+}
+
+/* user_data is a reference to the main window */
+static void
+clean_files_done(guint removed, const GError *error, gpointer user_data)
+{
+  GtkWindow *win = user_data;
+  GtkWidget *dialog;
+  if (gtk_widget_in_destruction(GTK_WIDGET(win))) win = NULL;
+  if (error) {
+    dialog = gtk_message_dialog_new(win, GTK_DIALOG_DESTROY_WITH_PARENT,
+				    GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+				    "Cleaning stopped after %u files", removed);
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+					     "%s", error->message);
+  } else {
+    dialog = gtk_message_dialog_new(win, GTK_DIALOG_DESTROY_WITH_PARENT,
+				    GTK_MESSAGE_INFO, GTK_BUTTONS_CLOSE,
+				    "Removed %u files", removed);
+  }
+  g_signal_connect(dialog, "response", G_CALLBACK(gtk_widget_destroy), NULL);
+  gtk_widget_show(dialog);
+  g_object_unref(user_data);
+}
+
+static void
+clean_files_response(GtkDialog *dialog, gint response_id,
+		     InstanceContext *inst)
+{
+  CleanFilesPlan *plan = g_object_steal_data(G_OBJECT(dialog), "plan");
+  gtk_widget_destroy(GTK_WIDGET(dialog));
+  if (response_id == CLEAN_RESPONSE_TRASH
+      || response_id == CLEAN_RESPONSE_DELETE) {
+    g_object_ref(inst->main_win);
+    clean_files_run(plan, response_id == CLEAN_RESPONSE_TRASH,
+		    clean_files_progress, clean_files_done, inst->main_win);
+  } else {
+    clean_files_plan_free(plan);
+  }
+}
+
+static void
+activate_clean_files(GSimpleAction *action,
+		     GVariant      *parameter,
+		     gpointer user_data)
+{
+  InstanceContext *inst = user_data;
+  CleanFilesMode mode;
+  CleanFilesPlan *plan;
+  GtkWidget *dialog;
+  gchar *size;
+  if (!inst->working_directory || !inst->dir_index) {
+    show_error_msg(inst, "No working directory set",
+		   "Select a directory using the menu");
+    return;
+  }
+  if (!working_dir_index_is_ready(inst->dir_index)) {
+    show_error_msg(inst, "Working directory not ready",
+		   "Still reading the working directory, try again later");
+    return;
+  }
+  if (strcmp(g_variant_get_string(parameter, NULL), "not-selected") == 0) {
+    mode = CLEAN_FILES_NOT_SELECTED;
+  } else {
+    mode = CLEAN_FILES_NOT_IN_LIST;
+  }
+  plan = clean_files_plan(inst->subtitle_store, inst->dir_index, mode);
+  if (clean_files_plan_n_files(plan) == 0) {
+    clean_files_plan_free(plan);
+    show_error_msg(inst, "Nothing to clean",
+		   "All files in the working directory are in use");
+    return;
+  }
+  dialog = gtk_message_dialog_new(GTK_WINDOW(inst->main_win),
+				  GTK_DIALOG_MODAL
+				  | GTK_DIALOG_DESTROY_WITH_PARENT,
+				  GTK_MESSAGE_QUESTION, GTK_BUTTONS_NONE,
+				  (mode == CLEAN_FILES_NOT_SELECTED
+				   ? "Remove %u files not selected?"
+				   : "Remove %u files not in the list?"),
+				  clean_files_plan_n_files(plan));
+  size = g_format_size(clean_files_plan_size(plan));
+  gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+					   "This frees %s. Files moved to the"
+					   " %s directory can be restored.",
+					   size, CLEAN_FILES_TRASH_DIR);
+  g_free(size);
+  gtk_dialog_add_buttons(GTK_DIALOG(dialog),
+			 "_Cancel", GTK_RESPONSE_CANCEL,
+			 "Move to _Trash", CLEAN_RESPONSE_TRASH,
+			 "_Delete", CLEAN_RESPONSE_DELETE,
+			 NULL);
+  g_object_set_data_full(G_OBJECT(dialog), "plan", plan,
+			 (GDestroyNotify)clean_files_plan_free);
+  g_signal_connect(dialog, "response",
+		   G_CALLBACK(clean_files_response), inst);
+  gtk_widget_show(dialog);
+}
+
 static void
 export_dialog_destroy(GtkWidget *widget, InstanceContext *inst)
 {
@@ -550,7 +753,11 @@ save_sequence_run_error_cb(SaveSequence *sseq, GError *err, InstanceContext *ins
 static void
 save_sequence_done_cb(SaveSequence *sseq, InstanceContext *inst)
 {
+  const SaveSequenceStats *stats = save_sequence_get_stats(sseq);
   save_sequence_progress_stop(inst);
+  g_debug("Sequence saved in %.1fs, %u switches, %.2fms max switch",
+	  (stats->done - stats->started) * 1e-6, stats->switches,
+	  stats->switch_time_max * 1e-3);
 }
 
 static gboolean
@@ -687,7 +894,8 @@ activate_play(GSimpleAction *action,
   g_object_unref(file);
 }
 
-static void
+/* Returns FALSE if there is no next spot */
+static gboolean
 select_next_subtitle(InstanceContext *inst)
 {
   GtkTreeIter iter;
@@ -696,22 +904,26 @@ select_next_subtitle(InstanceContext *inst)
   GtkTreePath *path;
   if (!gtk_tree_selection_get_selected (inst->subtitle_selection,
 					&model, &iter)) {
-    return;
+    return FALSE;
   }
   child = iter;
   if (!gtk_tree_model_iter_next(model, &iter)) {
     GtkTreeIter parent;
-    if (!gtk_tree_model_iter_parent(model, &parent, &child)) return;
-    if (!gtk_tree_model_iter_next(model, &parent)) return;
-    if (!gtk_tree_model_iter_children(model, &iter, &parent)) return;
+    if (!gtk_tree_model_iter_parent(model, &parent, &child)) return FALSE;
+    if (!gtk_tree_model_iter_next(model, &parent)) return FALSE;
+    if (!gtk_tree_model_iter_children(model, &iter, &parent)) return FALSE;
   }
   /* gtk_tree_selection_select_iter (inst->subtitle_selection, &iter); */
   path = gtk_tree_model_get_path(model, &iter);
   gtk_tree_view_expand_to_path(inst->subtitle_list_view, path);
   gtk_tree_view_set_cursor(inst->subtitle_list_view, path, NULL, FALSE);
   gtk_tree_path_free(path);
+  return TRUE;
 }
 
+static void
+stop_metering(InstanceContext *inst);
+
 static void
 activate_stop(GSimpleAction *action,
 	      GVariant      *parameter,
@@ -722,6 +934,7 @@ activate_stop(GSimpleAction *action,
   if (!clip_recorder_stop(inst->recorder, &error)) {
     show_error(inst, "Failed to stop recording/playback", &error);
   }
+  stop_metering(inst);
 
   if (inst->record_timer) {
     g_source_remove(inst->record_timer);
@@ -733,16 +946,30 @@ activate_stop(GSimpleAction *action,
 
 #define CLIP_PREFIX "spot_"
 
-static GFile *
-create_clip_name(GtkTreeModel *model, GtkTreePath *path, GFile *dir)
+static gchar *
+clip_filename(const gchar *reel_id, const gchar *spot_id, guint version,
+	      guint mic, guint n_mics)
+{
+  if (n_mics == 1) {
+    return g_strdup_printf("%s_%s_%d.wav", reel_id, spot_id, version);
+  }
+  return g_strdup_printf("%s_%s_%d_m%u.wav",
+			 reel_id, spot_id, version, mic + 1);
+}
+
+/* Names for a take of the spot at path. With several microphones every
+   file gets the same version and a _mK suffix. */
+static gboolean
+create_clip_names(GtkTreeModel *model, GtkTreePath *path, GFile *dir,
+		  WorkingDirIndex *index, GFile **files, guint n_files)
 {
   GtkTreeIter iter;
   GtkTreeIter parent;
-  GFile *file;
   gchar  *spot_id;
   gchar  *reel_id;
   guint version = 1;
-  if (!gtk_tree_model_get_iter(model, &iter, path)) return NULL;
+  guint m;
+  if (!gtk_tree_model_get_iter(model, &iter, path)) return FALSE;
   gtk_tree_model_get(model, &iter,
 		     SUBTITLE_STORE_COLUMN_ID, &spot_id,
 		     -1);
@@ -752,18 +979,54 @@ create_clip_name(GtkTreeModel *model, GtkTreePath *path, GFile *dir)
   gtk_tree_model_get(model, &iter,
 		     SUBTITLE_STORE_COLUMN_ID, &reel_id,
 		     -1);
-  while(TRUE) {
-    gchar *filename;
-    filename = g_strdup_printf("%s_%s_%d.wav",
-			       reel_id,spot_id, version);
-    file = g_file_resolve_relative_path (dir, filename);
-    g_free(filename);
-    if (!g_file_query_exists(file, NULL)) break;
-    g_object_unref(file);
-    version++;
+  if (index && working_dir_index_is_ready(index)) {
+    version = working_dir_index_next_version(index, reel_id, spot_id);
+    for (m = 0; m < n_files; m++) {
+      gchar *filename = clip_filename(reel_id, spot_id, version, m, n_files);
+      files[m] = g_file_resolve_relative_path (dir, filename);
+      working_dir_index_add_name(index, filename);
+      g_free(filename);
+    }
+  } else {
+    /* Still reading the directory, probe for a free version. Names
+       handed out earlier may not be written yet, so they are looked
+       up in the index too. */
+    while(TRUE) {
+      gboolean taken = FALSE;
+      for (m = 0; m < n_files; m++) {
+	gchar *filename = clip_filename(reel_id, spot_id, version, m, n_files);
+	files[m] = g_file_resolve_relative_path (dir, filename);
+	if ((index && working_dir_index_lookup(index, filename))
+	    || g_file_query_exists(files[m], NULL)) {
+	  taken = TRUE;
+	}
+	g_free(filename);
+      }
+      if (!taken) break;
+      for (m = 0; m < n_files; m++) {
+	g_object_unref(files[m]);
+      }
+      version++;
+    }
+    if (index) {
+      for (m = 0; m < n_files; m++) {
+	gchar *filename = g_file_get_basename(files[m]);
+	working_dir_index_add_name(index, filename);
+	g_free(filename);
+      }
+    }
   }
   g_free(spot_id);
   g_free(reel_id);
+  return TRUE;
+}
+
+static GFile *
+create_clip_name(GtkTreeModel *model, GtkTreePath *path, GFile *dir,
+		 WorkingDirIndex *index)
+{
+  GFile *file;
+  if (!create_clip_names(model, path, dir, index, &file, 1)) return NULL;
   return file;
 }
 
@@ -785,7 +1048,8 @@ activate_record(GSimpleAction *action,
       || gtk_tree_path_get_depth(inst->active_subtitle) < 2) return;
   
   file = create_clip_name(GTK_TREE_MODEL(inst->subtitle_store),
-			  inst->active_subtitle, inst->working_directory);
+			  inst->active_subtitle, inst->working_directory,
+			  inst->dir_index);
   if (!file) return;
   if (!clip_recorder_record(inst->recorder, file, &error)) {
     show_error(inst, "Failed to start recording", &error);
@@ -796,6 +1060,227 @@ activate_record(GSimpleAction *action,
   gtk_widget_set_state_flags(GTK_WIDGET(inst->subtitle_text_view),
 			     GTK_STATE_FLAG_ACTIVE, TRUE);
 }
+
+static void
+activate_record_session(GSimpleAction *action,
+			GVariant      *parameter,
+			gpointer user_data)
+{
+  InstanceContext *inst = user_data;
+  GError *error = NULL;
+  if (!inst->working_directory) {
+    show_error_msg(inst, "No working directory set",
+		   "Select a directory using the menu before recording");
+    return;
+  }
+  if (!inst->active_subtitle
+      || gtk_tree_path_get_depth(inst->active_subtitle) < 2) return;
+  if (!clip_recorder_record_session(inst->recorder, &error)) {
+    show_error(inst, "Failed to start recording", &error);
+    g_clear_error(&error);
+    return;
+  }
+  inst->normal_level =  g_settings_get_double(inst->app_ctxt->settings, PREF_NORMAL_LEVEL);
+  inst->recording_session = TRUE;
+  inst->session_spots_used = FALSE;
+  gtk_widget_set_state_flags(GTK_WIDGET(inst->subtitle_text_view),
+			     GTK_STATE_FLAG_ACTIVE, TRUE);
+}
+
+/* The take is written in the background, so keep what's needed to
+   attach it afterwards */
+typedef struct
+{
+  InstanceContext *inst; /* NULL once the window is gone */
+  GtkWidget *main_win;
+  SubtitleStore *store;
+  ClipRecorder *recorder;
+  WorkingDirIndex *dir_index;
+  GtkTreeRowReference *row;
+  GFile *file;
+} FitTakeCtxt;
+
+static void
+fit_take_window_destroyed(GtkWidget *widget, FitTakeCtxt *ctxt)
+{
+  ctxt->inst = NULL;
+}
+
+static void
+fit_take_done(GstClockTime length, const GError *error, gpointer user_data)
+{
+  FitTakeCtxt *ctxt = user_data;
+  GtkTreePath *path;
+  GtkTreeIter iter;
+  if (error) {
+    /* The name was reserved for a file that won't be there */
+    if (ctxt->dir_index) {
+      gchar *name = g_file_get_basename(ctxt->file);
+      working_dir_index_remove_name(ctxt->dir_index, name);
+      g_free(name);
+    }
+    if (ctxt->inst) {
+      show_error_msg(ctxt->inst, "Failed to fit take", error->message);
+    } else {
+      g_warning("Failed to fit take: %s", error->message);
+    }
+    goto done;
+  }
+  path = gtk_tree_row_reference_get_path(ctxt->row);
+  if (path) {
+    if (gtk_tree_model_get_iter(GTK_TREE_MODEL(ctxt->store), &iter, path)) {
+      gchar *name = g_file_get_basename(ctxt->file);
+      subtitle_store_prepend_file(ctxt->store, &iter, name, length);
+      g_free(name);
+    }
+    gtk_tree_path_free(path);
+  }
+  /* Preview it unless something else was started meanwhile */
+  if (!clip_recorder_is_active(ctxt->recorder)) {
+    GError *err = NULL;
+    if (!clip_recorder_play(ctxt->recorder, ctxt->file, &err)) {
+      if (ctxt->inst) {
+	show_error(ctxt->inst, "Failed to play fitted take", &err);
+      } else {
+	g_warning("Failed to play fitted take: %s", err->message);
+      }
+      g_clear_error(&err);
+    }
+  }
+ done:
+  g_signal_handlers_disconnect_by_func(ctxt->main_win,
+				       fit_take_window_destroyed, ctxt);
+  g_object_unref(ctxt->main_win);
+  g_object_unref(ctxt->store);
+  g_object_unref(ctxt->recorder);
+  if (ctxt->dir_index) g_object_unref(ctxt->dir_index);
+  gtk_tree_row_reference_free(ctxt->row);
+  g_object_unref(ctxt->file);
+  g_free(ctxt);
+}
+
+/* Shorten the active take to the length of the spot and add it as an
+   alternate take */
+static void
+activate_fit_take(GSimpleAction *action,
+		  GVariant      *parameter,
+		  gpointer user_data)
+{
+  InstanceContext *inst = user_data;
+  GtkTreeModel *model = GTK_TREE_MODEL(inst->subtitle_store);
+  GtkTreeIter iter;
+  const gchar *filename;
+  gint64 in;
+  gint64 out;
+  gint64 duration;
+  GFile *src;
+  FitTakeCtxt *ctxt;
+  if (!inst->working_directory) {
+    show_error_msg(inst, "No working directory set",
+		   "Select a directory using the menu");
+    return;
+  }
+  if (!inst->active_subtitle
+      || gtk_tree_path_get_depth(inst->active_subtitle) < 2) return;
+  if (!gtk_tree_model_get_iter(model, &iter, inst->active_subtitle)) return;
+  filename = subtitle_store_get_filename(inst->subtitle_store, &iter);
+  if (!filename) return;
+  duration = subtitle_store_get_file_duration(inst->subtitle_store, &iter);
+  gtk_tree_model_get(model, &iter,
+		     SUBTITLE_STORE_COLUMN_IN, &in,
+		     SUBTITLE_STORE_COLUMN_OUT, &out, -1);
+  if (duration <= out - in) {
+    show_error_msg(inst, "The take already fits",
+		   "The take is not longer than the spot");
+    return;
+  }
+  if (out - in < duration * TIME_COMPRESS_MIN_RATIO) {
+    gchar *msg = g_strdup_printf("A take can be shortened by at most %.0f%%",
+				 100.0 * (1.0 - TIME_COMPRESS_MIN_RATIO));
+    show_error_msg(inst, "The take is too long to fit", msg);
+    g_free(msg);
+    return;
+  }
+  ctxt = g_new(FitTakeCtxt, 1);
+  ctxt->file = create_clip_name(model, inst->active_subtitle,
+				inst->working_directory, inst->dir_index);
+  if (!ctxt->file) {
+    g_free(ctxt);
+    return;
+  }
+  ctxt->inst = inst;
+  ctxt->main_win = g_object_ref(inst->main_win);
+  g_signal_connect(ctxt->main_win, "destroy",
+		   G_CALLBACK(fit_take_window_destroyed), ctxt);
+  ctxt->store = g_object_ref(inst->subtitle_store);
+  ctxt->recorder = g_object_ref(inst->recorder);
+  ctxt->dir_index = inst->dir_index ? g_object_ref(inst->dir_index) : NULL;
+  ctxt->row = gtk_tree_row_reference_new(model, inst->active_subtitle);
+  src = g_file_get_child(inst->working_directory, filename);
+  time_compress_file(src, ctxt->file, out - in, fit_take_done, ctxt);
+  g_object_unref(src);
+}
+
+static void
+clear_mic_files(InstanceContext *inst)
+{
+  guint m;
+  for (m = 0; m < inst->n_mic_files; m++) {
+    g_clear_object(&inst->mic_files[m]);
+  }
+  inst->n_mic_files = 0;
+}
+
+/* Record one file for each group of input channels set in the
+   preferences */
+static void
+activate_record_multi(GSimpleAction *action,
+		      GVariant      *parameter,
+		      gpointer user_data)
+{
+  InstanceContext *inst = user_data;
+  GError *error = NULL;
+  GVariant *groups;
+  const guint32 *group_channels;
+  gsize n_groups;
+  if (!inst->working_directory) {
+    show_error_msg(inst, "No working directory set",
+		   "Select a directory using the menu before recording");
+    return;
+  }
+  if (!inst->active_subtitle
+      || gtk_tree_path_get_depth(inst->active_subtitle) < 2) return;
+  groups = g_settings_get_value(inst->app_ctxt->settings, PREF_MIC_GROUPS);
+  group_channels = g_variant_get_fixed_array(groups, &n_groups,
+					     sizeof(guint32));
+  if (n_groups == 0 || n_groups > CLIP_RECORDER_MAX_GROUPS) {
+    show_error_msg(inst, "Invalid microphone groups",
+		   "Set between one and eight microphone groups");
+    g_variant_unref(groups);
+    return;
+  }
+  clear_mic_files(inst);
+  if (!create_clip_names(GTK_TREE_MODEL(inst->subtitle_store),
+			 inst->active_subtitle, inst->working_directory,
+			 inst->dir_index, inst->mic_files, n_groups)) {
+    g_variant_unref(groups);
+    return;
+  }
+  inst->n_mic_files = n_groups;
+  if (!clip_recorder_record_multi(inst->recorder, inst->mic_files,
+				  group_channels, n_groups, &error)) {
+    show_error(inst, "Failed to start recording", &error);
+    g_clear_error(&error);
+    clear_mic_files(inst);
+    g_variant_unref(groups);
+    return;
+  }
+  g_variant_unref(groups);
+  inst->normal_level =  g_settings_get_double(inst->app_ctxt->settings, PREF_NORMAL_LEVEL);
+  gtk_widget_set_state_flags(GTK_WIDGET(inst->subtitle_text_view),
+			     GTK_STATE_FLAG_ACTIVE, TRUE);
+}
+
 static void
 action_group_set_enable(GActionGroup *group, gboolean enable)
 {
@@ -814,12 +1299,101 @@ action_group_set_enable(GActionGroup *group, gboolean enable)
   g_strfreev (names);
 }
 
+static gboolean
+record_timeout (gpointer user_data) {
+  InstanceContext *inst = user_data;
+  inst->record_timer = 0;
+  gtk_widget_set_sensitive(GTK_WIDGET(inst->subtitle_text_view), FALSE);
+  return FALSE;
+}
+
+static void
+set_lamp(GtkImage *lamp, gboolean on)
+{
+  if (on) {
+    gtk_widget_set_state_flags(GTK_WIDGET(lamp),
+			       GTK_STATE_FLAG_PRELIGHT, FALSE);
+  } else {
+    gtk_widget_unset_state_flags(GTK_WIDGET(lamp),
+				 GTK_STATE_FLAG_PRELIGHT);
+  }
+}
+
+static void
+update_lamps(InstanceContext *inst, gdouble power, gdouble true_peak)
+{
+  gdouble trim_level = clip_recorder_get_trim_level(inst->recorder);
+  if (power > trim_level) {
+    if (inst->record_timer == 0) {
+      if (inst->active_subtitle) {
+	GtkTreeIter iter;
+	if (gtk_tree_model_get_iter(GTK_TREE_MODEL(inst->subtitle_store),
+				    &iter, inst->active_subtitle)) {
+	  gint64 in;
+	  gint64 out;
+	  gtk_tree_model_get(GTK_TREE_MODEL(inst->subtitle_store), &iter,
+			     SUBTITLE_STORE_COLUMN_IN, &in,
+			     SUBTITLE_STORE_COLUMN_OUT, &out, -1);
+	  inst->record_timer = g_timeout_add((out - in)/1000000,
+					    record_timeout, inst);
+	}
+      }
+    }
+    
+  }
+  set_lamp(inst->green_lamp, power > trim_level);
+  set_lamp(inst->yellow_lamp, power > inst->normal_level);
+  set_lamp(inst->red_lamp, (power > DEFAULT_TOP_LEVEL
+			    || true_peak * true_peak > DEFAULT_PEAK_LEVEL));
+}
+
+/* Called once per frame while recording. Drains the recorder's meter
+   ring and shows the loudest value since the last frame. */
+static gboolean
+meter_tick_cb(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data)
+{
+  InstanceContext *inst = user_data;
+  MeterValue values[METER_RING_SIZE];
+  guint n;
+  guint i;
+  gdouble power = 0.0;
+  gdouble true_peak = 0.0;
+  n = clip_recorder_read_meter(inst->recorder, values, METER_RING_SIZE);
+  if (n == 0) return TRUE;
+  for (i = 0; i < n; i++) {
+    if (values[i].power > power) power = values[i].power;
+    if (values[i].true_peak > true_peak) true_peak = values[i].true_peak;
+  }
+  update_lamps(inst, power, true_peak);
+  return TRUE;
+}
+
+static void
+start_metering(InstanceContext *inst)
+{
+  if (inst->meter_tick == 0) {
+    inst->meter_tick = gtk_widget_add_tick_callback(inst->main_win,
+						    meter_tick_cb, inst, NULL);
+  }
+}
+
+static void
+stop_metering(InstanceContext *inst)
+{
+  if (inst->meter_tick != 0) {
+    gtk_widget_remove_tick_callback(inst->main_win, inst->meter_tick);
+    inst->meter_tick = 0;
+    update_lamps(inst, 0.0, 0.0);
+  }
+}
+
 static void
 recording_cb(ClipRecorder *recorder, InstanceContext *inst)
 {
   action_group_set_enable(inst->instance_actions, FALSE);
   action_group_set_enable(inst->subtitle_actions, FALSE);
   action_group_set_enable(inst->record_actions, TRUE);
+  start_metering(inst);
   g_debug("Recording");
 }
 
@@ -836,6 +1410,7 @@ playing_cb(ClipRecorder *recorder, InstanceContext *inst)
 static void
 stopped_cb(ClipRecorder *recorder, InstanceContext *inst)
 {
+  stop_metering(inst);
   if (inst->recorded_file && inst->active_subtitle) {
     GtkTreeIter iter;
     gchar *name = g_file_get_basename(inst->recorded_file);
@@ -845,78 +1420,140 @@ stopped_cb(ClipRecorder *recorder, InstanceContext *inst)
     }
     g_free(name);
   }
+  /* Mic 1 is prepended last so it becomes the active file */
+  if (inst->n_mic_files > 0 && inst->active_subtitle) {
+    GtkTreeIter iter;
+    if (gtk_tree_model_get_iter(GTK_TREE_MODEL(inst->subtitle_store), &iter,
+				inst->active_subtitle)) {
+      guint m = inst->n_mic_files;
+      while (m-- > 1) {
+	gchar *name = g_file_get_basename(inst->mic_files[m]);
+	subtitle_store_prepend_file(inst->subtitle_store, &iter, name,
+				    clip_recorder_group_length(inst->recorder,
+							       m));
+	g_free(name);
+      }
+      {
+	gchar *name = g_file_get_basename(inst->mic_files[0]);
+	subtitle_store_set_file(inst->subtitle_store, &iter, name,
+				clip_recorder_group_length(inst->recorder, 0));
+	g_free(name);
+      }
+    }
+  }
+  clear_mic_files(inst);
   g_clear_object(&inst->recorded_file);
   action_group_set_enable(inst->instance_actions, TRUE);
   action_group_set_enable(inst->subtitle_actions, TRUE);
   action_group_set_enable(inst->record_actions, FALSE);
-  select_next_subtitle(inst);
+  /* A session advances for each segment */
+  if (inst->recording_session) {
+    inst->recording_session = FALSE;
+  } else {
+    select_next_subtitle(inst);
+  }
 
   g_debug("Stopped");
 }
 
+/* Give the segment a clip name for the active spot and move on to the
+   next one. The row is remembered since the file is written later.
+   After the last spot the session is stopped and any further segments
+   are dropped, rather than recorded over the last spot again. */
 static void
-run_error_cb(ClipRecorder *recorder, GError *err, InstanceContext *inst)
+segment_detected_cb(ClipRecorder *recorder, ClipRecorderSegment *segment,
+		    InstanceContext *inst)
 {
-  g_clear_object(&inst->recorded_file);
-  action_group_set_enable(inst->instance_actions, TRUE);
-  action_group_set_enable(inst->subtitle_actions, TRUE);
-  action_group_set_enable(inst->record_actions, FALSE);
-  show_error_msg(inst, "Audio pipeline error", err->message);
+  GtkTreeModel *model = GTK_TREE_MODEL(inst->subtitle_store);
+  if (inst->session_spots_used) return;
+  if (!inst->active_subtitle
+      || gtk_tree_path_get_depth(inst->active_subtitle) < 2) return;
+  segment->file = create_clip_name(model, inst->active_subtitle,
+				   inst->working_directory, inst->dir_index);
+  if (!segment->file) return;
+  segment->user_data = gtk_tree_row_reference_new(model,
+						  inst->active_subtitle);
+  segment->user_data_free = (GDestroyNotify)gtk_tree_row_reference_free;
+  if (inst->record_timer) {
+    g_source_remove(inst->record_timer);
+    inst->record_timer = 0;
+  }
+  gtk_widget_set_sensitive(GTK_WIDGET(inst->subtitle_text_view), TRUE);
+  if (!select_next_subtitle(inst)) {
+    inst->session_spots_used = TRUE;
+    activate_stop(NULL, NULL, inst);
+  }
 }
 
-static gboolean
-record_timeout (gpointer user_data) {
-  InstanceContext *inst = user_data;
-  inst->record_timer = 0;
-  gtk_widget_set_sensitive(GTK_WIDGET(inst->subtitle_text_view), FALSE);
-  return FALSE;
+static void
+segment_saved_cb(ClipRecorder *recorder, ClipRecorderSegment *segment,
+		 InstanceContext *inst)
+{
+  GtkTreePath *path;
+  GtkTreeIter iter;
+  if (segment->error) {
+    show_error_msg(inst, "Failed to save recorded segment",
+		   segment->error->message);
+    return;
+  }
+  path = gtk_tree_row_reference_get_path(segment->user_data);
+  if (!path) return; /* The spot was removed */
+  if (gtk_tree_model_get_iter(GTK_TREE_MODEL(inst->subtitle_store), &iter,
+			      path)) {
+    gchar *name = g_file_get_basename(segment->file);
+    subtitle_store_set_file(inst->subtitle_store, &iter, name,
+			    segment->end - segment->start);
+    g_free(name);
+  }
+  gtk_tree_path_free(path);
 }
 
 static void
-record_power_cb(ClipRecorder *recorder, gdouble power , InstanceContext *inst)
+take_stats_cb(ClipRecorder *recorder, const ClipRecorderTakeStats *stats,
+	      InstanceContext *inst)
+{
+  g_debug("Take ready %.1fms after stop (record %.1fms, write %.1fms,"
+	  " adjust %.1fms, stopped handlers %.1fms)",
+	  (stats->ready - stats->stop_requested) * 1e-3,
+	  (stats->record_stopped - stats->stop_requested) * 1e-3,
+	  (stats->adjust_started - stats->record_stopped) * 1e-3,
+	  (stats->stopped - stats->adjust_started) * 1e-3,
+	  (stats->ready - stats->stopped) * 1e-3);
+  g_debug("Take writer: %u overruns, %lu bytes queued at most;"
+	  " %u capture dropouts",
+	  stats->writer_overruns, (gulong)stats->writer_high_water,
+	  stats->dropouts);
+}
+
+static void
+dropouts_cb(ClipRecorder *recorder, const GArray *dropouts,
+	    InstanceContext *inst)
 {
-  /* g_debug("record_power_cb: %lf, %f, %f, %f", power, DEFAULT_SILENCE_LEVEL, DEFAULT_NORMAL_LEVEL, DEFAULT_TOP_LEVEL); */
-  if (power > clip_recorder_get_trim_level(recorder)) {
-    if (inst->record_timer == 0) {
-      if (inst->active_subtitle) {
-	GtkTreeIter iter;
-	if (gtk_tree_model_get_iter(GTK_TREE_MODEL(inst->subtitle_store),
-				    &iter, inst->active_subtitle)) {
-	  gint64 in;
-	  gint64 out;
-	  gtk_tree_model_get(GTK_TREE_MODEL(inst->subtitle_store), &iter,
-			     SUBTITLE_STORE_COLUMN_IN, &in,
-			     SUBTITLE_STORE_COLUMN_OUT, &out, -1);
-	  inst->record_timer = g_timeout_add((out - in)/1000000,
-					    record_timeout, inst);
-	}
-      }
+  guint i;
+  g_warning("%u dropouts while recording", dropouts->len);
+  for (i = 0; i < dropouts->len; i++) {
+    const ClipRecorderDropout *d =
+      &g_array_index(dropouts, ClipRecorderDropout, i);
+    if (GST_CLOCK_TIME_IS_VALID(d->position)) {
+      g_message("Dropout at %.3fs, %.1fms missing",
+		d->position * 1e-9, d->length * 1e-6);
     }
-    
-  }
-  if (power > clip_recorder_get_trim_level(recorder)) {
-    gtk_widget_set_state_flags(GTK_WIDGET(inst->green_lamp),
-			       GTK_STATE_FLAG_PRELIGHT, FALSE);
-  } else {
-    gtk_widget_unset_state_flags(GTK_WIDGET(inst->green_lamp),
-				 GTK_STATE_FLAG_PRELIGHT);
-  }
-  if (power > inst->normal_level) {
-    gtk_widget_set_state_flags(GTK_WIDGET(inst->yellow_lamp),
-			       GTK_STATE_FLAG_PRELIGHT, FALSE);
-  } else {
-    gtk_widget_unset_state_flags(GTK_WIDGET(inst->yellow_lamp),
-				 GTK_STATE_FLAG_PRELIGHT);
-  }
-  if (power > DEFAULT_TOP_LEVEL) {
-    gtk_widget_set_state_flags(GTK_WIDGET(inst->red_lamp),
-			       GTK_STATE_FLAG_PRELIGHT, FALSE);
-  } else {
-    gtk_widget_unset_state_flags(GTK_WIDGET(inst->red_lamp),
-				 GTK_STATE_FLAG_PRELIGHT);
   }
 }
 
+static void
+run_error_cb(ClipRecorder *recorder, GError *err, InstanceContext *inst)
+{
+  stop_metering(inst);
+  g_clear_object(&inst->recorded_file);
+  clear_mic_files(inst);
+  inst->recording_session = FALSE;
+  action_group_set_enable(inst->instance_actions, TRUE);
+  action_group_set_enable(inst->subtitle_actions, TRUE);
+  action_group_set_enable(inst->record_actions, FALSE);
+  show_error_msg(inst, "Audio pipeline error", err->message);
+}
+
 static void
 activate_new_working_directory(GSimpleAction *action,
 			       GVariant      *parameter,
@@ -958,7 +1595,9 @@ activate_expand_all(GSimpleAction *action,
 		     gpointer user_data)
 {
   InstanceContext *inst = user_data;
+  trace_begin("list", "expand-all");
   gtk_tree_view_expand_all(inst->subtitle_list_view);
+  trace_end("list", "expand-all");
 }
 
 static void
@@ -967,7 +1606,136 @@ activate_collapse_all(GSimpleAction *action,
 		     gpointer user_data)
 {
   InstanceContext *inst = user_data;
+  trace_begin("list", "collapse-all");
   gtk_tree_view_collapse_all(inst->subtitle_list_view);
+  trace_end("list", "collapse-all");
+}
+
+static void
+find_invalidate(InstanceContext *inst)
+{
+  if (inst->find_results) {
+    g_ptr_array_unref(inst->find_results);
+    inst->find_results = NULL;
+  }
+}
+
+/* Search again if the store has changed, keeping the position */
+static void
+find_update(InstanceContext *inst)
+{
+  if (inst->find_results) return;
+  inst->find_results =
+    subtitle_store_search(inst->subtitle_store,
+			  gtk_entry_get_text(inst->find_entry));
+  if (inst->find_pos >= inst->find_results->len) inst->find_pos = 0;
+}
+
+static void
+find_show_result(InstanceContext *inst)
+{
+  GtkTreeIter iter;
+  GtkTreePath *path;
+  gchar *status;
+  guint n_results = inst->find_results->len;
+  guint pos = inst->find_pos;
+  if (n_results == 0) {
+    gtk_label_set_text(inst->find_status,
+		       (*gtk_entry_get_text(inst->find_entry)
+			? "No matches" : ""));
+    return;
+  }
+  subtitle_store_item_get_iter(inst->subtitle_store,
+			       g_ptr_array_index(inst->find_results, pos),
+			       &iter);
+  path = gtk_tree_model_get_path(GTK_TREE_MODEL(inst->subtitle_store), &iter);
+  gtk_tree_view_expand_to_path(inst->subtitle_list_view, path);
+  gtk_tree_view_set_cursor(inst->subtitle_list_view, path, NULL, FALSE);
+  gtk_tree_path_free(path);
+  status = g_strdup_printf("%u of %u", pos + 1, n_results);
+  gtk_label_set_text(inst->find_status, status);
+  g_free(status);
+}
+
+static void
+find_step(InstanceContext *inst, gint step)
+{
+  guint n_results;
+  find_update(inst);
+  n_results = inst->find_results->len;
+  if (n_results > 0) {
+    inst->find_pos = (inst->find_pos + n_results + step) % n_results;
+  }
+  find_show_result(inst);
+}
+
+static void
+find_entry_changed(GtkEditable *editable, InstanceContext *inst)
+{
+  find_invalidate(inst);
+  inst->find_pos = 0;
+  find_update(inst);
+  find_show_result(inst);
+}
+
+static void
+find_entry_activate(GtkEntry *entry, InstanceContext *inst)
+{
+  find_step(inst, 1);
+}
+
+static void
+find_next_clicked(GtkButton *button, InstanceContext *inst)
+{
+  find_step(inst, 1);
+}
+
+static void
+find_prev_clicked(GtkButton *button, InstanceContext *inst)
+{
+  find_step(inst, -1);
+}
+
+static void
+find_close_clicked(GtkButton *button, InstanceContext *inst)
+{
+  gtk_widget_hide(inst->find_bar);
+  find_invalidate(inst);
+  gtk_widget_grab_focus(GTK_WIDGET(inst->subtitle_list_view));
+}
+
+static gboolean
+find_entry_key_press(GtkWidget *widget, GdkEventKey *event,
+		     InstanceContext *inst)
+{
+  if (event->keyval == GDK_KEY_Escape) {
+    find_close_clicked(NULL, inst);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/* Let the find entry see keys before the window accelerators, so that
+   typing a space doesn't start a recording */
+static gboolean
+main_win_key_press(GtkWidget *widget, GdkEventKey *event,
+		   InstanceContext *inst)
+{
+  if (gtk_window_get_focus(GTK_WINDOW(widget))
+      == GTK_WIDGET(inst->find_entry)) {
+    return gtk_window_propagate_key_event(GTK_WINDOW(widget), event);
+  }
+  return FALSE;
+}
+
+static void
+activate_find(GSimpleAction *action,
+	      GVariant      *parameter,
+	      gpointer user_data)
+{
+  InstanceContext *inst = user_data;
+  gtk_widget_show(inst->find_bar);
+  gtk_widget_grab_focus(GTK_WIDGET(inst->find_entry));
 }
 
 static void
@@ -1014,15 +1782,59 @@ static void file_changed(GtkCellRendererCombo *combo, gchar *path_str,
     gchar *new_text;
     gint64 new_duration;
 
-    gtk_tree_model_get(GTK_TREE_MODEL(inst->subtitle_store), &iter,
-		       SUBTITLE_STORE_COLUMN_FILES, &files, -1);
-    gtk_tree_model_get(files, new_iter,
-		       SUBTITLE_STORE_FILES_COLUMN_FILE, &new_text,
-		       SUBTITLE_STORE_FILES_COLUMN_DURATION, &new_duration,
-		       -1);
-    subtitle_store_set_file(inst->subtitle_store, &iter,
-			    new_text, new_duration);
+    g_object_get(combo, "model", &files, NULL);
+    if (files) {
+      gtk_tree_model_get(files, new_iter,
+			 SUBTITLE_STORE_FILES_COLUMN_FILE, &new_text,
+			 SUBTITLE_STORE_FILES_COLUMN_DURATION, &new_duration,
+			 -1);
+      subtitle_store_set_file(inst->subtitle_store, &iter,
+			      new_text, new_duration);
+      g_free(new_text);
+      g_object_unref(files);
+    }
+  }
+  gtk_tree_path_free(path);
+}
+
+/* The file list model is only built for the spot being edited */
+static void
+file_editing_started(GtkCellRenderer *render, GtkCellEditable *editable,
+		     gchar *path_str, gpointer user_data)
+{
+  InstanceContext *inst = user_data;
+  GtkTreeIter iter;
+  GtkTreeModel *files;
+  const SubtitleStoreFile *file_array;
+  const gchar *active;
+  guint n_files;
+  guint i;
+  GtkTreePath *path = gtk_tree_path_new_from_string(path_str);
+  if (!path) return;
+  if (!GTK_IS_COMBO_BOX(editable)
+      || !gtk_tree_model_get_iter(GTK_TREE_MODEL(inst->subtitle_store),
+				  &iter, path)) {
+    gtk_tree_path_free(path);
+    return;
+  }
+  gtk_tree_path_free(path);
+  files = subtitle_store_get_files_model(inst->subtitle_store, &iter);
+  g_object_set(render, "model", files, NULL);
+  if (!files) return;
+  /* Selecting the current file is not a change */
+  g_signal_handlers_block_by_func(render, file_changed, inst);
+  gtk_combo_box_set_model(GTK_COMBO_BOX(editable), files);
+  file_array = subtitle_store_get_files(inst->subtitle_store, &iter,
+					&n_files);
+  active = subtitle_store_get_filename(inst->subtitle_store, &iter);
+  for (i = 0; i < n_files; i++) {
+    if (file_array[i].name == active) {
+      gtk_combo_box_set_active(GTK_COMBO_BOX(editable), i);
+      break;
+    }
   }
+  g_signal_handlers_unblock_by_func(render, file_changed, inst);
+  g_object_unref(files);
 }
 
 static gboolean
@@ -1030,22 +1842,72 @@ search_equal(GtkTreeModel *model, gint column, const gchar *key,
 	     GtkTreeIter *iter, gpointer search_data)
 {
   if (column == SUBTITLE_STORE_COLUMN_TEXT) {
-    gchar *text;
-    gchar *found;
-    gchar *case_key;
-    gchar *case_text;
-    gtk_tree_model_get(model, iter, SUBTITLE_STORE_COLUMN_TEXT, &text, -1);
-    case_text = g_utf8_casefold(text, -1);
-    g_free(text);
-    case_key = g_utf8_casefold(key, -1);
-    found = strstr(case_text, case_key);
-    g_free(case_key);
-    g_free(case_text);
-    return !found;
+    return !subtitle_store_search_match(SUBTITLE_STORE(model), iter, key);
   }
   return TRUE;
 }
 
+#define COMPACT_COLUMN_WIDTH 100
+
+/* With fixed height rows the tree view doesn't have to measure the text
+   of every row, so expanding and scrolling long lists is fast. Only
+   the first line of the text is shown, the full text is in the text
+   view below the list. */
+static void
+set_compact_list(InstanceContext *inst, gboolean compact)
+{
+  GList *columns;
+  GList *c;
+  GtkTreeView *view = inst->subtitle_list_view;
+  /* All columns must be fixed while in fixed height mode */
+  if (!compact) gtk_tree_view_set_fixed_height_mode(view, FALSE);
+  gtk_tree_view_column_set_attributes(inst->text_column, inst->text_render,
+				      "text",
+				      (compact
+				       ? SUBTITLE_STORE_COLUMN_FIRST_LINE
+				       : SUBTITLE_STORE_COLUMN_TEXT),
+				      NULL);
+  g_object_set(inst->text_render, "ellipsize",
+	       compact ? PANGO_ELLIPSIZE_END : PANGO_ELLIPSIZE_NONE, NULL);
+  gtk_tree_view_column_set_expand(inst->text_column, compact);
+  columns = gtk_tree_view_get_columns(view);
+  for (c = columns; c; c = c->next) {
+    GtkTreeViewColumn *column = c->data;
+    if (compact) {
+      gint width = gtk_tree_view_column_get_width(column);
+      gtk_tree_view_column_set_fixed_width(column,
+					   (width > 0
+					    ? width : COMPACT_COLUMN_WIDTH));
+      gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+    } else {
+      gtk_tree_view_column_set_sizing(column,
+				      GTK_TREE_VIEW_COLUMN_GROW_ONLY);
+    }
+  }
+  g_list_free(columns);
+  if (compact) gtk_tree_view_set_fixed_height_mode(view, TRUE);
+}
+
+static void
+compact_list_changed(GSettings *settings, gchar *key, InstanceContext *inst)
+{
+  set_compact_list(inst, g_settings_get_boolean(settings, key));
+}
+
+static gboolean
+list_draw_begin(GtkWidget *widget, cairo_t *cr, gpointer user_data)
+{
+  trace_begin("list", "draw");
+  return FALSE;
+}
+
+static gboolean
+list_draw_end(GtkWidget *widget, cairo_t *cr, gpointer user_data)
+{
+  trace_end("list", "draw");
+  return FALSE;
+}
+
 static gboolean
 setup_subtitle_list(InstanceContext *inst,   GtkBuilder *builder,
 		    GError **err)
@@ -1084,6 +1946,8 @@ setup_subtitle_list(InstanceContext *inst,   GtkBuilder *builder,
 					     NULL);
   gtk_tree_view_column_set_resizable (column, TRUE);
   gtk_tree_view_append_column(viewer, column);
+  inst->text_column = column;
+  inst->text_render = render;
 
   /* File column */
   render = gtk_cell_renderer_combo_new();
@@ -1094,11 +1958,11 @@ setup_subtitle_list(InstanceContext *inst,   GtkBuilder *builder,
 	       "editable", TRUE,
 	       NULL);
   g_signal_connect(render, "changed", (GCallback)file_changed, inst);
+  g_signal_connect(render, "editing-started",
+		   (GCallback)file_editing_started, inst);
   column =
     gtk_tree_view_column_new_with_attributes("Audio file", render,
 					     "text", SUBTITLE_STORE_COLUMN_FILE,
-					     "model",
-					     SUBTITLE_STORE_COLUMN_FILES,
 					     NULL);
   gtk_tree_view_column_set_resizable (column, TRUE);
   gtk_tree_view_append_column(viewer, column);
@@ -1117,6 +1981,9 @@ setup_subtitle_list(InstanceContext *inst,   GtkBuilder *builder,
   
   gtk_tree_view_set_search_column(viewer, SUBTITLE_STORE_COLUMN_TEXT);
   gtk_tree_view_set_search_equal_func(viewer, search_equal, NULL, NULL);
+
+  g_signal_connect(viewer, "draw", (GCallback)list_draw_begin, NULL);
+  g_signal_connect_after(viewer, "draw", (GCallback)list_draw_end, NULL);
   
   return TRUE;
 }
@@ -1133,8 +2000,11 @@ setup_actions(InstanceContext *inst, GError **err)
     { "save", activate_save, NULL},
     { "close", activate_close, NULL},
     { "import-assetmap", activate_import_assetmap, NULL},
+    { "recover-files", activate_recover_files, NULL},
+    { "clean-files", activate_clean_files, "s"},
     { "expand-all", activate_expand_all, NULL},
     { "collapse-all", activate_collapse_all, NULL},
+    { "find", activate_find, NULL},
     { "about", activate_about, NULL},
     
   };
@@ -1142,6 +2012,9 @@ setup_actions(InstanceContext *inst, GError **err)
   const GActionEntry subtitle_actions[] = {
     { "play", activate_play, NULL},
     { "record", activate_record, NULL},
+    { "record-session", activate_record_session, NULL},
+    { "record-multi", activate_record_multi, NULL},
+    { "fit-take", activate_fit_take, NULL},
   };
   
   const GActionEntry record_actions[] = {
@@ -1156,6 +2029,13 @@ setup_actions(InstanceContext *inst, GError **err)
   inst->instance_actions = G_ACTION_GROUP (inst->main_win);
   g_object_ref(inst->instance_actions);
 
+  {
+    GAction *compact = g_settings_create_action(inst->app_ctxt->settings,
+						PREF_COMPACT_LIST);
+    g_action_map_add_action(G_ACTION_MAP(inst->main_win), compact);
+    g_object_unref(compact);
+  }
+
   inst->subtitle_actions = G_ACTION_GROUP(g_simple_action_group_new ());
   g_action_map_add_action_entries (G_ACTION_MAP(inst->subtitle_actions),
 				   subtitle_actions,
@@ -1219,6 +2099,10 @@ create_main_window(InstanceContext *inst, GtkApplication *application,
   
   inst->subtitle_list_view = GTK_TREE_VIEW(FIND_OBJECT("subtitle_list"));
   g_assert(inst->subtitle_list_view != NULL);
+  set_compact_list(inst, g_settings_get_boolean(inst->app_ctxt->settings,
+						PREF_COMPACT_LIST));
+  g_signal_connect(inst->app_ctxt->settings, "changed::" PREF_COMPACT_LIST,
+		   (GCallback)compact_list_changed, inst);
 
   inst->subtitle_selection =gtk_tree_view_get_selection(inst->subtitle_list_view);
   g_signal_connect(inst->subtitle_selection, "changed",
@@ -1230,6 +2114,33 @@ create_main_window(InstanceContext *inst, GtkApplication *application,
   inst->subtitle_text_view = GTK_TEXT_VIEW(FIND_OBJECT("subtitle_textview"));
   g_assert(inst->subtitle_text_view);
 
+  inst->find_bar = GTK_WIDGET(FIND_OBJECT("find_bar"));
+  g_assert(inst->find_bar);
+  inst->find_entry = GTK_ENTRY(FIND_OBJECT("find_entry"));
+  g_assert(inst->find_entry);
+  inst->find_status = GTK_LABEL(FIND_OBJECT("find_status"));
+  g_assert(inst->find_status);
+  g_signal_connect(inst->find_entry, "changed",
+		   (GCallback)find_entry_changed, inst);
+  g_signal_connect(inst->find_entry, "activate",
+		   (GCallback)find_entry_activate, inst);
+  g_signal_connect(inst->find_entry, "key-press-event",
+		   (GCallback)find_entry_key_press, inst);
+  g_signal_connect(FIND_OBJECT("find_next_button"), "clicked",
+		   (GCallback)find_next_clicked, inst);
+  g_signal_connect(FIND_OBJECT("find_prev_button"), "clicked",
+		   (GCallback)find_prev_clicked, inst);
+  g_signal_connect(FIND_OBJECT("find_close_button"), "clicked",
+		   (GCallback)find_close_clicked, inst);
+  g_signal_connect(inst->main_win, "key-press-event",
+		   (GCallback)main_win_key_press, inst);
+  g_signal_connect_swapped(inst->subtitle_store, "row-changed",
+			   (GCallback)find_invalidate, inst);
+  g_signal_connect_swapped(inst->subtitle_store, "row-inserted",
+			   (GCallback)find_invalidate, inst);
+  g_signal_connect_swapped(inst->subtitle_store, "row-deleted",
+			   (GCallback)find_invalidate, inst);
+
   inst->red_lamp = GTK_IMAGE(FIND_OBJECT("red_lamp"));
   g_assert(inst->red_lamp);
   inst->yellow_lamp = GTK_IMAGE(FIND_OBJECT("yellow_lamp"));
@@ -1281,7 +2192,13 @@ setup_recorder(InstanceContext *inst, GError **error)
   g_signal_connect(inst->recorder, "playing", (GCallback)playing_cb, inst);
   g_signal_connect(inst->recorder, "stopped", (GCallback)stopped_cb, inst);
   g_signal_connect(inst->recorder, "run-error", (GCallback)run_error_cb, inst);
-  g_signal_connect(inst->recorder, "power", (GCallback)record_power_cb, inst);
+  g_signal_connect(inst->recorder, "take-stats", (GCallback)take_stats_cb,
+		   inst);
+  g_signal_connect(inst->recorder, "segment-detected",
+		   (GCallback)segment_detected_cb, inst);
+  g_signal_connect(inst->recorder, "segment-saved",
+		   (GCallback)segment_saved_cb, inst);
+  g_signal_connect(inst->recorder, "dropouts", (GCallback)dropouts_cb, inst);
 
   return TRUE;
 }
@@ -1323,9 +2240,13 @@ print_widget_tree(GtkWidget *widget, guint indent)
 #endif
 
 
+static gchar *trace_filename = NULL;
+
 static GOptionEntry options[] =
   {
-   
+    {"trace", 0, 0, G_OPTION_ARG_FILENAME, &trace_filename,
+     "Write timing of recording and export to FILE as a Chrome trace",
+     "FILE"},
     {NULL}
   };
 
@@ -1344,6 +2265,9 @@ startup(GApplication *application, AppContext *app_ctxt)
   
   g_set_prgname("subrec");
   g_set_application_name("SubRec");
+  if (trace_filename) {
+    trace_log_enable();
+  }
   app_init(app_ctxt);
   app_ctxt->application = GTK_APPLICATION(application);
   app_ctxt->settings = g_settings_new(PREF_SCHEMA);
@@ -1388,6 +2312,15 @@ shutdown(GApplication *application, AppContext *app_ctxt)
 {
   g_debug("Shutdown");
   app_destroy(app_ctxt);
+  if (trace_filename) {
+    GError *err = NULL;
+    GFile *file = g_file_new_for_path(trace_filename);
+    if (!trace_log_write(file, &err)) {
+      g_printerr("Failed to write trace: %s\n", err->message);
+      g_error_free(err);
+    }
+    g_object_unref(file);
+  }
 }
 
 gint
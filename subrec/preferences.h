@@ -3,3 +3,5 @@
 #define PREF_NORMAL_LEVEL "normal-level"
 #define PREF_PRE_SILENCE "pre-silence"
 #define PREF_POST_SILENCE "post-silence"
+#define PREF_COMPACT_LIST "compact-list"
+#define PREF_MIC_GROUPS "mic-groups"
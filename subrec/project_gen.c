@@ -0,0 +1,166 @@
+/* Generator for large synthetic projects.
+
+   Writes a subtitle list of N reels with M spots each into a working
+   directory, so that subrec can be opened on it to time the subtitle
+   list. Every spot gets text of one to --lines lines of varying length
+   and --takes entries in its file list. No audio files are written.
+
+   To compare list performance, run subrec with --trace on the
+   generated directory, expand all reels from the List menu and scroll
+   through the list. The trace has an expand-all span and one draw span
+   per frame. */
+
+#include <subtitle_store.h>
+#include <subtitle_store_io.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SUBTITLE_LIST_FILENAME "SUBTITLES.xml"
+
+#define MSECOND G_GINT64_CONSTANT(1000000)
+
+static gint n_reels = 10;
+static gint n_spots = 500;
+static gint max_lines = 3;
+static gint n_takes = 2;
+static gint seed = 4711;
+
+static GOptionEntry entries[] = {
+  {"reels", 'r', 0, G_OPTION_ARG_INT, &n_reels,
+   "Number of reels", "N"},
+  {"spots", 'n', 0, G_OPTION_ARG_INT, &n_spots,
+   "Number of spots per reel", "M"},
+  {"lines", 'l', 0, G_OPTION_ARG_INT, &max_lines,
+   "Maximum number of text lines per spot", "N"},
+  {"takes", 't', 0, G_OPTION_ARG_INT, &n_takes,
+   "Number of files in the list of each spot", "N"},
+  {"seed", 's', 0, G_OPTION_ARG_INT, &seed,
+   "Random seed for the text and timing", "N"},
+  {NULL}
+};
+
+static const gchar *words[] = {
+  "the", "night", "is", "long", "and", "we", "have", "nowhere", "to", "go",
+  "listen", "somebody", "knocked", "on", "door", "again", "I", "told",
+  "you", "never", "come", "back", "here", "without", "calling", "first",
+  "where", "were", "yesterday", "morning", "it", "doesn't", "matter", "now"
+};
+
+static gchar *
+random_text(GRand *rand)
+{
+  GString *text = g_string_new("");
+  gint lines = g_rand_int_range(rand, 1, max_lines + 1);
+  gint l;
+  for (l = 0; l < lines; l++) {
+    gint n_words = g_rand_int_range(rand, 2, 9);
+    gint w;
+    if (l > 0) g_string_append_c(text, '\n');
+    for (w = 0; w < n_words; w++) {
+      if (w > 0) g_string_append_c(text, ' ');
+      g_string_append(text,
+		      words[g_rand_int_range(rand, 0, G_N_ELEMENTS(words))]);
+    }
+  }
+  return g_string_free(text, FALSE);
+}
+
+static void
+generate_project(SubtitleStore *store)
+{
+  GRand *rand = g_rand_new_with_seed(seed);
+  const gchar **names = g_new(const gchar *, n_takes);
+  gint64 *durations = g_new(gint64, n_takes);
+  gint64 *times = g_new(gint64, 2 * n_spots);
+  gint64 reel_start = 0;
+  gint r;
+  for (r = 0; r < n_reels; r++) {
+    GtkTreeIter reel_iter;
+    gchar id[16];
+    gint64 pos = 0;
+    gint s;
+    /* Lay out the reel first, it has to be inserted with its length */
+    for (s = 0; s < n_spots; s++) {
+      pos += g_rand_int_range(rand, 200, 4000) * MSECOND;
+      times[2 * s] = pos;
+      pos += g_rand_int_range(rand, 1000, 6000) * MSECOND;
+      times[2 * s + 1] = pos;
+    }
+    pos += 2000 * MSECOND;
+    g_snprintf(id, sizeof(id), "%d", r + 1);
+    subtitle_store_insert(store, reel_start, reel_start + pos, id, 0,
+			  NULL, &reel_iter);
+    for (s = 0; s < n_spots; s++) {
+      GtkTreeIter spot_iter;
+      gint64 length = times[2 * s + 1] - times[2 * s];
+      gchar *text;
+      gint t;
+      g_snprintf(id, sizeof(id), "%d", s + 1);
+      subtitle_store_insert(store, times[2 * s], times[2 * s + 1], id, 0,
+			    &reel_iter, &spot_iter);
+      text = random_text(rand);
+      subtitle_store_set_text(store, &spot_iter, text);
+      g_free(text);
+      for (t = 0; t < n_takes; t++) {
+	names[t] = g_strdup_printf("%d_%d_%d.wav", r + 1, s + 1, t + 1);
+	durations[t] = length + g_rand_int_range(rand, -200, 200) * MSECOND;
+      }
+      subtitle_store_prepend_files(store, &spot_iter, names, durations,
+				   n_takes);
+      for (t = 0; t < n_takes; t++) {
+	g_free((gchar*)names[t]);
+      }
+    }
+    reel_start += pos;
+  }
+  g_free(times);
+  g_free(names);
+  g_free(durations);
+  g_rand_free(rand);
+}
+
+int
+main(int argc, char *argv[])
+{
+  GOptionContext *context;
+  GError *err = NULL;
+  SubtitleStore *store;
+  GFile *file;
+  gchar *path;
+
+  context = g_option_context_new("DIRECTORY - generate a large project");
+  g_option_context_add_main_entries(context, entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("%s\n", err->message);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+  if (argc != 2) {
+    g_printerr("Need exactly one working directory\n");
+    return EXIT_FAILURE;
+  }
+  if (n_reels < 1 || n_spots < 1 || max_lines < 1 || n_takes < 0) {
+    g_printerr("Need at least one reel, spot and line\n");
+    return EXIT_FAILURE;
+  }
+  if (g_mkdir_with_parents(argv[1], 0777) != 0) {
+    g_printerr("Failed to create %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  store = subtitle_store_new();
+  generate_project(store);
+  path = g_build_filename(argv[1], SUBTITLE_LIST_FILENAME, NULL);
+  file = g_file_new_for_path(path);
+  if (!subtitle_store_io_save(store, file, &err)) {
+    g_printerr("Failed to save %s: %s\n", path, err->message);
+    return EXIT_FAILURE;
+  }
+  g_print("%d reels, %d spots per reel written to %s\n",
+	  n_reels, n_spots, path);
+  g_object_unref(file);
+  g_free(path);
+  g_object_unref(store);
+  return EXIT_SUCCESS;
+}
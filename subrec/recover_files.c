@@ -0,0 +1,221 @@
+#include <recover_files.h>
+#include <wav_file.h>
+#include <string.h>
+
+typedef struct
+{
+  gchar *name;
+  guint version;
+  guint mic;
+  gchar *spot; /* "reel_spot" */
+  guint spot_index; /* Order of the spot in the store */
+  GstClockTime duration;
+  gboolean valid;
+} RecoverItem;
+
+typedef struct
+{
+  SubtitleStore *store;
+  GFile *directory;
+  GArray *items;
+  volatile gint remaining;
+  GThreadPool *pool;
+  RecoverFilesDone done;
+  gpointer user_data;
+} RecoverJob;
+
+typedef struct
+{
+  GtkTreeIter iter;
+  guint index;
+} SpotRef;
+
+typedef struct
+{
+  SubtitleStore *store;
+  GHashTable *spots; /* "reel_spot" -> SpotRef */
+  GArray *items;
+} CollectCtxt;
+
+static void
+add_spots(SubtitleStore *store, GHashTable *spots, GtkTreeIter *parent,
+	  const gchar *reel_id)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL(store);
+  GtkTreeIter iter;
+  if (!gtk_tree_model_iter_children(model, &iter, parent)) return;
+  do {
+    gchar *id;
+    gtk_tree_model_get(model, &iter, SUBTITLE_STORE_COLUMN_ID, &id, -1);
+    if (reel_id) {
+      SpotRef *ref = g_new(SpotRef, 1);
+      ref->iter = iter;
+      ref->index = g_hash_table_size(spots);
+      g_hash_table_insert(spots, g_strconcat(reel_id, "_", id, NULL), ref);
+      add_spots(store, spots, &iter, reel_id);
+    } else {
+      add_spots(store, spots, &iter, id);
+    }
+    g_free(id);
+  } while(gtk_tree_model_iter_next(model, &iter));
+}
+
+static void
+collect_file(const WorkingDirIndexEntry *entry, gpointer user_data)
+{
+  CollectCtxt *ctxt = user_data;
+  SpotRef *ref;
+  gchar *key;
+  RecoverItem item;
+  if (entry->raw) return;
+  key = g_strconcat(entry->reel, "_", entry->spot, NULL);
+  ref = g_hash_table_lookup(ctxt->spots, key);
+  if (!ref || subtitle_store_has_file(ctxt->store, &ref->iter, entry->name)) {
+    g_free(key);
+    return;
+  }
+  item.name = g_strdup(entry->name);
+  item.version = entry->version;
+  item.mic = entry->mic;
+  item.spot = key;
+  item.spot_index = ref->index;
+  item.duration = 0;
+  item.valid = FALSE;
+  g_array_append_val(ctxt->items, item);
+}
+
+/* By spot, then oldest version first, so the newest ends up first in
+   the file list. The microphones of a multi-mic take end up in order. */
+static gint
+compare_items(gconstpointer a, gconstpointer b)
+{
+  const RecoverItem *ia = a;
+  const RecoverItem *ib = b;
+  if (ia->spot_index != ib->spot_index) {
+    return ia->spot_index < ib->spot_index ? -1 : 1;
+  }
+  if (ia->version != ib->version) return ia->version < ib->version ? -1 : 1;
+  if (ia->mic != ib->mic) return ia->mic > ib->mic ? -1 : 1;
+  return 0;
+}
+
+static void
+job_free(RecoverJob *job)
+{
+  guint i;
+  for (i = 0; i < job->items->len; i++) {
+    g_free(g_array_index(job->items, RecoverItem, i).name);
+    g_free(g_array_index(job->items, RecoverItem, i).spot);
+  }
+  g_array_free(job->items, TRUE);
+  g_object_unref(job->store);
+  g_object_unref(job->directory);
+  g_free(job);
+}
+
+static gboolean
+attach_files(gpointer user_data)
+{
+  RecoverJob *job = user_data;
+  GPtrArray *names = g_ptr_array_new();
+  GArray *durations = g_array_new(FALSE, FALSE, sizeof(gint64));
+  GHashTable *spots;
+  guint recovered = 0;
+  guint i;
+  if (job->pool) {
+    g_thread_pool_free(job->pool, FALSE, TRUE);
+  }
+  /* The list may have been edited while probing, find the spots again */
+  spots = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  add_spots(job->store, spots, NULL, NULL);
+  g_array_sort(job->items, compare_items);
+  for (i = 0; i < job->items->len; i++) {
+    RecoverItem *item = &g_array_index(job->items, RecoverItem, i);
+    if (item->valid) {
+      gint64 duration = item->duration;
+      g_ptr_array_add(names, item->name);
+      g_array_append_val(durations, duration);
+    }
+    /* Attach when the next item belongs to another spot */
+    if (names->len > 0
+	&& (i + 1 == job->items->len
+	    || (g_array_index(job->items, RecoverItem, i + 1).spot_index
+		!= item->spot_index))) {
+      SpotRef *ref = g_hash_table_lookup(spots, item->spot);
+      if (ref) {
+	recovered +=
+	  subtitle_store_prepend_files(job->store, &ref->iter,
+				       (const gchar * const *)names->pdata,
+				       (const gint64*)durations->data,
+				       names->len);
+      }
+      g_ptr_array_set_size(names, 0);
+      g_array_set_size(durations, 0);
+    }
+  }
+  g_ptr_array_free(names, TRUE);
+  g_array_free(durations, TRUE);
+  g_hash_table_destroy(spots);
+  if (job->done) job->done(recovered, job->user_data);
+  job_free(job);
+  return FALSE;
+}
+
+static void
+probe_file(gpointer data, gpointer user_data)
+{
+  RecoverItem *item = data;
+  RecoverJob *job = user_data;
+  GError *err = NULL;
+  GFile *file = g_file_get_child(job->directory, item->name);
+  item->valid = wav_file_get_duration(file, &item->duration, &err);
+  if (!item->valid) {
+    g_warning("Ignoring %s: %s", item->name, err->message);
+    g_clear_error(&err);
+  }
+  g_object_unref(file);
+  if (g_atomic_int_dec_and_test(&job->remaining)) {
+    g_idle_add(attach_files, job);
+  }
+}
+
+void
+recover_files(SubtitleStore *store, WorkingDirIndex *index,
+	      RecoverFilesDone done, gpointer user_data)
+{
+  RecoverJob *job;
+  CollectCtxt ctxt;
+  guint i;
+  g_return_if_fail(working_dir_index_is_ready(index));
+  job = g_new(RecoverJob, 1);
+  job->store = store;
+  g_object_ref(store);
+  job->directory = index->directory;
+  g_object_ref(job->directory);
+  job->items = g_array_new(FALSE, FALSE, sizeof(RecoverItem));
+  job->pool = NULL;
+  job->done = done;
+  job->user_data = user_data;
+
+  ctxt.store = store;
+  ctxt.items = job->items;
+  ctxt.spots = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  add_spots(store, ctxt.spots, NULL, NULL);
+  working_dir_index_foreach(index, collect_file, &ctxt);
+  g_hash_table_destroy(ctxt.spots);
+  g_debug("Recovering %u files", job->items->len);
+
+  if (job->items->len == 0) {
+    g_idle_add(attach_files, job);
+    return;
+  }
+  job->remaining = job->items->len;
+  /* The items array isn't resized until all probes are done, so the
+     workers can write into it */
+  job->pool = g_thread_pool_new(probe_file, job, g_get_num_processors(),
+				FALSE, NULL);
+  for (i = 0; i < job->items->len; i++) {
+    g_thread_pool_push(job->pool, &g_array_index(job->items, RecoverItem, i),
+		       NULL);
+  }
+}
@@ -0,0 +1,17 @@
+#ifndef __RECOVER_FILES_H__J7WQ1NPE4C__
+#define __RECOVER_FILES_H__J7WQ1NPE4C__
+
+#include <subtitle_store.h>
+#include <working_dir_index.h>
+
+/* Called in the main thread when all files are attached */
+typedef void (*RecoverFilesDone)(guint n_recovered, gpointer user_data);
+
+/* Attach clip files in the working directory that belong to a spot in
+   the store but aren't in its file list. Durations are read from the
+   WAV headers in a pool of worker threads. The index must be ready. */
+void
+recover_files(SubtitleStore *store, WorkingDirIndex *index,
+	      RecoverFilesDone done, gpointer user_data);
+
+#endif /* __RECOVER_FILES_H__J7WQ1NPE4C__ */
@@ -1,7 +1,11 @@
 #include "save_sequence.h"
 #include <time_string.h>
+#include <trace_log.h>
+#include <string.h>
 
 #define SAMPLE_RATE 48000
+/* Longest silence buffer, the gap is sent as one buffer if shorter */
+#define MAX_SILENCE_BUFFER_SAMPLES (10 * SAMPLE_RATE)
 
 GQuark
 save_sequence_error_quark()
@@ -142,39 +146,18 @@ save_sequence_class_init(SaveSequenceClass *g_class)
 
 }
 
-static gboolean
-next_or_up(SaveSequence *sseq)
+/* The first spot with a file at or after item in document order */
+static const SubtitleStoreItem *
+find_valid_subtitle(const SubtitleStoreItem *item)
 {
-  GtkTreeIter iter = sseq->next_pos;
-  while (!gtk_tree_model_iter_next(GTK_TREE_MODEL(sseq->subtitle_store),
-				    &sseq->next_pos)) {
-    if (sseq->depth == 0) return FALSE;
-    if (!gtk_tree_model_iter_parent(GTK_TREE_MODEL(sseq->subtitle_store),
-				    &sseq->next_pos, &iter)) {
-      return FALSE;
-    }
-    sseq->depth--;
-    iter = sseq->next_pos;
-  }
-  return TRUE;
-}
-
-static gboolean
-find_valid_subtitle(SaveSequence *sseq)
-{
-  GtkTreeIter child;
-  while(TRUE) {
-    if (gtk_tree_model_iter_children (GTK_TREE_MODEL(sseq->subtitle_store),
-				      &child, &sseq->next_pos)) {
-      sseq->next_pos = child;
-      sseq->depth++;
-    } else if (subtitle_store_get_filename(sseq->subtitle_store,
-					   &sseq->next_pos)) {
-      return TRUE;
-    } else {
-      if (!next_or_up(sseq)) return FALSE;
+  while(item) {
+    if (!subtitle_store_item_children(item)
+	&& subtitle_store_item_filename(item)) {
+      return item;
     }
+    item = subtitle_store_item_next_preorder(item);
   }
+  return NULL;
 }
 
 static inline guint64
@@ -191,7 +174,11 @@ next_file(SaveSequence *sseq, GError **err)
   GstState pending;
   GstPad *input_src_pad;
   guint64 duration;
-      
+  gint64 switch_start;
+  gint64 switch_time;
+
+  switch_start = g_get_monotonic_time();
+  trace_begin("save-sequence", "switch");
   if (sseq->active_src) {
     gst_element_set_state(sseq->active_src, GST_STATE_PAUSED);
     gst_element_get_state(sseq->active_src, &state, &pending, GST_CLOCK_TIME_NONE);
@@ -205,20 +192,15 @@ next_file(SaveSequence *sseq, GError **err)
       g_set_error(err, SAVE_SEQUENCE_ERROR,
 		  SAVE_SEQUENCE_ERROR_INVALID_SEQUENCE,
 		  "End position less than current position");
+      trace_end("save-sequence", "switch");
       return FALSE;
     }
     sseq->active_src = sseq->silence_src;
     duration = sseq->end_sample- sseq->next_sample;
   } else {
-    GstClockTime in_ns;
-    GstClockTimeDiff duration_ns;
     guint64 in;
-    gtk_tree_model_get(GTK_TREE_MODEL(sseq->subtitle_store), &sseq->next_pos,
-		       SUBTITLE_STORE_COLUMN_GLOBAL_IN, &in_ns,
-		       SUBTITLE_STORE_COLUMN_FILE_DURATION, &duration_ns,
-		       -1);
-    in = ns_to_sample(in_ns);
-    duration = ns_to_sample(duration_ns);
+    in = ns_to_sample(subtitle_store_item_global_in(sseq->next_pos));
+    duration = ns_to_sample(subtitle_store_item_file_duration(sseq->next_pos));
     
     if (in > sseq->next_sample) {
       sseq->active_src = sseq->silence_src;
@@ -227,24 +209,30 @@ next_file(SaveSequence *sseq, GError **err)
       const gchar *filename;
       GFile *file;
       sseq->active_src = sseq->file_src_bin;
-      filename = subtitle_store_get_filename(sseq->subtitle_store,
-					     &sseq->next_pos);
-      
+      filename = subtitle_store_item_filename(sseq->next_pos);
+
       file = g_file_get_child(sseq->working_directory, filename);
       
       
       g_object_set(sseq->file_src, "file", file, NULL);
       g_object_unref(file);
-      sseq->last_pos = !(next_or_up(sseq) && find_valid_subtitle(sseq));
+      sseq->next_pos =
+	find_valid_subtitle(subtitle_store_item_next_preorder(sseq->next_pos));
+      sseq->last_pos = !sseq->next_pos;
     } else {
       g_set_error(err, SAVE_SEQUENCE_ERROR,
 		  SAVE_SEQUENCE_ERROR_INVALID_SEQUENCE,
 		  "Next in position less than current position");
+      trace_end("save-sequence", "switch");
       return FALSE;
     }
   }
 
   g_debug("Duration: %lld", duration);
+  if (sseq->active_src == sseq->silence_src && duration > 0) {
+    g_object_set(sseq->silence_src, "samplesperbuffer",
+		 (gint)MIN(duration, MAX_SILENCE_BUFFER_SAMPLES), NULL);
+  }
   input_src_pad = gst_element_get_static_pad(sseq->active_src, "src");
   seek_flags = GST_SEEK_FLAG_ACCURATE | GST_SEEK_FLAG_FLUSH;
   
@@ -266,8 +254,14 @@ next_file(SaveSequence *sseq, GError **err)
 
 		     
   gst_element_set_state(sseq->active_src, GST_STATE_PLAYING);
-  
-  
+
+  trace_end("save-sequence", "switch");
+  switch_time = g_get_monotonic_time() - switch_start;
+  sseq->stats.switches++;
+  sseq->stats.switch_time_total += switch_time;
+  if (switch_time > sseq->stats.switch_time_max) {
+    sseq->stats.switch_time_max = switch_time;
+  }
   return TRUE;
 }
 
@@ -302,6 +296,9 @@ bus_call (GstBus     *bus,
   case GST_MESSAGE_EOS:
     g_debug ("End-of-stream");
     stop_pipeline(sseq);
+    sseq->stats.done = g_get_monotonic_time();
+    sseq->stats.samples = sseq->current_sample - sseq->start_sample;
+    trace_end("save-sequence", "export");
     g_signal_emit(sseq, save_sequence_signals[DONE], 0);
     return TRUE;
   case GST_MESSAGE_ERROR: {
@@ -317,6 +314,7 @@ bus_call (GstBus     *bus,
       g_free (debug);
     }
     stop_pipeline(sseq);
+    trace_end("save-sequence", "export");
     return TRUE;
   }
   case GST_MESSAGE_SEGMENT_DONE:
@@ -507,7 +505,7 @@ save_sequence_init(SaveSequence *instance)
   instance->pipeline = NULL;
 
   instance->active_src = NULL;
-  
+  memset(&instance->stats, 0, sizeof(instance->stats));
 }
 
 SaveSequence *
@@ -524,7 +522,6 @@ save_sequence(SaveSequence *sseq, GFile *save_file,
 	      GError **err)
 {
   GstElement *file_sink;
-  sseq->depth = 0;
   stop_pipeline(sseq);
   if (!sseq->pipeline) {
     if (!create_pipeline(sseq, err)) {
@@ -550,14 +547,17 @@ save_sequence(SaveSequence *sseq, GFile *save_file,
   sseq->start_sample = ns_to_sample(start);
   sseq->current_sample = sseq->start_sample;
   sseq->last_pos = FALSE;
-  if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(sseq->subtitle_store),
-				    &sseq->next_pos)) {
-    if (find_valid_subtitle(sseq)) {
-      if (!next_file(sseq, err)) {
-	return FALSE;
-      }
-      gst_element_set_state(sseq->pipeline, GST_STATE_PLAYING);
+  memset(&sseq->stats, 0, sizeof(sseq->stats));
+  sseq->stats.started = g_get_monotonic_time();
+  trace_begin("save-sequence", "export");
+  sseq->next_pos =
+    find_valid_subtitle(subtitle_store_first_item(sseq->subtitle_store));
+  if (sseq->next_pos) {
+    if (!next_file(sseq, err)) {
+      trace_end("save-sequence", "export");
+      return FALSE;
     }
+    gst_element_set_state(sseq->pipeline, GST_STATE_PLAYING);
   }
   return TRUE;
 }
@@ -571,3 +571,9 @@ save_sequence_progress(SaveSequence *sseq)
   }
   return 0.0;
 }
+
+const SaveSequenceStats *
+save_sequence_get_stats(SaveSequence *sseq)
+{
+  return &sseq->stats;
+}
@@ -35,6 +35,18 @@ typedef struct _SaveSequenceClass   SaveSequenceClass;
 typedef struct _SaveSequenceReel   SaveSequenceReel;
 typedef struct _SaveSequenceAsset   SaveSequenceAsset;
 typedef struct _SaveSequenceRatio   SaveSequenceRatio;
+typedef struct _SaveSequenceStats   SaveSequenceStats;
+
+/* Timing for the last export. Times are from g_get_monotonic_time(). */
+struct _SaveSequenceStats
+{
+  gint64 started;
+  gint64 done; /* 0 until the export is finished */
+  guint switches; /* Number of source switches */
+  gint64 switch_time_total; /* Time spent switching sources */
+  gint64 switch_time_max;
+  guint64 samples; /* Samples written */
+};
 
 struct _SaveSequence
 {
@@ -52,13 +64,14 @@ struct _SaveSequence
   GstElement *output_element;
   BlockedSeek *blocked_seek;
 
-  GtkTreeIter next_pos;
+  const SubtitleStoreItem *next_pos; /* Next spot to play */
   guint64 next_sample; /* Sample offset */
   guint64 start_sample;
   guint64 end_sample;
   guint64 current_sample;
   gboolean last_pos;
-  guint depth;
+
+  SaveSequenceStats stats;
 };
 
 struct _SaveSequenceClass
@@ -95,4 +108,7 @@ save_sequence(SaveSequence *sseq, GFile *save_file,
 gdouble
 save_sequence_progress(SaveSequence *sseq);
 
+const SaveSequenceStats *
+save_sequence_get_stats(SaveSequence *sseq);
+
 #endif /* __SAVE_SEQUENCE_H__VM70XRUTTB__ */
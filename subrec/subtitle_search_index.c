@@ -0,0 +1,224 @@
+#include <subtitle_search_index.h>
+#include <string.h>
+
+struct _SubtitleSearchIndex
+{
+  GHashTable *docs; /* Document -> normalized text */
+  GHashTable *postings; /* Trigram -> GPtrArray of documents */
+  gchar *query; /* Last query passed to subtitle_search_index_match */
+  gchar **words; /* The normalized words of query */
+};
+
+#define TRIGRAM(p) GUINT_TO_POINTER(((guint)(guchar)(p)[0] << 16)	\
+				    | ((guint)(guchar)(p)[1] << 8)	\
+				    | (guint)(guchar)(p)[2])
+
+SubtitleSearchIndex *
+subtitle_search_index_new(void)
+{
+  SubtitleSearchIndex *index = g_new(SubtitleSearchIndex, 1);
+  index->docs = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				      NULL, g_free);
+  index->postings =
+    g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			  NULL, (GDestroyNotify)g_ptr_array_unref);
+  index->query = NULL;
+  index->words = NULL;
+  return index;
+}
+
+void
+subtitle_search_index_free(SubtitleSearchIndex *index)
+{
+  if (!index) return;
+  g_hash_table_destroy(index->docs);
+  g_hash_table_destroy(index->postings);
+  g_free(index->query);
+  g_strfreev(index->words);
+  g_free(index);
+}
+
+gchar *
+subtitle_search_normalize(const gchar *text)
+{
+  gchar *decomposed;
+  gchar *folded;
+  GString *stripped;
+  const gchar *p;
+  decomposed = g_utf8_normalize(text, -1, G_NORMALIZE_NFKD);
+  if (!decomposed) return g_strdup(""); /* Invalid UTF-8 */
+  stripped = g_string_sized_new(strlen(decomposed));
+  for (p = decomposed; *p; p = g_utf8_next_char(p)) {
+    gunichar c = g_utf8_get_char(p);
+    if (g_unichar_ismark(c)) continue;
+    if (g_unichar_isspace(c)) c = ' ';
+    g_string_append_unichar(stripped, c);
+  }
+  g_free(decomposed);
+  folded = g_utf8_casefold(stripped->str, stripped->len);
+  g_string_free(stripped, TRUE);
+  return folded;
+}
+
+/* The distinct trigrams of a normalized text. Trigrams spanning
+   words are left out since query words never contain spaces. */
+static GHashTable *
+text_trigrams(const gchar *text)
+{
+  GHashTable *set = g_hash_table_new(g_direct_hash, g_direct_equal);
+  gsize len = strlen(text);
+  gsize i;
+  for (i = 0; i + 3 <= len; i++) {
+    if (text[i] == ' ' || text[i + 1] == ' ' || text[i + 2] == ' ') continue;
+    g_hash_table_insert(set, TRIGRAM(text + i), TRIGRAM(text + i));
+  }
+  return set;
+}
+
+static void
+add_postings(SubtitleSearchIndex *index, gpointer doc, const gchar *text)
+{
+  GHashTable *trigrams = text_trigrams(text);
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, trigrams);
+  while(g_hash_table_iter_next(&iter, &key, NULL)) {
+    GPtrArray *posting = g_hash_table_lookup(index->postings, key);
+    if (!posting) {
+      posting = g_ptr_array_new();
+      g_hash_table_insert(index->postings, key, posting);
+    }
+    g_ptr_array_add(posting, doc);
+  }
+  g_hash_table_destroy(trigrams);
+}
+
+static void
+remove_postings(SubtitleSearchIndex *index, gpointer doc, const gchar *text)
+{
+  GHashTable *trigrams = text_trigrams(text);
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, trigrams);
+  while(g_hash_table_iter_next(&iter, &key, NULL)) {
+    GPtrArray *posting = g_hash_table_lookup(index->postings, key);
+    if (!posting) continue;
+    g_ptr_array_remove_fast(posting, doc);
+    if (posting->len == 0) g_hash_table_remove(index->postings, key);
+  }
+  g_hash_table_destroy(trigrams);
+}
+
+void
+subtitle_search_index_remove(SubtitleSearchIndex *index, gpointer doc)
+{
+  const gchar *text = g_hash_table_lookup(index->docs, doc);
+  if (!text) return;
+  remove_postings(index, doc, text);
+  g_hash_table_remove(index->docs, doc);
+}
+
+void
+subtitle_search_index_set(SubtitleSearchIndex *index, gpointer doc,
+			  const gchar *text)
+{
+  gchar *norm;
+  subtitle_search_index_remove(index, doc);
+  if (!text || *text == '\0') return;
+  norm = subtitle_search_normalize(text);
+  add_postings(index, doc, norm);
+  g_hash_table_insert(index->docs, doc, norm);
+}
+
+/* Normalized non-empty words of a query */
+static gchar **
+query_words(const gchar *query)
+{
+  gchar *norm = subtitle_search_normalize(query);
+  gchar **words = g_strsplit(norm, " ", -1);
+  gchar **src;
+  gchar **dst = words;
+  g_free(norm);
+  for (src = words; *src; src++) {
+    if (**src) {
+      *dst++ = *src;
+    } else {
+      g_free(*src);
+    }
+  }
+  *dst = NULL;
+  return words;
+}
+
+static gboolean
+text_matches(const gchar *text, gchar **words)
+{
+  if (!words[0]) return FALSE;
+  while(*words) {
+    if (!strstr(text, *words)) return FALSE;
+    words++;
+  }
+  return TRUE;
+}
+
+GPtrArray *
+subtitle_search_index_find(SubtitleSearchIndex *index, const gchar *query)
+{
+  GPtrArray *result = g_ptr_array_new();
+  GPtrArray *best = NULL;
+  gchar **words = query_words(query);
+  gchar **w;
+  guint i;
+  if (!words[0]) {
+    g_strfreev(words);
+    return result;
+  }
+  /* Only the documents in the shortest posting list need checking */
+  for (w = words; *w; w++) {
+    gsize len = strlen(*w);
+    gsize p;
+    for (p = 0; p + 3 <= len; p++) {
+      GPtrArray *posting = g_hash_table_lookup(index->postings,
+					       TRIGRAM(*w + p));
+      if (!posting) {
+	g_strfreev(words);
+	return result;
+      }
+      if (!best || posting->len < best->len) best = posting;
+    }
+  }
+  if (best) {
+    for (i = 0; i < best->len; i++) {
+      gpointer doc = g_ptr_array_index(best, i);
+      if (text_matches(g_hash_table_lookup(index->docs, doc), words)) {
+	g_ptr_array_add(result, doc);
+      }
+    }
+  } else {
+    /* All words are shorter than a trigram */
+    GHashTableIter iter;
+    gpointer doc;
+    gpointer text;
+    g_hash_table_iter_init(&iter, index->docs);
+    while(g_hash_table_iter_next(&iter, &doc, &text)) {
+      if (text_matches(text, words)) g_ptr_array_add(result, doc);
+    }
+  }
+  g_strfreev(words);
+  return result;
+}
+
+gboolean
+subtitle_search_index_match(SubtitleSearchIndex *index, gpointer doc,
+			    const gchar *query)
+{
+  const gchar *text;
+  if (!index->query || strcmp(index->query, query) != 0) {
+    g_free(index->query);
+    g_strfreev(index->words);
+    index->query = g_strdup(query);
+    index->words = query_words(query);
+  }
+  text = g_hash_table_lookup(index->docs, doc);
+  return text && text_matches(text, index->words);
+}
@@ -0,0 +1,44 @@
+#ifndef __SUBTITLE_SEARCH_INDEX_H__V7R2KQ9XTM__
+#define __SUBTITLE_SEARCH_INDEX_H__V7R2KQ9XTM__
+
+#include <glib.h>
+
+/* Text index for finding subtitles while ignoring case and accents.
+   Each document is stored normalized, with a posting list for every
+   trigram (of UTF-8 bytes) in it. A query is split into words and a
+   document matches if it contains all of them. Documents are opaque
+   pointers owned by the caller. */
+
+typedef struct _SubtitleSearchIndex SubtitleSearchIndex;
+
+SubtitleSearchIndex *
+subtitle_search_index_new(void);
+
+void
+subtitle_search_index_free(SubtitleSearchIndex *index);
+
+/* Casefolded, compatibility decomposed and with combining marks
+   removed. Free with g_free. */
+gchar *
+subtitle_search_normalize(const gchar *text);
+
+/* Replace the text of doc. NULL or an empty text removes it. */
+void
+subtitle_search_index_set(SubtitleSearchIndex *index, gpointer doc,
+			  const gchar *text);
+
+void
+subtitle_search_index_remove(SubtitleSearchIndex *index, gpointer doc);
+
+/* Documents matching query, in no particular order. An empty query
+   matches nothing. Free with g_ptr_array_unref. */
+GPtrArray *
+subtitle_search_index_find(SubtitleSearchIndex *index, const gchar *query);
+
+/* Check a single document. The normalized query is cached, so calling
+   this for many documents with the same query is cheap. */
+gboolean
+subtitle_search_index_match(SubtitleSearchIndex *index, gpointer doc,
+			    const gchar *query);
+
+#endif /* __SUBTITLE_SEARCH_INDEX_H__V7R2KQ9XTM__ */
@@ -47,13 +47,14 @@ struct SubtitleStoreItem
   gint64 out_ns;
   gchar *id;
   gchar *text;
-  gchar *filename;
+  gchar *first_line; /* NULL if text has a single line */
+  const gchar *filename; /* Interned, NULL if no file */
   gint64 duration;
-  GtkListStore *filelist;
+  SubtitleStoreFile *files; /* Alternate takes, most recent first */
+  guint n_files;
+  guint files_alloc;
 };
 
-typedef struct SubtitleStoreItem SubtitleStoreItem;
-
 static void
 destroy_items(SubtitleStoreItem *item);
 
@@ -62,8 +63,8 @@ destroy_item(SubtitleStoreItem *item)
 {
   g_free(item->id);
   g_free(item->text);
-  g_free(item->filename);
-  g_clear_object(&item->filelist);
+  g_free(item->first_line);
+  g_free(item->files);
   destroy_items(item->children);
   g_free(item);
 }
@@ -83,6 +84,7 @@ subtitle_store_finalize(GObject *object)
 {
   SubtitleStore *store = SUBTITLE_STORE(object);
   destroy_items(store->items);
+  subtitle_search_index_free(store->search_index);
   g_free(store->no_audio_color);
   g_free(store->ok_color);
   g_free(store->warning_color);
@@ -101,7 +103,8 @@ static GType column_types[] = {
   G_TYPE_STRING, /* filename */
   G_TYPE_INT64, /* duration */
   G_TYPE_STRING, /* color */
-  G_TYPE_OBJECT /* file list, set to GTK_TYPE_TREE_MODEL at class init */
+  G_TYPE_OBJECT, /* file list, set to GTK_TYPE_TREE_MODEL at class init */
+  G_TYPE_STRING /* first line of text */
 };
 
 #define COLUMN_COUNT (sizeof(column_types)/sizeof(column_types[0]))
@@ -192,7 +195,7 @@ model_get_path(GtkTreeModel *tree_model, GtkTreeIter  *iter)
 }
 
 static gint64
-get_in_ns(SubtitleStoreItem *item)
+get_in_ns(const SubtitleStoreItem *item)
 {
   if ((item->flags & SUBTITLE_STORE_TIME_FROM_CHILDREN)
       && item->children) {
@@ -202,7 +205,7 @@ get_in_ns(SubtitleStoreItem *item)
   }
 }
 static gint64
-get_base_ns(SubtitleStoreItem *item)
+get_base_ns(const SubtitleStoreItem *item)
 {
   if (!item) return 0;
   if (item->parent) {
@@ -216,13 +219,13 @@ get_base_ns(SubtitleStoreItem *item)
   }
 }
 static gint64
-get_in_global_ns(SubtitleStoreItem *item)
+get_in_global_ns(const SubtitleStoreItem *item)
 {
   return get_base_ns(item->parent) + get_in_ns(item);
 }
 
 static gint64
-get_out_ns(SubtitleStoreItem *item)
+get_out_ns(const SubtitleStoreItem *item)
 {
   if ((item->flags & SUBTITLE_STORE_TIME_FROM_CHILDREN)
       && item->children) {
@@ -235,11 +238,30 @@ get_out_ns(SubtitleStoreItem *item)
 }
 
 static gint64
-get_out_global_ns(SubtitleStoreItem *item)
+get_out_global_ns(const SubtitleStoreItem *item)
 {
   return get_base_ns(item->parent) + get_out_ns(item);
 }
 
+/* A list of the files of an item, built when needed for editing */
+static GtkTreeModel *
+files_model(SubtitleStoreItem *item)
+{
+  GtkListStore *list;
+  guint i;
+  if (item->n_files == 0) return NULL;
+  list = gtk_list_store_new(2, G_TYPE_STRING, G_TYPE_INT64);
+  for (i = 0; i < item->n_files; i++) {
+    gtk_list_store_insert_with_values(list, NULL, -1,
+				      SUBTITLE_STORE_FILES_COLUMN_FILE,
+				      item->files[i].name,
+				      SUBTITLE_STORE_FILES_COLUMN_DURATION,
+				      item->files[i].duration,
+				      -1);
+  }
+  return GTK_TREE_MODEL(list);
+}
+
 static void
 model_get_value(GtkTreeModel *tree_model, GtkTreeIter  *iter, gint column,
 		GValue *value)
@@ -302,7 +324,15 @@ model_get_value(GtkTreeModel *tree_model, GtkTreeIter  *iter, gint column,
     break;
   case SUBTITLE_STORE_COLUMN_FILES:
     g_value_init(value, GTK_TYPE_TREE_MODEL);
-    g_value_set_object(value, item->filelist);
+    g_value_take_object(value, files_model(item));
+    break;
+  case SUBTITLE_STORE_COLUMN_FIRST_LINE:
+    g_value_init(value, G_TYPE_STRING);
+    if (item->first_line) {
+      g_value_set_string(value, item->first_line);
+    } else {
+      g_value_set_string(value, item->text ? item->text : "");
+    }
     break;
     
   default:
@@ -534,6 +564,7 @@ subtitle_store_init(SubtitleStore *instance)
 {
   instance->items = NULL;
   instance->stamp = g_random_int() + 48978389;
+  instance->search_index = subtitle_search_index_new();
 
   instance->no_audio_color = g_strdup(DEFAULT_NO_AUDIO_COLOR);
   instance->ok_color = g_strdup(DEFAULT_OK_COLOR);
@@ -598,9 +629,12 @@ subtitle_store_insert(SubtitleStore *store, gint64 in_ns, gint64 out_ns,
   new_item->out_ns = out_ns;
   new_item->id = g_strdup(id);
   new_item->text = NULL;
+  new_item->first_line = NULL;
   new_item->filename = NULL;
   new_item->duration = 0;
-  new_item->filelist = NULL;
+  new_item->files = NULL;
+  new_item->n_files = 0;
+  new_item->files_alloc = 0;
   
   new_item->next = *itemp;
   new_item->prevp = itemp;
@@ -626,112 +660,188 @@ subtitle_store_set_text(SubtitleStore *store,
   SubtitleStoreItem *item = ITER_ITEM(iter);
   g_free(item->text);
   item->text = g_strdup(text);
+  g_free(item->first_line);
+  item->first_line = NULL;
+  if (text) {
+    const gchar *end = strchr(text, '\n');
+    if (end) {
+      /* Ellipsis (U+2026) marks the hidden lines */
+      item->first_line = g_strdup_printf("%.*s\xe2\x80\xa6",
+					 (int)(end - text), text);
+    }
+  }
+  subtitle_search_index_set(store->search_index, item, text);
   path = model_get_path(GTK_TREE_MODEL(store), iter);
   gtk_tree_model_row_changed(GTK_TREE_MODEL(store), path, iter); 
   gtk_tree_path_free(path);
   return TRUE;
 }
 
-struct FileSearchCtxt
+/* Returns the interned copy of str or NULL if str has never been
+   interned, in which case it can't be in any file list */
+static const gchar *
+intern_lookup(const gchar *str)
 {
-  const gchar *str;
-  gboolean found;
-  GtkTreeIter *iter;
-};
-  
-  
-static gboolean
-file_search_func(GtkTreeModel *model, GtkTreePath *path,
-		 GtkTreeIter *iter, gpointer data)
-{
-  gchar *str;
-  struct FileSearchCtxt *ctxt = data;
-  gtk_tree_model_get(model, iter, 0, &str, -1);
-  if (strcmp(str, ctxt->str) == 0) {
-    g_free(str);
-    if (ctxt->iter) *(ctxt->iter) = *iter;
-    ctxt->found = TRUE;
-    return TRUE;
+  GQuark quark = g_quark_try_string(str);
+  return quark ? g_quark_to_string(quark) : NULL;
+}
+
+/* name must be interned */
+static gint
+file_search(SubtitleStoreItem *item, const gchar *name)
+{
+  guint i;
+  if (!name) return -1;
+  for (i = 0; i < item->n_files; i++) {
+    if (item->files[i].name == name) return i;
   }
-  g_free(str);
-  return FALSE;
+  return -1;
 }
 
-static gboolean
-file_search(GtkListStore *store, const gchar *str, GtkTreeIter *iter)
+static void
+file_prepend(SubtitleStoreItem *item, const gchar *name, gint64 duration)
+{
+  if (item->n_files == item->files_alloc) {
+    item->files_alloc = item->files_alloc ? item->files_alloc * 2 : 2;
+    item->files = g_renew(SubtitleStoreFile, item->files, item->files_alloc);
+  }
+  memmove(item->files + 1, item->files,
+	  item->n_files * sizeof(SubtitleStoreFile));
+  item->files[0].name = name;
+  item->files[0].duration = duration;
+  item->n_files++;
+}
+
+static void
+item_changed(SubtitleStore *store, GtkTreeIter *iter)
 {
-  struct FileSearchCtxt ctxt;
-  if (!store) return FALSE;
-  ctxt.str = str;
-  ctxt.found = FALSE;
-  ctxt.iter = iter;
-  gtk_tree_model_foreach(GTK_TREE_MODEL(store), file_search_func, &ctxt);
-  return ctxt.found;
+  GtkTreePath *path = model_get_path(GTK_TREE_MODEL(store), iter);
+  gtk_tree_model_row_changed(GTK_TREE_MODEL(store), path, iter);
+  gtk_tree_path_free(path);
 }
-      
+
 gboolean
 subtitle_store_prepend_file(SubtitleStore *store, GtkTreeIter *iter,
 			    const gchar *filename, gint64 duration)
 {
   SubtitleStoreItem *item;
-  GtkTreeIter list_iter;
-  GtkTreePath *path;
+  const gchar *name;
   g_assert(iter->stamp == store->stamp);
   item = ITER_ITEM(iter);
-  if (!item->filelist) {
-    item->filelist = gtk_list_store_new(2, G_TYPE_STRING, G_TYPE_INT64);
-  } else {
-    if (file_search(item->filelist, filename, NULL)) return FALSE;
-  }
-  gtk_list_store_prepend(item->filelist, &list_iter);
-  gtk_list_store_set(item->filelist, &list_iter,
-		     SUBTITLE_STORE_FILES_COLUMN_FILE, filename,
-		     SUBTITLE_STORE_FILES_COLUMN_DURATION, duration,
-		     -1);
+  name = g_intern_string(filename);
+  if (file_search(item, name) >= 0) return FALSE;
+  file_prepend(item, name, duration);
   if (!item->filename) {
-    g_free(item->filename);
-    item->filename = g_strdup(filename);
+    item->filename = name;
     item->duration = duration;
   }
-  /* Signal row changed */
-  path = model_get_path(GTK_TREE_MODEL(store), iter);
-  gtk_tree_model_row_changed(GTK_TREE_MODEL(store), path, iter);
-  gtk_tree_path_free(path);
+  item_changed(store, iter);
   return TRUE;
 }
 
+guint
+subtitle_store_prepend_files(SubtitleStore *store, GtkTreeIter *iter,
+			     const gchar * const *files,
+			     const gint64 *durations, guint n_files)
+{
+  SubtitleStoreItem *item;
+  guint added = 0;
+  guint i;
+  g_assert(iter->stamp == store->stamp);
+  item = ITER_ITEM(iter);
+  for (i = 0; i < n_files; i++) {
+    const gchar *name = g_intern_string(files[i]);
+    if (file_search(item, name) >= 0) continue;
+    file_prepend(item, name, durations[i]);
+    added++;
+  }
+  if (added == 0) return 0;
+  if (!item->filename) {
+    /* The last prepended file is first in the list */
+    item->filename = item->files[0].name;
+    item->duration = item->files[0].duration;
+  }
+  item_changed(store, iter);
+  return added;
+}
+
+gboolean
+subtitle_store_has_file(SubtitleStore *store, GtkTreeIter *iter,
+			const gchar *file)
+{
+  g_assert(iter->stamp == store->stamp);
+  return file_search(ITER_ITEM(iter), intern_lookup(file)) >= 0;
+}
+
+const SubtitleStoreFile *
+subtitle_store_get_files(SubtitleStore *store, GtkTreeIter *iter,
+			 guint *n_files)
+{
+  SubtitleStoreItem *item;
+  g_assert(iter->stamp == store->stamp);
+  item = ITER_ITEM(iter);
+  *n_files = item->n_files;
+  return item->files;
+}
+
+GtkTreeModel *
+subtitle_store_get_files_model(SubtitleStore *store, GtkTreeIter *iter)
+{
+  g_assert(iter->stamp == store->stamp);
+  return files_model(ITER_ITEM(iter));
+}
+
+static void
+foreach_file(SubtitleStoreItem *item, gboolean active_only,
+	     SubtitleStoreFileFunc func, gpointer user_data)
+{
+  guint i;
+  while(item) {
+    if (active_only) {
+      if (item->filename) func(item->filename, user_data);
+    } else {
+      for (i = 0; i < item->n_files; i++) {
+	func(item->files[i].name, user_data);
+      }
+    }
+    foreach_file(item->children, active_only, func, user_data);
+    item = item->next;
+  }
+}
+
+void
+subtitle_store_foreach_file(SubtitleStore *store, gboolean active_only,
+			    SubtitleStoreFileFunc func, gpointer user_data)
+{
+  foreach_file(store->items, active_only, func, user_data);
+}
+
 gboolean
-subtitle_store_remove_file(SubtitleStore *store, 
+subtitle_store_remove_file(SubtitleStore *store,
 			   GtkTreeIter *iter, const gchar *file)
 {
   SubtitleStoreItem *item;
-  GtkTreeIter list_iter;
-  GtkTreePath *path;
+  const gchar *name;
+  gint i;
   g_assert(iter->stamp == store->stamp);
   item = ITER_ITEM(iter);
-  if (!item->filelist) return FALSE;
-  if (!file_search(item->filelist, file, &list_iter)) return FALSE;
-  gtk_list_store_remove(item->filelist, &list_iter);
-  if (gtk_tree_model_iter_n_children (GTK_TREE_MODEL(item->filelist), NULL)
-      == 0) {
-    g_clear_object(&item->filelist);
-    g_free(item->filename);
+  name = intern_lookup(file);
+  i = file_search(item, name);
+  if (i < 0) return FALSE;
+  item->n_files--;
+  memmove(item->files + i, item->files + i + 1,
+	  (item->n_files - i) * sizeof(SubtitleStoreFile));
+  if (item->n_files == 0) {
+    g_free(item->files);
+    item->files = NULL;
+    item->files_alloc = 0;
     item->filename = NULL;
-  } else {
-    if (strcmp(item->filename, file) == 0) {
-      /* Set item->filename to first file in list */
-      g_free(item->filename);
-      gtk_tree_model_get_iter_first(GTK_TREE_MODEL(item->filelist), &list_iter);
-      gtk_tree_model_get(GTK_TREE_MODEL(item->filelist), &list_iter,
-			 SUBTITLE_STORE_FILES_COLUMN_FILE, &item->filename,
-			 -1);
-    }
+  } else if (item->filename == name) {
+    /* Use the most recent remaining file */
+    item->filename = item->files[0].name;
+    item->duration = item->files[0].duration;
   }
-  
-  /* Signal row changed */
-  path = model_get_path(GTK_TREE_MODEL(store), iter);
-  gtk_tree_model_row_changed(GTK_TREE_MODEL(store), path, iter);
-  gtk_tree_path_free(path);
+  item_changed(store, iter);
   return TRUE;
 }
 
@@ -739,18 +849,15 @@ gboolean
 subtitle_store_set_file(SubtitleStore *store, GtkTreeIter *iter,
 			const gchar *filename, gint64 duration)
 {
-  GtkTreePath *path;
   SubtitleStoreItem *item = ITER_ITEM(iter);
-  g_free(item->filename);
-  item->filename = NULL;
-  if (!file_search(item->filelist, filename, NULL)) {
+  const gchar *name = g_intern_string(filename);
+  if (file_search(item, name) < 0) {
+    item->filename = NULL;
     subtitle_store_prepend_file(store, iter, filename, duration);
   } else {
-    item->filename = g_strdup(filename);
+    item->filename = name;
     item->duration = duration;
-    path = model_get_path(GTK_TREE_MODEL(store), iter);
-    gtk_tree_model_row_changed(GTK_TREE_MODEL(store), path, iter); 
-    gtk_tree_path_free(path);
+    item_changed(store, iter);
   }
   return TRUE;
 }
@@ -801,6 +908,7 @@ remove_item(SubtitleStore *store, GtkTreePath *path, SubtitleStoreItem *item)
     gtk_tree_path_up(path);
   }
   unlink_item(item);
+  subtitle_search_index_remove(store->search_index, item);
   destroy_item(item);
   gtk_tree_model_row_deleted(GTK_TREE_MODEL(store), path);
   
@@ -834,3 +942,142 @@ subtitle_store_get_file_duration(SubtitleStore *store, GtkTreeIter *iter)
   SubtitleStoreItem *item = ITER_ITEM(iter);
   return item->duration;
 }
+
+const SubtitleStoreItem *
+subtitle_store_first_item(SubtitleStore *store)
+{
+  return store->items;
+}
+
+const SubtitleStoreItem *
+subtitle_store_item_next(const SubtitleStoreItem *item)
+{
+  return item->next;
+}
+
+const SubtitleStoreItem *
+subtitle_store_item_children(const SubtitleStoreItem *item)
+{
+  return item->children;
+}
+
+const SubtitleStoreItem *
+subtitle_store_item_parent(const SubtitleStoreItem *item)
+{
+  return item->parent;
+}
+
+const SubtitleStoreItem *
+subtitle_store_item_next_preorder(const SubtitleStoreItem *item)
+{
+  if (item->children) return item->children;
+  while(item) {
+    if (item->next) return item->next;
+    item = item->parent;
+  }
+  return NULL;
+}
+
+gint64
+subtitle_store_item_in(const SubtitleStoreItem *item)
+{
+  return get_in_ns(item);
+}
+
+gint64
+subtitle_store_item_out(const SubtitleStoreItem *item)
+{
+  return get_out_ns(item);
+}
+
+gint64
+subtitle_store_item_global_in(const SubtitleStoreItem *item)
+{
+  return get_in_global_ns(item);
+}
+
+gint64
+subtitle_store_item_global_out(const SubtitleStoreItem *item)
+{
+  return get_out_global_ns(item);
+}
+
+const gchar *
+subtitle_store_item_id(const SubtitleStoreItem *item)
+{
+  return item->id;
+}
+
+const gchar *
+subtitle_store_item_text(const SubtitleStoreItem *item)
+{
+  return item->text ? item->text : "";
+}
+
+const gchar *
+subtitle_store_item_filename(const SubtitleStoreItem *item)
+{
+  return item->filename;
+}
+
+gint64
+subtitle_store_item_file_duration(const SubtitleStoreItem *item)
+{
+  return item->duration;
+}
+
+const SubtitleStoreFile *
+subtitle_store_item_files(const SubtitleStoreItem *item, guint *n_files)
+{
+  *n_files = item->n_files;
+  return item->files;
+}
+
+void
+subtitle_store_item_get_iter(SubtitleStore *store,
+			     const SubtitleStoreItem *item, GtkTreeIter *iter)
+{
+  iter->stamp = store->stamp;
+  ITER_ITEM(iter) = (SubtitleStoreItem*)item;
+}
+
+static void
+collect_matches(SubtitleStoreItem *item, GHashTable *found, GPtrArray *result)
+{
+  while(item) {
+    if (g_hash_table_lookup(found, item)) g_ptr_array_add(result, item);
+    collect_matches(item->children, found, result);
+    item = item->next;
+  }
+}
+
+GPtrArray *
+subtitle_store_search(SubtitleStore *store, const gchar *query)
+{
+  GPtrArray *found;
+  GPtrArray *result;
+  GHashTable *found_set;
+  guint i;
+  found = subtitle_search_index_find(store->search_index, query);
+  if (found->len <= 1) return found;
+  /* Sort the matches in document order */
+  found_set = g_hash_table_new(g_direct_hash, g_direct_equal);
+  for (i = 0; i < found->len; i++) {
+    gpointer item = g_ptr_array_index(found, i);
+    g_hash_table_insert(found_set, item, item);
+  }
+  result = g_ptr_array_sized_new(found->len);
+  collect_matches(store->items, found_set, result);
+  g_hash_table_destroy(found_set);
+  g_ptr_array_unref(found);
+  return result;
+}
+
+gboolean
+subtitle_store_search_match(SubtitleStore *store, GtkTreeIter *iter,
+			    const gchar *query)
+{
+  g_assert(iter->stamp == store->stamp);
+  return subtitle_search_index_match(store->search_index, ITER_ITEM(iter),
+				     query);
+}
@@ -4,6 +4,7 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 #include <gtk/gtk.h>
+#include <subtitle_search_index.h>
 
 #define SUBTITLE_STORE_ERROR (subtitle_store_error_quark())
 enum {
@@ -35,6 +36,7 @@ struct _SubtitleStore
   /* instance members */
   struct SubtitleStoreItem *items;
   gint stamp;
+  SubtitleSearchIndex *search_index; /* Subtitle texts */
 
   /* Colors for color column */
   gchar *no_audio_color;
@@ -67,7 +69,8 @@ enum {
   SUBTITLE_STORE_COLUMN_FILE,
   SUBTITLE_STORE_COLUMN_FILE_DURATION,
   SUBTITLE_STORE_COLUMN_FILE_COLOR,
-  SUBTITLE_STORE_COLUMN_FILES,
+  SUBTITLE_STORE_COLUMN_FILES, /* Built on each access */
+  SUBTITLE_STORE_COLUMN_FIRST_LINE, /* Text shortened to one line */
 };
 
 enum {
@@ -95,6 +98,47 @@ gboolean
 subtitle_store_prepend_file(SubtitleStore *store, GtkTreeIter *iter,
 			    const gchar *file, gint64 duration);
 
+/* Prepend several files at once, skipping those already in the list.
+   Only one row-changed is emitted. If the spot has no active file the
+   last added file becomes active. Returns the number of files added. */
+guint
+subtitle_store_prepend_files(SubtitleStore *store, GtkTreeIter *iter,
+			     const gchar * const *files,
+			     const gint64 *durations, guint n_files);
+
+gboolean
+subtitle_store_has_file(SubtitleStore *store, GtkTreeIter *iter,
+			const gchar *file);
+
+typedef struct _SubtitleStoreFile SubtitleStoreFile;
+
+struct _SubtitleStoreFile
+{
+  const gchar *name; /* Interned */
+  gint64 duration;
+};
+
+/* The files of a spot, most recent first. The array belongs to the
+   store and is only valid until the files of the spot are changed. */
+const SubtitleStoreFile *
+subtitle_store_get_files(SubtitleStore *store, GtkTreeIter *iter,
+			 guint *n_files);
+
+/* A new list model with SUBTITLE_STORE_FILES_COLUMN_* columns holding
+   the files of a spot, or NULL if there are none. The list is a copy
+   and is not updated when the store changes. */
+GtkTreeModel *
+subtitle_store_get_files_model(SubtitleStore *store, GtkTreeIter *iter);
+
+typedef void (*SubtitleStoreFileFunc)(const gchar *filename,
+				      gpointer user_data);
+
+/* Call func for every file in every file list, or only for the active
+   file of each spot if active_only is TRUE */
+void
+subtitle_store_foreach_file(SubtitleStore *store, gboolean active_only,
+			    SubtitleStoreFileFunc func, gpointer user_data);
+
 gboolean
 subtitle_store_remove_file(SubtitleStore *store, 
 			   GtkTreeIter *iter, const gchar *file);
@@ -117,4 +161,71 @@ subtitle_store_get_filename(SubtitleStore *store, GtkTreeIter *iter);
 gint64
 subtitle_store_get_file_duration(SubtitleStore *store, GtkTreeIter *iter);
 
+/* Read-only access to the items for code that doesn't need a
+   GtkTreeModel, like saving and exporting. Nothing is copied; the
+   pointers are valid until the store is changed. */
+
+typedef struct SubtitleStoreItem SubtitleStoreItem;
+
+const SubtitleStoreItem *
+subtitle_store_first_item(SubtitleStore *store);
+
+const SubtitleStoreItem *
+subtitle_store_item_next(const SubtitleStoreItem *item);
+
+const SubtitleStoreItem *
+subtitle_store_item_children(const SubtitleStoreItem *item);
+
+const SubtitleStoreItem *
+subtitle_store_item_parent(const SubtitleStoreItem *item);
+
+/* The next item in document order, a group before its children.
+   NULL after the last item. */
+const SubtitleStoreItem *
+subtitle_store_item_next_preorder(const SubtitleStoreItem *item);
+
+/* Times relative to the parent, as in SUBTITLE_STORE_COLUMN_IN/OUT */
+gint64
+subtitle_store_item_in(const SubtitleStoreItem *item);
+
+gint64
+subtitle_store_item_out(const SubtitleStoreItem *item);
+
+gint64
+subtitle_store_item_global_in(const SubtitleStoreItem *item);
+
+gint64
+subtitle_store_item_global_out(const SubtitleStoreItem *item);
+
+const gchar *
+subtitle_store_item_id(const SubtitleStoreItem *item);
+
+/* Never NULL */
+const gchar *
+subtitle_store_item_text(const SubtitleStoreItem *item);
+
+/* The selected file, NULL if none */
+const gchar *
+subtitle_store_item_filename(const SubtitleStoreItem *item);
+
+gint64
+subtitle_store_item_file_duration(const SubtitleStoreItem *item);
+
+const SubtitleStoreFile *
+subtitle_store_item_files(const SubtitleStoreItem *item, guint *n_files);
+
+void
+subtitle_store_item_get_iter(SubtitleStore *store,
+			     const SubtitleStoreItem *item, GtkTreeIter *iter);
+
+/* Items whose text contains every word of query, ignoring case and
+   accents, in document order. Free with g_ptr_array_unref. */
+GPtrArray *
+subtitle_store_search(SubtitleStore *store, const gchar *query);
+
+/* Same matching as subtitle_store_search, for a single row */
+gboolean
+subtitle_store_search_match(SubtitleStore *store, GtkTreeIter *iter,
+			    const gchar *query);
+
 #endif /* __SUBTITLE_STORE_H__MNFQQQ6EPP__ */
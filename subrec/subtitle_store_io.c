@@ -35,79 +35,74 @@ write_string(GOutputStream *output, const gchar *str, GError **error)
   return ret;
 }
 
+/* Escape text into buffer. Most texts need no escaping so they are
+   appended as is, without allocating a copy. */
+static void
+append_escaped(GString *buffer, const gchar *text)
+{
+  const guchar *p = (const guchar*)text;
+  while(*p) {
+    if (*p == '&' || *p == '<' || *p == '>' || *p == '\'' || *p == '"'
+	|| (*p < 0x20 && *p != '\t' && *p != '\n' && *p != '\r')
+	|| *p == 0x7f || *p == 0xc2) {
+      gchar *text_esc = g_markup_escape_text(text, -1);
+      g_string_append(buffer, text_esc);
+      g_free(text_esc);
+      return;
+    }
+    p++;
+  }
+  g_string_append(buffer, text);
+}
+
+static void
+append_item_head(GString *buffer, const gchar *tag,
+		 const SubtitleStoreItem *item)
+{
+  g_string_append_printf(buffer, "<%s TimeIn=\"%lld\" TimeOut=\"%lld\"",
+			 tag, subtitle_store_item_in(item),
+			 subtitle_store_item_out(item));
+  g_string_append_printf(buffer, " id=\"%s\"", subtitle_store_item_id(item));
+  g_string_append(buffer, ">\n<Text>");
+  append_escaped(buffer, subtitle_store_item_text(item));
+  g_string_append(buffer, "</Text>\n");
+}
+
 static gboolean
-save_subtitles(SubtitleStore *store, GtkTreeIter *iter,
+save_subtitles(const SubtitleStoreItem *item,
 	       GOutputStream *output, GString *buffer, GError **error)
 {
-  do {
-    gint64 in;
-    gint64 out;
-    gchar *id;
-    gchar *text;
-    gchar *text_esc;
+  for (; item; item = subtitle_store_item_next(item)) {
     const gchar *file;
-    gint64 duration;
-    GtkTreeModel *files;
-    GtkTreeIter child;
-    gboolean has_children;
-    gtk_tree_model_get(GTK_TREE_MODEL(store), iter,
-		       SUBTITLE_STORE_COLUMN_IN, &in,
-		       SUBTITLE_STORE_COLUMN_OUT, &out,
-		       SUBTITLE_STORE_COLUMN_ID, &id,
-		       SUBTITLE_STORE_COLUMN_TEXT, &text,
-		       SUBTITLE_STORE_COLUMN_FILES, &files,
-		       -1);
-    has_children = gtk_tree_model_iter_has_child(GTK_TREE_MODEL(store), iter);
-    g_string_append(buffer, has_children ? "<Group" : "<Subtitle");
-    g_string_append_printf(buffer, " TimeIn=\"%lld\" TimeOut=\"%lld\"",
-			   in, out);
-    g_string_append_printf(buffer, " id=\"%s\"", id);
-    g_string_append(buffer, ">\n");
-    text_esc = g_markup_escape_text (text, -1);
-    g_string_append_printf(buffer, "<Text>%s</Text>\n", text_esc);
-    g_free(text_esc);
-    file = subtitle_store_get_filename(store, iter);
-    duration = subtitle_store_get_file_duration(store, iter);
+    const SubtitleStoreFile *files;
+    guint n_files;
+    guint f;
+    const SubtitleStoreItem *children = subtitle_store_item_children(item);
+    append_item_head(buffer, children ? "Group" : "Subtitle", item);
+    file = subtitle_store_item_filename(item);
     if (file) {
       g_string_append_printf(buffer,
 			     "<AudioFile Duration=\"%lld\">%s</AudioFile>\n",
-			     duration, file);
+			     subtitle_store_item_file_duration(item), file);
     }
-    if (files) {
-      GtkTreeIter f;
-      if (gtk_tree_model_get_iter_first(files, &f)) {
-	do {
-	  gchar *altfile;
-	  gtk_tree_model_get(files, &f,
-			     SUBTITLE_STORE_FILES_COLUMN_FILE, &altfile,
-			     SUBTITLE_STORE_FILES_COLUMN_DURATION, &duration,
-			     -1);
-	  if (strcmp(file, altfile) != 0) {
-	    g_string_append_printf(buffer,
-				   "<AltAudioFile Duration=\"%lld\">%s"
-				   "</AltAudioFile>\n", duration, altfile);
-	  }
-	  g_free(altfile);
-	} while(gtk_tree_model_iter_next(files, &f));
+    files = subtitle_store_item_files(item, &n_files);
+    for (f = 0; f < n_files; f++) {
+      /* File names are interned */
+      if (files[f].name != file) {
+	g_string_append_printf(buffer,
+			       "<AltAudioFile Duration=\"%lld\">%s"
+			       "</AltAudioFile>\n",
+			       files[f].duration, files[f].name);
       }
-      g_object_unref(files);
     }
-    g_free(id);
-    g_free(text);
     if (!write_gstring(output, buffer, error)) return FALSE;
 
-    
-    if (gtk_tree_model_iter_children(GTK_TREE_MODEL(store), &child, iter)) {
-      do {
-	if (!save_subtitles(store, &child, output, buffer, error)) {
-	  return FALSE;
-	}
-      } while(gtk_tree_model_iter_next(GTK_TREE_MODEL(store),&child));
+    if (children) {
+      if (!save_subtitles(children, output, buffer, error)) return FALSE;
     }
-    g_string_append(buffer, has_children ? "</Group>" :"</Subtitle>");
+    g_string_append(buffer, children ? "</Group>" :"</Subtitle>");
     if (!write_gstring(output, buffer, error)) return FALSE;
-
-  } while(gtk_tree_model_iter_next(GTK_TREE_MODEL(store),iter));
+  }
   return TRUE;
 }
 
@@ -115,40 +110,19 @@ static gboolean
 save_reels(SubtitleStore *store, GOutputStream *output, GString *buffer,
 	   GError **error)
 {
-  GtkTreeIter iter;
+  const SubtitleStoreItem *reel;
   g_string_truncate(buffer,0);
-  if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(store), &iter)) {
-    do {
-      gint64 in;
-      gint64 out;
-      gchar *id;
-      gchar *text;
-      gchar *text_esc;
-      GtkTreeIter child;
-      gtk_tree_model_get(GTK_TREE_MODEL(store), &iter,
-			 SUBTITLE_STORE_COLUMN_IN, &in,
-			 SUBTITLE_STORE_COLUMN_OUT, &out,
-			 SUBTITLE_STORE_COLUMN_ID, &id,
-			 SUBTITLE_STORE_COLUMN_TEXT, &text,
-			 -1);
-      g_string_append(buffer, "<Reel");
-      g_string_append_printf(buffer, " TimeIn=\"%lld\" TimeOut=\"%lld\"",
-			     in, out);
-      g_string_append_printf(buffer, " id=\"%s\"", id);
-      g_string_append(buffer, ">\n");
-      text_esc = g_markup_escape_text (text, -1);
-      g_string_append_printf(buffer, "<Text>%s</Text>\n", text_esc);
-      g_free(text_esc);
-      if (!write_gstring(output, buffer, error)) return FALSE;
-      g_free(id);
-      g_free(text);
+  for (reel = subtitle_store_first_item(store); reel;
+       reel = subtitle_store_item_next(reel)) {
+    const SubtitleStoreItem *children = subtitle_store_item_children(reel);
+    append_item_head(buffer, "Reel", reel);
+    if (!write_gstring(output, buffer, error)) return FALSE;
 
-      if (gtk_tree_model_iter_children(GTK_TREE_MODEL(store), &child, &iter)) {
-	if (!save_subtitles(store, &child, output, buffer, error)) return FALSE;
-      }
-      
-      if (!write_string(output, "</Reel>\n", error)) return FALSE;
-    } while(gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &iter));
+    if (children) {
+      if (!save_subtitles(children, output, buffer, error)) return FALSE;
+    }
+
+    if (!write_string(output, "</Reel>\n", error)) return FALSE;
   }
   return TRUE;
 }
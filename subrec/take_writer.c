@@ -0,0 +1,284 @@
+#define _GNU_SOURCE /* fallocate */
+#include <take_writer.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define RING_SIZE (8 << 20) /* Bytes, must be a power of two */
+#define CHUNK_SIZE (256 << 10) /* Bytes, must divide RING_SIZE */
+#define DATA_OFFSET 4096 /* The header is padded to this size */
+#define PREALLOC_STEP (64 << 20) /* Bytes */
+#define POLL_INTERVAL 10000 /* Microseconds */
+
+enum {
+  STATE_RUNNING = 0,
+  STATE_CLOSING,
+  STATE_ABORT
+};
+
+struct _TakeWriter
+{
+  /* Byte counts, wrapping. head is only written by the producer and
+     tail only by the writer thread. */
+  volatile gint head;
+  volatile gint tail;
+  volatile gint overruns;
+  volatile gint high_water;
+  volatile gint state;
+  guint8 *ring;
+
+  /* Only used by the writer thread until it's done */
+  int fd;
+  guint rate;
+  guint channels;
+  guint64 data_size;
+  goffset allocated;
+  gboolean prealloc_failed;
+  GError *error;
+
+  GThread *thread;
+  TakeWriterDone done;
+  gpointer done_data;
+};
+
+static inline void
+write_le32(guint8 *p, guint32 v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static inline void
+write_le16(guint8 *p, guint16 v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void
+set_errno_error(GError **err, int errnum, const gchar *what)
+{
+  g_set_error(err, G_IO_ERROR, g_io_error_from_errno(errnum),
+	      "%s: %s", what, g_strerror(errnum));
+}
+
+static gboolean
+write_all(TakeWriter *writer, const guint8 *data, gsize size, goffset offset)
+{
+  while(size > 0) {
+    ssize_t w = pwrite(writer->fd, data, size, offset);
+    if (w < 0) {
+      if (errno == EINTR) continue;
+      set_errno_error(&writer->error, errno, "Failed to write take");
+      return FALSE;
+    }
+    data += w;
+    size -= w;
+    offset += w;
+  }
+  return TRUE;
+}
+
+/* A data size of 0 means the take wasn't finished. The header is
+   padded with a JUNK chunk so the data starts at DATA_OFFSET. */
+static gboolean
+write_header(TakeWriter *writer, guint32 data_size)
+{
+  guint8 header[DATA_OFFSET];
+  guint block_align = writer->channels * 2;
+  memset(header, 0, sizeof(header));
+  memcpy(header, "RIFF", 4);
+  write_le32(header + 4, data_size ? DATA_OFFSET - 8 + data_size : 0);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  write_le32(header + 16, 16);
+  write_le16(header + 20, 1); /* PCM */
+  write_le16(header + 22, writer->channels);
+  write_le32(header + 24, writer->rate);
+  write_le32(header + 28, writer->rate * block_align); /* Byte rate */
+  write_le16(header + 32, block_align);
+  write_le16(header + 34, 16); /* Bits per sample */
+  memcpy(header + 36, "JUNK", 4);
+  write_le32(header + 40, DATA_OFFSET - 52);
+  memcpy(header + DATA_OFFSET - 8, "data", 4);
+  write_le32(header + DATA_OFFSET - 4, data_size);
+  return write_all(writer, header, sizeof(header), 0);
+}
+
+/* Reserve space ahead of the data. On Linux the file size isn't
+   changed, so a take left by a crash still has the right length. */
+static void
+preallocate(TakeWriter *writer, goffset end)
+{
+  while(!writer->prealloc_failed && end > writer->allocated) {
+#ifdef FALLOC_FL_KEEP_SIZE
+    if (fallocate(writer->fd, FALLOC_FL_KEEP_SIZE,
+		  writer->allocated, PREALLOC_STEP) != 0) {
+      writer->prealloc_failed = TRUE;
+    }
+#else
+    if (posix_fallocate(writer->fd, writer->allocated, PREALLOC_STEP) != 0) {
+      writer->prealloc_failed = TRUE;
+    }
+#endif
+    writer->allocated += PREALLOC_STEP;
+  }
+}
+
+static gboolean
+writer_done(gpointer data)
+{
+  TakeWriter *writer = data;
+  g_thread_join(writer->thread);
+  writer->thread = NULL;
+  writer->done(writer, writer->error, writer->done_data);
+  return FALSE;
+}
+
+static gpointer
+writer_thread(gpointer data)
+{
+  TakeWriter *writer = data;
+  while(TRUE) {
+    /* Read the state first so nothing pushed before closing is missed */
+    gint state = g_atomic_int_get(&writer->state);
+    guint head = (guint)g_atomic_int_get(&writer->head);
+    guint tail = (guint)writer->tail;
+    guint avail = head - tail;
+    if (state == STATE_ABORT) break;
+    if (avail >= CHUNK_SIZE || (state == STATE_CLOSING && avail > 0)) {
+      guint pos = tail & (RING_SIZE - 1);
+      guint n = MIN(MIN(avail, CHUNK_SIZE), RING_SIZE - pos);
+      /* After an error the data is still consumed, so the producer
+	 doesn't overrun */
+      if (!writer->error) {
+	goffset offset = DATA_OFFSET + writer->data_size;
+	preallocate(writer, offset + n);
+	if (write_all(writer, writer->ring + pos, n, offset)) {
+	  writer->data_size += n;
+	}
+      }
+      g_atomic_int_set(&writer->tail, (gint)(tail + n));
+      continue;
+    }
+    if (state == STATE_CLOSING) break;
+    g_usleep(POLL_INTERVAL);
+  }
+  if (g_atomic_int_get(&writer->state) == STATE_ABORT) {
+    close(writer->fd);
+    return NULL;
+  }
+  if (!writer->error && writer->data_size > G_MAXUINT32 - DATA_OFFSET) {
+    g_set_error(&writer->error, G_IO_ERROR, G_IO_ERROR_FAILED,
+		"Take too long for a WAV file");
+  }
+  if (!writer->error) {
+    if (write_header(writer, writer->data_size)) {
+      /* Drop any space preallocated beyond the data */
+      if (ftruncate(writer->fd, DATA_OFFSET + writer->data_size) != 0) {
+	set_errno_error(&writer->error, errno, "Failed to truncate take");
+      }
+    }
+  }
+  if (close(writer->fd) != 0 && !writer->error) {
+    set_errno_error(&writer->error, errno, "Failed to close take");
+  }
+  g_idle_add(writer_done, writer);
+  return NULL;
+}
+
+TakeWriter *
+take_writer_new(GFile *file, guint rate, guint channels, GError **err)
+{
+  TakeWriter *writer;
+  gchar *path = g_file_get_path(file);
+  int fd;
+  if (!path) {
+    g_set_error(err, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+		"Takes can only be recorded to local files");
+    return NULL;
+  }
+  fd = g_open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    set_errno_error(err, errno, "Failed to create take");
+    g_free(path);
+    return NULL;
+  }
+  g_free(path);
+  writer = g_new0(TakeWriter, 1);
+  writer->ring = g_malloc(RING_SIZE);
+  writer->fd = fd;
+  writer->rate = rate;
+  writer->channels = channels;
+  preallocate(writer, DATA_OFFSET + PREALLOC_STEP);
+  if (!write_header(writer, 0)) {
+    g_propagate_error(err, writer->error);
+    writer->error = NULL;
+    close(fd);
+    take_writer_free(writer);
+    return NULL;
+  }
+  writer->thread = g_thread_new("take writer", writer_thread, writer);
+  return writer;
+}
+
+gboolean
+take_writer_push(TakeWriter *writer, const guint8 *data, gsize size)
+{
+  guint head = (guint)writer->head;
+  guint tail = (guint)g_atomic_int_get(&writer->tail);
+  guint pos;
+  guint first;
+  guint fill;
+  if (size > RING_SIZE - (head - tail)) {
+    g_atomic_int_inc(&writer->overruns);
+    return FALSE;
+  }
+  pos = head & (RING_SIZE - 1);
+  first = MIN(size, RING_SIZE - pos);
+  memcpy(writer->ring + pos, data, first);
+  memcpy(writer->ring, data + first, size - first);
+  g_atomic_int_set(&writer->head, (gint)(head + size));
+  fill = head + size - tail;
+  if (fill > (guint)writer->high_water) {
+    g_atomic_int_set(&writer->high_water, (gint)fill);
+  }
+  return TRUE;
+}
+
+void
+take_writer_close(TakeWriter *writer, TakeWriterDone done,
+		  gpointer user_data)
+{
+  writer->done = done;
+  writer->done_data = user_data;
+  g_atomic_int_set(&writer->state, STATE_CLOSING);
+}
+
+guint
+take_writer_overruns(TakeWriter *writer)
+{
+  return g_atomic_int_get(&writer->overruns);
+}
+
+gsize
+take_writer_high_water(TakeWriter *writer)
+{
+  return (guint)g_atomic_int_get(&writer->high_water);
+}
+
+void
+take_writer_free(TakeWriter *writer)
+{
+  if (!writer) return;
+  if (writer->thread) {
+    g_atomic_int_set(&writer->state, STATE_ABORT);
+    g_thread_join(writer->thread);
+  }
+  g_clear_error(&writer->error);
+  g_free(writer->ring);
+  g_free(writer);
+}
@@ -0,0 +1,48 @@
+#ifndef __TAKE_WRITER_H__K3VQ8NZ0RD__
+#define __TAKE_WRITER_H__K3VQ8NZ0RD__
+
+#include <gio/gio.h>
+
+/* Writes a recorded take to a 16 bit PCM WAV file from a dedicated
+   thread. The streaming thread pushes into a lock-free ring and never
+   waits for storage; if the ring is full the data is dropped and
+   counted as an overrun. The file is preallocated and written in large
+   chunks aligned to the start of the data. */
+
+typedef struct _TakeWriter TakeWriter;
+
+/* Called in the main thread when the file is closed. err is NULL if
+   everything was written. */
+typedef void (*TakeWriterDone)(TakeWriter *writer, const GError *err,
+			       gpointer user_data);
+
+/* Creates the file and starts the writer thread. Only local files are
+   supported. */
+TakeWriter *
+take_writer_new(GFile *file, guint rate, guint channels, GError **err);
+
+/* Producer side, called from a single streaming thread. Returns FALSE
+   if the data didn't fit. */
+gboolean
+take_writer_push(TakeWriter *writer, const guint8 *data, gsize size);
+
+/* Write what's left, fill in the header and close the file. Nothing may
+   be pushed after this. */
+void
+take_writer_close(TakeWriter *writer, TakeWriterDone done,
+		  gpointer user_data);
+
+/* Number of pushes dropped because the ring was full */
+guint
+take_writer_overruns(TakeWriter *writer);
+
+/* Largest number of bytes waiting in the ring */
+gsize
+take_writer_high_water(TakeWriter *writer);
+
+/* Stops the thread if it's still running, without finishing the file.
+   Don't call this while waiting for the done callback. */
+void
+take_writer_free(TakeWriter *writer);
+
+#endif /* __TAKE_WRITER_H__K3VQ8NZ0RD__ */
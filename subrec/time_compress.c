@@ -0,0 +1,313 @@
+#include <time_compress.h>
+#include <wav_file.h>
+#include <simd.h>
+#include <math.h>
+#include <string.h>
+
+/* Frames of 20ms overlapping by half, with each frame allowed to move
+   5ms either way to line up with the output */
+#define FRAME_MS 20
+#define SEEK_DIVISOR 2 /* Of the hop */
+/* The search first tries every SEEK_STEP positions, then refines
+   around the best one */
+#define SEEK_STEP 4
+
+GQuark
+time_compress_error_quark()
+{
+  static GQuark error_quark = 0;
+  if (error_quark == 0)
+    error_quark = g_quark_from_static_string ("time-compress-error-quark");
+  return error_quark;
+}
+
+static guint
+frame_length(guint rate)
+{
+  return (rate * FRAME_MS / 1000) & ~1;
+}
+
+/* Cross-correlation of a and b, and the energy of b */
+static void
+correlate(const gfloat *a, const gfloat *b, guint n,
+	  gfloat *cross, gfloat *energy)
+{
+  guint i = 0;
+  gfloat c = 0.0;
+  gfloat e = 0.0;
+#ifdef HAVE_V4SF
+  v4sf vc = v4sf_set1(0.0);
+  v4sf ve = v4sf_set1(0.0);
+  for (; i + 4 <= n; i += 4) {
+    v4sf va = v4sf_load(a + i);
+    v4sf vb = v4sf_load(b + i);
+    vc += va * vb;
+    ve += vb * vb;
+  }
+  c = v4sf_hsum(vc);
+  e = v4sf_hsum(ve);
+#endif
+  for (; i < n; i++) {
+    c += a[i] * b[i];
+    e += b[i] * b[i];
+  }
+  *cross = c;
+  *energy = e;
+}
+
+static gfloat
+similarity(const gfloat *x, gsize natural, gsize pos, guint n)
+{
+  gfloat cross;
+  gfloat energy;
+  correlate(x + natural, x + pos, n, &cross, &energy);
+  return cross / sqrtf(energy + 1e-9f);
+}
+
+/* Position in [lo, hi] where the next frame best continues the
+   waveform at natural */
+static gsize
+best_match(const gfloat *x, gsize natural, gsize lo, gsize hi, guint n)
+{
+  gsize best = lo;
+  gfloat best_score = -G_MAXFLOAT;
+  gsize fine_lo;
+  gsize fine_hi;
+  gsize pos;
+  for (pos = lo; pos <= hi; pos += SEEK_STEP) {
+    gfloat score = similarity(x, natural, pos, n);
+    if (score > best_score) {
+      best_score = score;
+      best = pos;
+    }
+  }
+  fine_lo = best > lo + SEEK_STEP - 1 ? best - (SEEK_STEP - 1) : lo;
+  fine_hi = MIN(best + SEEK_STEP - 1, hi);
+  for (pos = fine_lo; pos <= fine_hi; pos++) {
+    gfloat score;
+    if (pos == best) continue;
+    score = similarity(x, natural, pos, n);
+    if (score > best_score) {
+      best_score = score;
+      best = pos;
+    }
+  }
+  return best;
+}
+
+static void
+add_frame(gfloat *y, const gfloat *x, const gfloat *window, guint n)
+{
+  guint i = 0;
+#ifdef HAVE_V4SF
+  for (; i + 4 <= n; i += 4) {
+    v4sf_store(y + i,
+	       v4sf_load(y + i) + v4sf_load(x + i) * v4sf_load(window + i));
+  }
+#endif
+  for (; i < n; i++) {
+    y[i] += x[i] * window[i];
+  }
+}
+
+/* Channel channel of the interleaved input as float, or the mean of
+   all channels if channel is negative */
+static void
+load_channel(gfloat *x, const gint16 *in, gsize len, guint channels,
+	     gint channel)
+{
+  gsize i = 0;
+  guint c;
+  if (channels == 1) {
+#ifdef HAVE_V4SF
+    for (; i + 4 <= len; i += 4) {
+      v4sf_store(x + i, v4sf_from_s16(in + i, 1.0 / 32768));
+    }
+#endif
+    for (; i < len; i++) {
+      x[i] = in[i] * (1.0 / 32768);
+    }
+  } else if (channel >= 0) {
+    for (; i < len; i++) {
+      x[i] = in[i * channels + channel] * (1.0 / 32768);
+    }
+  } else {
+    gfloat scale = 1.0 / (32768.0 * channels);
+    for (; i < len; i++) {
+      gint sum = 0;
+      for (c = 0; c < channels; c++) sum += in[i * channels + c];
+      x[i] = sum * scale;
+    }
+  }
+}
+
+void
+time_compress_s16(const gint16 *in, gsize in_len, gint16 *out, gsize out_len,
+		  guint channels, guint rate)
+{
+  guint frame = frame_length(rate);
+  guint hop = frame / 2;
+  guint seek = hop / SEEK_DIVISOR;
+  gsize max_pos = in_len - frame;
+  gsize n_frames;
+  gsize y_len;
+  gdouble analysis_hop;
+  gfloat *x;
+  gfloat *y;
+  gfloat *windows;
+  gsize *positions;
+  guint c;
+  gsize k;
+  gsize i;
+  g_return_if_fail(in_len >= out_len && out_len >= 2 * frame);
+
+  /* The frames are picked on the mix of all channels, so every channel
+     is cut at the same places and they stay in sync */
+  x = g_new(gfloat, in_len);
+  load_channel(x, in, in_len, channels, -1);
+
+  /* Hann windows overlapping by half sum to one. The first frame
+     doesn't fade in and the last doesn't fade out. */
+  windows = g_new(gfloat, 3 * frame);
+  for (i = 0; i < frame; i++) {
+    gfloat w = 0.5 - 0.5 * cos(2 * G_PI * i / frame);
+    windows[i] = w;
+    windows[frame + i] = i < hop ? 1.0 : w;
+    windows[2 * frame + i] = i < hop ? w : 1.0;
+  }
+
+  n_frames = (out_len - frame + hop - 1) / hop + 1;
+  analysis_hop = (gdouble)max_pos / (n_frames - 1);
+  positions = g_new(gsize, n_frames);
+  positions[0] = 0;
+  for (k = 1; k < n_frames; k++) {
+    gsize nominal = floor(k * analysis_hop + 0.5);
+    gsize lo = nominal > seek ? nominal - seek : 0;
+    gsize hi = MIN(nominal + seek, max_pos);
+    /* Compare the half that is overlapped with the continuation of the
+       previous frame */
+    positions[k] = best_match(x, positions[k - 1] + hop, lo, hi, hop);
+  }
+
+  y_len = (n_frames - 1) * hop + frame;
+  y = g_new(gfloat, y_len);
+  for (c = 0; c < channels; c++) {
+    if (channels > 1) load_channel(x, in, in_len, channels, c);
+    memset(y, 0, y_len * sizeof(gfloat));
+    add_frame(y, x, windows + frame, frame);
+    for (k = 1; k < n_frames; k++) {
+      const gfloat *window =
+	k + 1 == n_frames ? windows + 2 * frame : windows;
+      add_frame(y + k * hop, x + positions[k], window, frame);
+    }
+    for (i = 0; i < out_len; i++) {
+      gfloat v = floorf(y[i] * 32768 + 0.5);
+      out[i * channels + c] = CLAMP(v, -32768, 32767);
+    }
+  }
+  g_free(positions);
+  g_free(y);
+  g_free(windows);
+  g_free(x);
+}
+
+typedef struct
+{
+  GFile *src;
+  GFile *dest;
+  GstClockTime length;
+  TimeCompressDone done;
+  gpointer user_data;
+  /* Set by the worker */
+  GstClockTime written;
+  GError *error;
+} CompressJob;
+
+static gboolean
+report_done(gpointer user_data)
+{
+  CompressJob *job = user_data;
+  if (job->done) {
+    job->done(job->written, job->error, job->user_data);
+  }
+  g_clear_error(&job->error);
+  g_object_unref(job->src);
+  g_object_unref(job->dest);
+  g_free(job);
+  return FALSE;
+}
+
+static gboolean
+compress(CompressJob *job)
+{
+  gint16 *in;
+  gint16 *out;
+  gsize in_len;
+  gsize out_len;
+  guint channels;
+  guint rate;
+  gboolean ret;
+  if (!wav_file_read_s16(job->src, &in, &in_len, &channels, &rate,
+			 &job->error)) {
+    return FALSE;
+  }
+  out_len = gst_util_uint64_scale(job->length, rate, GST_SECOND);
+  if (out_len >= in_len) {
+    g_set_error(&job->error, TIME_COMPRESS_ERROR, TIME_COMPRESS_ERROR_FITS,
+		"The take already fits");
+    g_free(in);
+    return FALSE;
+  }
+  if (out_len < in_len * TIME_COMPRESS_MIN_RATIO) {
+    g_set_error(&job->error, TIME_COMPRESS_ERROR,
+		TIME_COMPRESS_ERROR_TOO_LONG,
+		"The take is %.0f%% too long, it can be shortened by at most"
+		" %.0f%%",
+		100.0 * (in_len - out_len) / out_len,
+		100.0 * (1.0 - TIME_COMPRESS_MIN_RATIO));
+    g_free(in);
+    return FALSE;
+  }
+  if (out_len < 2 * frame_length(rate)) {
+    g_set_error(&job->error, TIME_COMPRESS_ERROR, TIME_COMPRESS_ERROR_FAILED,
+		"The take is too short to compress");
+    g_free(in);
+    return FALSE;
+  }
+  out = g_new(gint16, out_len * channels);
+  time_compress_s16(in, in_len, out, out_len, channels, rate);
+  g_free(in);
+  ret = wav_file_write_s16(job->dest, out, out_len, channels, rate,
+			   &job->error);
+  g_free(out);
+  if (ret) {
+    job->written = gst_util_uint64_scale(out_len, GST_SECOND, rate);
+  }
+  return ret;
+}
+
+static gpointer
+compress_thread(gpointer user_data)
+{
+  CompressJob *job = user_data;
+  compress(job);
+  g_idle_add(report_done, job);
+  return NULL;
+}
+
+void
+time_compress_file(GFile *src, GFile *dest, GstClockTime length,
+		   TimeCompressDone done, gpointer user_data)
+{
+  GThread *thread;
+  CompressJob *job = g_new(CompressJob, 1);
+  job->src = g_object_ref(src);
+  job->dest = g_object_ref(dest);
+  job->length = length;
+  job->done = done;
+  job->user_data = user_data;
+  job->written = 0;
+  job->error = NULL;
+  thread = g_thread_new("time-compress", compress_thread, job);
+  g_thread_unref(thread);
+}
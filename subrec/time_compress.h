@@ -0,0 +1,36 @@
+#ifndef __TIME_COMPRESS_H__R4NV8QJ2TC__
+#define __TIME_COMPRESS_H__R4NV8QJ2TC__
+
+#include <gio/gio.h>
+#include <gst/gst.h>
+
+#define TIME_COMPRESS_ERROR (time_compress_error_quark())
+enum {
+  TIME_COMPRESS_ERROR_FAILED = 1,
+  TIME_COMPRESS_ERROR_TOO_LONG, /* Needs more than the maximum compression */
+  TIME_COMPRESS_ERROR_FITS /* Already short enough */
+};
+
+/* A take is shortened at most to this fraction of its length */
+#define TIME_COMPRESS_MIN_RATIO 0.85
+
+/* Called in the main thread. length is the length of the written file. */
+typedef void (*TimeCompressDone)(GstClockTime length, const GError *error,
+				 gpointer user_data);
+
+/* Shorten the take in src to length without changing the pitch and
+   write it to dest. Overlapping frames are picked by waveform
+   similarity (WSOLA), so speech keeps its pitch and timbre. Runs in a
+   worker thread. */
+void
+time_compress_file(GFile *src, GFile *dest, GstClockTime length,
+		   TimeCompressDone done, gpointer user_data);
+
+/* The WSOLA stage, writes exactly out_len frames of interleaved
+   channels. in_len must be at least out_len, and both at least two
+   frames (40ms). */
+void
+time_compress_s16(const gint16 *in, gsize in_len, gint16 *out, gsize out_len,
+		  guint channels, guint rate);
+
+#endif /* __TIME_COMPRESS_H__R4NV8QJ2TC__ */
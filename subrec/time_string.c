@@ -1,5 +1,4 @@
 #include <time_string.h>
-#include <stdio.h>
 
 static void
 skip_white(const gchar **p)
@@ -101,9 +100,35 @@ time_string_parse(const gchar *str, gint64 *time)
   return TRUE;
 }
 
+/* Same as printf("%02d") */
+static gchar *
+format_02d(gchar *p, gint v)
+{
+  gchar digits[12];
+  gint n = 0;
+  guint u;
+  if (v < 0) {
+    *p++ = '-';
+    u = -(guint)v;
+  } else {
+    u = v;
+    if (u < 10) *p++ = '0';
+  }
+  do {
+    digits[n++] = '0' + u % 10;
+    u /= 10;
+  } while(u > 0);
+  while(n > 0) *p++ = digits[--n];
+  return p;
+}
+
+/* Formats without printf since this is called for every time cell
+   that is drawn */
 void
 time_string_format(gchar *str, guint capacity, gint64 time)
 {
+  gchar buffer[48];
+  gchar *p = buffer;
   gint h,m,s;
   h = time / HOURS;
   time -= h * HOURS;
@@ -111,10 +136,19 @@ time_string_format(gchar *str, guint capacity, gint64 time)
   time -= m * MINUTES;
   s = time / SECONDS;
   time -= s * SECONDS;
+  p = format_02d(p, h);
+  *p++ = 'h';
+  p = format_02d(p, m);
+  *p++ = 'm';
+  p = format_02d(p, s);
   if (time > 0) {
-    g_snprintf((char*)str, capacity, "%02dh%02dm%02d.%03ds",
-	       h,m,s, (int)(time / MILLISECONDS));
-  } else {
-    snprintf((char*)str, capacity, "%02dh%02dm%02ds",h,m,s);
+    gint ms = time / MILLISECONDS;
+    *p++ = '.';
+    *p++ = '0' + ms / 100;
+    *p++ = '0' + ms / 10 % 10;
+    *p++ = '0' + ms % 10;
   }
+  *p++ = 's';
+  *p = '\0';
+  if (capacity > 0) g_strlcpy(str, buffer, capacity);
 }
@@ -0,0 +1,112 @@
+#include <trace_log.h>
+
+typedef struct
+{
+  const gchar *category;
+  const gchar *name;
+  gchar phase; /* 'B', 'E' or 'i' */
+  guint tid;
+  gint64 ts; /* Monotonic time in microseconds */
+} TraceEvent;
+
+static gint enabled = FALSE;
+static GMutex lock;
+static GArray *events = NULL;
+static GHashTable *thread_ids = NULL;
+static gint64 start_time = 0;
+
+void
+trace_log_enable(void)
+{
+  g_mutex_lock(&lock);
+  if (!events) {
+    events = g_array_sized_new(FALSE, FALSE, sizeof(TraceEvent), 1024);
+    thread_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+    start_time = g_get_monotonic_time();
+  }
+  g_mutex_unlock(&lock);
+  g_atomic_int_set(&enabled, TRUE);
+}
+
+gboolean
+trace_log_enabled(void)
+{
+  return g_atomic_int_get(&enabled);
+}
+
+void
+trace_log_clear(void)
+{
+  g_mutex_lock(&lock);
+  if (events) {
+    g_array_set_size(events, 0);
+  }
+  g_mutex_unlock(&lock);
+}
+
+static void
+add_event(const gchar *category, const gchar *name, gchar phase)
+{
+  TraceEvent ev;
+  gpointer self;
+  if (!g_atomic_int_get(&enabled)) return;
+  ev.category = category;
+  ev.name = name;
+  ev.phase = phase;
+  ev.ts = g_get_monotonic_time();
+  self = g_thread_self();
+  g_mutex_lock(&lock);
+  ev.tid = GPOINTER_TO_UINT(g_hash_table_lookup(thread_ids, self));
+  if (ev.tid == 0) {
+    /* Number threads in order of appearance, the first is usually the
+       main loop */
+    ev.tid = g_hash_table_size(thread_ids) + 1;
+    g_hash_table_insert(thread_ids, self, GUINT_TO_POINTER(ev.tid));
+  }
+  g_array_append_val(events, ev);
+  g_mutex_unlock(&lock);
+}
+
+void
+trace_begin(const gchar *category, const gchar *name)
+{
+  add_event(category, name, 'B');
+}
+
+void
+trace_end(const gchar *category, const gchar *name)
+{
+  add_event(category, name, 'E');
+}
+
+void
+trace_instant(const gchar *category, const gchar *name)
+{
+  add_event(category, name, 'i');
+}
+
+gboolean
+trace_log_write(GFile *file, GError **err)
+{
+  GString *json;
+  guint i;
+  gboolean ret;
+  json = g_string_new("{\"traceEvents\":[\n");
+  g_mutex_lock(&lock);
+  for (i = 0; events && i < events->len; i++) {
+    const TraceEvent *ev = &g_array_index(events, TraceEvent, i);
+    g_string_append_printf(json,
+			   "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\","
+			   "\"ts\":%" G_GINT64_FORMAT ",\"pid\":1,\"tid\":%u%s}",
+			   i > 0 ? ",\n" : "",
+			   ev->name, ev->category, ev->phase,
+			   ev->ts - start_time, ev->tid,
+			   ev->phase == 'i' ? ",\"s\":\"t\"" : "");
+  }
+  g_mutex_unlock(&lock);
+  g_string_append(json, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  ret = g_file_replace_contents(file, json->str, json->len, NULL, FALSE,
+				G_FILE_CREATE_NONE, NULL, NULL, err);
+  g_string_free(json, TRUE);
+  return ret;
+}
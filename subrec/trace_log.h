@@ -0,0 +1,36 @@
+#ifndef __TRACE_LOG_H__R4XW8ZQ1KD__
+#define __TRACE_LOG_H__R4XW8ZQ1KD__
+#include <glib.h>
+#include <gio/gio.h>
+
+/* Process wide event log for timing state transitions. Recording is
+   off until trace_log_enable() is called, until then the trace
+   functions only test a flag.
+
+   Categories and names are not copied, they must be static strings. */
+
+void
+trace_log_enable(void);
+
+gboolean
+trace_log_enabled(void);
+
+void
+trace_log_clear(void);
+
+/* Begin and end must be called from the same thread and nest properly */
+void
+trace_begin(const gchar *category, const gchar *name);
+
+void
+trace_end(const gchar *category, const gchar *name);
+
+void
+trace_instant(const gchar *category, const gchar *name);
+
+/* Write all recorded events in Chrome trace event format (JSON). The
+   file can be loaded in chrome://tracing or Perfetto. */
+gboolean
+trace_log_write(GFile *file, GError **err);
+
+#endif /* __TRACE_LOG_H__R4XW8ZQ1KD__ */
@@ -0,0 +1,267 @@
+#include <wav_file.h>
+#include <string.h>
+
+GQuark
+wav_file_error_quark()
+{
+  static GQuark error_quark = 0;
+  if (error_quark == 0)
+    error_quark = g_quark_from_static_string ("wav-file-error-quark");
+  return error_quark;
+}
+
+static inline guint32
+read_le32(const guint8 *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((guint32)p[3] << 24);
+}
+
+static inline guint16
+read_le16(const guint8 *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static inline void
+write_le32(guint8 *p, guint32 v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static inline void
+write_le16(guint8 *p, guint16 v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static gboolean
+read_bytes(GInputStream *stream, guint8 *buffer, gsize len, GError **err)
+{
+  gsize read;
+  if (!g_input_stream_read_all(stream, buffer, len, &read, NULL, err)) {
+    return FALSE;
+  }
+  if (read < len) {
+    g_set_error(err, WAV_FILE_ERROR, WAV_FILE_ERROR_FORMAT,
+		"Truncated WAV header");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+gboolean
+wav_file_get_duration(GFile *file, GstClockTime *duration, GError **err)
+{
+  GFileInputStream *stream;
+  GInputStream *in;
+  guint8 header[16];
+  guint32 byte_rate = 0;
+  goffset pos;
+  gboolean ret = FALSE;
+  stream = g_file_read(file, NULL, err);
+  if (!stream) return FALSE;
+  in = G_INPUT_STREAM(stream);
+  if (!read_bytes(in, header, 12, err)) goto done;
+  if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+    g_set_error(err, WAV_FILE_ERROR, WAV_FILE_ERROR_FORMAT,
+		"Not a WAV file");
+    goto done;
+  }
+  pos = 12;
+  while(TRUE) {
+    guint32 size;
+    if (!read_bytes(in, header, 8, err)) goto done;
+    pos += 8;
+    size = read_le32(header + 4);
+    if (memcmp(header, "fmt ", 4) == 0) {
+      if (size < 16) {
+	g_set_error(err, WAV_FILE_ERROR, WAV_FILE_ERROR_FORMAT,
+		    "Short format chunk");
+	goto done;
+      }
+      if (!read_bytes(in, header, 16, err)) goto done;
+      pos += 16;
+      byte_rate = read_le32(header + 8);
+      size -= 16;
+    } else if (memcmp(header, "data", 4) == 0) {
+      GFileInfo *info;
+      goffset file_size;
+      if (byte_rate == 0) {
+	g_set_error(err, WAV_FILE_ERROR, WAV_FILE_ERROR_FORMAT,
+		    "No format before data");
+	goto done;
+      }
+      info = g_file_input_stream_query_info(stream,
+					    G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					    NULL, err);
+      if (!info) goto done;
+      file_size = g_file_info_get_size(info);
+      g_object_unref(info);
+      /* The size is written when recording ends */
+      if (size == 0 || size == 0xffffffff || pos + size > file_size) {
+	size = file_size - pos;
+      }
+      *duration = gst_util_uint64_scale(size, GST_SECOND, byte_rate);
+      ret = TRUE;
+      goto done;
+    }
+    /* Chunks are padded to even length */
+    size += size & 1;
+    if (g_input_stream_skip(in, size, NULL, err) < 0) goto done;
+    pos += size;
+  }
+ done:
+  g_object_unref(stream);
+  return ret;
+}
+
+gboolean
+wav_file_read_s16(GFile *file, gint16 **samples, gsize *n_frames,
+		  guint *channels, guint *rate, GError **err)
+{
+  GFileInputStream *stream;
+  GInputStream *in;
+  guint8 header[16];
+  gboolean have_format = FALSE;
+  goffset pos;
+  gboolean ret = FALSE;
+  stream = g_file_read(file, NULL, err);
+  if (!stream) return FALSE;
+  in = G_INPUT_STREAM(stream);
+  if (!read_bytes(in, header, 12, err)) goto done;
+  if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+    g_set_error(err, WAV_FILE_ERROR, WAV_FILE_ERROR_FORMAT,
+		"Not a WAV file");
+    goto done;
+  }
+  pos = 12;
+  while(TRUE) {
+    guint32 size;
+    if (!read_bytes(in, header, 8, err)) goto done;
+    pos += 8;
+    size = read_le32(header + 4);
+    if (memcmp(header, "fmt ", 4) == 0) {
+      if (size < 16) {
+	g_set_error(err, WAV_FILE_ERROR, WAV_FILE_ERROR_FORMAT,
+		    "Short format chunk");
+	goto done;
+      }
+      if (!read_bytes(in, header, 16, err)) goto done;
+      pos += 16;
+      if (read_le16(header) != 1 || read_le16(header + 2) == 0
+	  || read_le16(header + 14) != 16) {
+	g_set_error(err, WAV_FILE_ERROR, WAV_FILE_ERROR_FORMAT,
+		    "Not 16 bit PCM");
+	goto done;
+      }
+      *channels = read_le16(header + 2);
+      *rate = read_le32(header + 4);
+      have_format = TRUE;
+      size -= 16;
+    } else if (memcmp(header, "data", 4) == 0) {
+      GFileInfo *info;
+      goffset file_size;
+      gsize read;
+      gsize n_samples;
+      if (!have_format) {
+	g_set_error(err, WAV_FILE_ERROR, WAV_FILE_ERROR_FORMAT,
+		    "No format before data");
+	goto done;
+      }
+      info = g_file_input_stream_query_info(stream,
+					    G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					    NULL, err);
+      if (!info) goto done;
+      file_size = g_file_info_get_size(info);
+      g_object_unref(info);
+      /* The size is written when recording ends */
+      if (size == 0 || size == 0xffffffff || pos + size > file_size) {
+	size = file_size - pos;
+      }
+      /* Whole frames only */
+      *n_frames = size / (2 * *channels);
+      n_samples = *n_frames * *channels;
+      *samples = g_new(gint16, n_samples);
+      if (!g_input_stream_read_all(in, *samples, n_samples * 2, &read,
+				   NULL, err)) {
+	g_free(*samples);
+	goto done;
+      }
+      *n_frames = read / (2 * *channels);
+#if G_BYTE_ORDER != G_LITTLE_ENDIAN
+      {
+	gsize i;
+	for (i = 0; i < *n_frames * *channels; i++) {
+	  (*samples)[i] = GINT16_FROM_LE((*samples)[i]);
+	}
+      }
+#endif
+      ret = TRUE;
+      goto done;
+    }
+    /* Chunks are padded to even length */
+    size += size & 1;
+    if (g_input_stream_skip(in, size, NULL, err) < 0) goto done;
+    pos += size;
+  }
+ done:
+  g_object_unref(stream);
+  return ret;
+}
+
+#define WRITE_CHUNK 4096 /* Samples */
+
+gboolean
+wav_file_write_s16(GFile *file, const gint16 *samples, gsize n_frames,
+		   guint channels, guint rate, GError **err)
+{
+  GFileOutputStream *stream;
+  GOutputStream *out;
+  guint8 header[44];
+  gsize n_samples = n_frames * channels;
+  guint32 data_size = n_samples * 2;
+  gboolean ret = FALSE;
+  memcpy(header, "RIFF", 4);
+  write_le32(header + 4, 36 + data_size);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  write_le32(header + 16, 16);
+  write_le16(header + 20, 1); /* PCM */
+  write_le16(header + 22, channels);
+  write_le32(header + 24, rate);
+  write_le32(header + 28, rate * 2 * channels); /* Byte rate */
+  write_le16(header + 32, 2 * channels); /* Block align */
+  write_le16(header + 34, 16); /* Bits per sample */
+  memcpy(header + 36, "data", 4);
+  write_le32(header + 40, data_size);
+  stream = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, err);
+  if (!stream) return FALSE;
+  out = G_OUTPUT_STREAM(stream);
+  if (!g_output_stream_write_all(out, header, sizeof(header), NULL, NULL, err)) {
+    goto done;
+  }
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  if (!g_output_stream_write_all(out, samples, data_size, NULL, NULL, err)) {
+    goto done;
+  }
+#else
+  while(n_samples > 0) {
+    gint16 chunk[WRITE_CHUNK];
+    gsize n = MIN(n_samples, WRITE_CHUNK);
+    gsize i;
+    for (i = 0; i < n; i++) chunk[i] = GINT16_TO_LE(samples[i]);
+    if (!g_output_stream_write_all(out, chunk, n * 2, NULL, NULL, err)) {
+      goto done;
+    }
+    samples += n;
+    n_samples -= n;
+  }
+#endif
+  ret = g_output_stream_close(out, NULL, err);
+ done:
+  g_object_unref(stream);
+  return ret;
+}
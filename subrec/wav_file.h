@@ -0,0 +1,32 @@
+#ifndef __WAV_FILE_H__Q8ZT3MXV0B__
+#define __WAV_FILE_H__Q8ZT3MXV0B__
+
+#include <gio/gio.h>
+#include <gst/gst.h>
+
+#define WAV_FILE_ERROR (wav_file_error_quark())
+enum {
+  WAV_FILE_ERROR_FORMAT = 1,
+};
+
+/* Duration of a WAV file, read from the header only. If the data size
+   in the header was never filled in, as after a crash during recording,
+   the data is assumed to extend to the end of the file. Blocks, so call
+   it from a worker thread. */
+gboolean
+wav_file_get_duration(GFile *file, GstClockTime *duration, GError **err);
+
+/* Read a 16 bit PCM WAV file. Channels are interleaved and n_frames
+   is the number of samples per channel. samples is freed with
+   g_free(). Blocks, so call it from a worker thread. */
+gboolean
+wav_file_read_s16(GFile *file, gint16 **samples, gsize *n_frames,
+		  guint *channels, guint *rate, GError **err);
+
+/* Write interleaved 16 bit PCM as a WAV file, replacing any existing
+   file. Blocks, so call it from a worker thread. */
+gboolean
+wav_file_write_s16(GFile *file, const gint16 *samples, gsize n_frames,
+		   guint channels, guint rate, GError **err);
+
+#endif /* __WAV_FILE_H__Q8ZT3MXV0B__ */
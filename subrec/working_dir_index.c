@@ -0,0 +1,469 @@
+#include <working_dir_index.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define QUERY_ATTRIBUTES \
+  G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+  G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+  G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+  G_FILE_ATTRIBUTE_TIME_MODIFIED
+
+#define ENUMERATE_BATCH 256
+
+G_DEFINE_TYPE (WorkingDirIndex, working_dir_index, G_TYPE_OBJECT)
+
+enum {
+  READY,
+  CHANGED,
+  LAST_SIGNAL
+};
+
+static guint working_dir_index_signals[LAST_SIGNAL] = {0 };
+
+static void
+working_dir_index_ready(WorkingDirIndex *index, gpointer user_data)
+{
+}
+
+static void
+working_dir_index_changed(WorkingDirIndex *index, const gchar *name,
+			  gpointer user_data)
+{
+}
+
+static void
+entry_free(WorkingDirIndexEntry *entry)
+{
+  g_free(entry->name);
+  g_free(entry->reel);
+  g_free(entry->spot);
+  g_free(entry);
+}
+
+/* Versions of one spot that have files in the index */
+typedef struct _SpotVersions SpotVersions;
+struct _SpotVersions
+{
+  guint max;
+  GHashTable *counts; /* Version -> number of files */
+};
+
+static void
+spot_versions_free(SpotVersions *versions)
+{
+  g_hash_table_destroy(versions->counts);
+  g_free(versions);
+}
+
+static void
+monitor_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+		GFileMonitorEvent event_type, WorkingDirIndex *index);
+
+static void
+working_dir_index_dispose(GObject *obj)
+{
+  WorkingDirIndex *index = WORKING_DIR_INDEX(obj);
+  /* Pending operations see the cancellation and leave the index alone */
+  if (index->cancellable) {
+    g_cancellable_cancel(index->cancellable);
+    g_clear_object(&index->cancellable);
+  }
+  if (index->monitor) {
+    g_signal_handlers_disconnect_by_func(index->monitor, monitor_changed,
+					 index);
+    g_file_monitor_cancel(index->monitor);
+    g_clear_object(&index->monitor);
+  }
+  g_clear_object(&index->directory);
+  G_OBJECT_CLASS (working_dir_index_parent_class)->dispose (obj);
+}
+
+static void
+working_dir_index_finalize(GObject *obj)
+{
+  WorkingDirIndex *index = WORKING_DIR_INDEX(obj);
+  g_hash_table_destroy(index->files);
+  g_hash_table_destroy(index->versions);
+  G_OBJECT_CLASS (working_dir_index_parent_class)->finalize (obj);
+}
+
+static void
+working_dir_index_class_init(WorkingDirIndexClass *obj_class)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (obj_class);
+  gobject_class->dispose = working_dir_index_dispose;
+  gobject_class->finalize = working_dir_index_finalize;
+  obj_class->ready = working_dir_index_ready;
+  obj_class->changed = working_dir_index_changed;
+
+  working_dir_index_signals[READY] =
+    g_signal_new("ready",
+		 G_OBJECT_CLASS_TYPE (obj_class), G_SIGNAL_RUN_LAST,
+		 G_STRUCT_OFFSET(WorkingDirIndexClass, ready),
+		 NULL, NULL,
+		 g_cclosure_marshal_VOID__VOID,
+		 G_TYPE_NONE, 0);
+  working_dir_index_signals[CHANGED] =
+    g_signal_new("changed",
+		 G_OBJECT_CLASS_TYPE (obj_class), G_SIGNAL_RUN_LAST,
+		 G_STRUCT_OFFSET(WorkingDirIndexClass, changed),
+		 NULL, NULL,
+		 g_cclosure_marshal_VOID__POINTER,
+		 G_TYPE_NONE, 1, G_TYPE_POINTER);
+}
+
+static void
+working_dir_index_init(WorkingDirIndex *index)
+{
+  index->directory = NULL;
+  index->monitor = NULL;
+  index->cancellable = g_cancellable_new();
+  index->files = g_hash_table_new_full(g_str_hash, g_str_equal,
+				       NULL, (GDestroyNotify)entry_free);
+  index->versions = g_hash_table_new_full(g_str_hash, g_str_equal,
+					  g_free,
+					  (GDestroyNotify)spot_versions_free);
+  index->ready = FALSE;
+}
+
+gboolean
+working_dir_index_parse_name(const gchar *name, gchar **reel, gchar **spot,
+			     guint *version, guint *mic, gboolean *raw)
+{
+  const gchar *end;
+  const gchar *p;
+  const gchar *version_start;
+  const gchar *spot_start;
+  gboolean is_raw = FALSE;
+  guint mic_number = 0;
+  gsize len = strlen(name);
+  if (len < 4 || g_ascii_strcasecmp(name + len - 4, ".wav") != 0) {
+    return FALSE;
+  }
+  end = name + len - 4;
+  if (end - name >= 4 && strncmp(end - 4, "_raw", 4) == 0) {
+    is_raw = TRUE;
+    end -= 4;
+  }
+  /* Microphone of a multi-mic take */
+  p = end;
+  while(p > name && g_ascii_isdigit(p[-1])) p--;
+  if (p != end && p - name >= 2 && p[-1] == 'm' && p[-2] == '_') {
+    mic_number = strtoul(p, NULL, 10);
+    end = p - 2;
+  }
+  /* Version */
+  p = end;
+  while(p > name && g_ascii_isdigit(p[-1])) p--;
+  if (p == end || p == name || p[-1] != '_') return FALSE;
+  version_start = p;
+  p--;
+  /* Spot */
+  spot_start = p;
+  while(spot_start > name && spot_start[-1] != '_') spot_start--;
+  if (spot_start == p || spot_start == name) return FALSE;
+  /* Reel is everything before the spot */
+  if (spot_start - 1 == name) return FALSE;
+  if (reel) *reel = g_strndup(name, spot_start - 1 - name);
+  if (spot) *spot = g_strndup(spot_start, p - spot_start);
+  if (version) *version = strtoul(version_start, NULL, 10);
+  if (mic) *mic = mic_number;
+  if (raw) *raw = is_raw;
+  return TRUE;
+}
+
+static gchar *
+version_key(const gchar *reel, const gchar *spot)
+{
+  return g_strconcat(reel, "_", spot, NULL);
+}
+
+static void
+add_version(WorkingDirIndex *index, const WorkingDirIndexEntry *entry)
+{
+  gchar *key = version_key(entry->reel, entry->spot);
+  gpointer version = GUINT_TO_POINTER(entry->version);
+  guint count;
+  SpotVersions *versions = g_hash_table_lookup(index->versions, key);
+  if (versions) {
+    g_free(key);
+  } else {
+    versions = g_new(SpotVersions, 1);
+    versions->max = 0;
+    versions->counts = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_hash_table_insert(index->versions, key, versions);
+  }
+  count = GPOINTER_TO_UINT(g_hash_table_lookup(versions->counts, version));
+  g_hash_table_insert(versions->counts, version, GUINT_TO_POINTER(count + 1));
+  if (entry->version > versions->max) versions->max = entry->version;
+}
+
+/* Called before the entry is removed from the index. Only when the
+   last file of the highest version goes do the remaining versions of
+   the spot have to be looked at. */
+static void
+remove_version(WorkingDirIndex *index, const WorkingDirIndexEntry *entry)
+{
+  gchar *key = version_key(entry->reel, entry->spot);
+  gpointer version = GUINT_TO_POINTER(entry->version);
+  guint count;
+  SpotVersions *versions = g_hash_table_lookup(index->versions, key);
+  if (!versions) {
+    g_free(key);
+    return;
+  }
+  count = GPOINTER_TO_UINT(g_hash_table_lookup(versions->counts, version));
+  if (count > 1) {
+    g_hash_table_insert(versions->counts, version,
+			GUINT_TO_POINTER(count - 1));
+  } else {
+    g_hash_table_remove(versions->counts, version);
+    if (g_hash_table_size(versions->counts) == 0) {
+      g_hash_table_remove(index->versions, key);
+    } else if (entry->version == versions->max) {
+      GHashTableIter iter;
+      gpointer v;
+      versions->max = 0;
+      g_hash_table_iter_init(&iter, versions->counts);
+      while(g_hash_table_iter_next(&iter, &v, NULL)) {
+	if (GPOINTER_TO_UINT(v) > versions->max) {
+	  versions->max = GPOINTER_TO_UINT(v);
+	}
+      }
+    }
+  }
+  g_free(key);
+}
+
+/* Returns the entry for name, creating it if the name is a clip name.
+   NULL otherwise. */
+static WorkingDirIndexEntry *
+get_entry(WorkingDirIndex *index, const gchar *name)
+{
+  WorkingDirIndexEntry *entry;
+  gchar *reel;
+  gchar *spot;
+  guint version;
+  guint mic;
+  gboolean raw;
+  entry = g_hash_table_lookup(index->files, name);
+  if (entry) return entry;
+  if (!working_dir_index_parse_name(name, &reel, &spot, &version, &mic,
+				    &raw)) {
+    return NULL;
+  }
+  entry = g_new(WorkingDirIndexEntry, 1);
+  entry->name = g_strdup(name);
+  entry->reel = reel;
+  entry->spot = spot;
+  entry->version = version;
+  entry->mic = mic;
+  entry->raw = raw;
+  entry->size = 0;
+  entry->mtime = 0;
+  g_hash_table_insert(index->files, entry->name, entry);
+  add_version(index, entry);
+  return entry;
+}
+
+static void
+add_info(WorkingDirIndex *index, GFileInfo *info)
+{
+  WorkingDirIndexEntry *entry;
+  const gchar *name;
+  if (g_file_info_get_file_type(info) != G_FILE_TYPE_REGULAR) return;
+  name = g_file_info_get_name(info);
+  entry = get_entry(index, name);
+  if (!entry) return;
+  entry->size = g_file_info_get_size(info);
+  entry->mtime =
+    g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  if (index->ready) {
+    g_signal_emit(index, working_dir_index_signals[CHANGED], 0, entry->name);
+  }
+}
+
+static void
+remove_name(WorkingDirIndex *index, const gchar *name)
+{
+  WorkingDirIndexEntry *entry;
+  entry = g_hash_table_lookup(index->files, name);
+  if (!entry) return;
+  remove_version(index, entry);
+  g_hash_table_remove(index->files, name);
+  if (index->ready) {
+    g_signal_emit(index, working_dir_index_signals[CHANGED], 0, name);
+  }
+}
+
+static void
+next_files_cb(GObject *source, GAsyncResult *res, gpointer user_data);
+
+static void
+request_next_files(WorkingDirIndex *index, GFileEnumerator *enumerator)
+{
+  g_file_enumerator_next_files_async(enumerator, ENUMERATE_BATCH,
+				     G_PRIORITY_LOW, index->cancellable,
+				     next_files_cb, index);
+}
+
+static void
+next_files_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+  GFileEnumerator *enumerator = G_FILE_ENUMERATOR(source);
+  WorkingDirIndex *index;
+  GError *err = NULL;
+  GList *files;
+  GList *f;
+  files = g_file_enumerator_next_files_finish(enumerator, res, &err);
+  if (err) {
+    if (!g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_warning("Failed to read working directory: %s", err->message);
+    }
+    g_error_free(err);
+    g_object_unref(enumerator);
+    return;
+  }
+  index = user_data;
+  if (!files) {
+    /* Done */
+    g_file_enumerator_close_async(enumerator, G_PRIORITY_LOW, NULL,
+				  NULL, NULL);
+    g_object_unref(enumerator);
+    index->ready = TRUE;
+    g_debug("Working directory index ready, %u clip files",
+	    g_hash_table_size(index->files));
+    g_signal_emit(index, working_dir_index_signals[READY], 0);
+    return;
+  }
+  for (f = files; f; f = f->next) {
+    add_info(index, f->data);
+    g_object_unref(f->data);
+  }
+  g_list_free(files);
+  request_next_files(index, enumerator);
+}
+
+static void
+enumerate_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+  GFileEnumerator *enumerator;
+  GError *err = NULL;
+  enumerator = g_file_enumerate_children_finish(G_FILE(source), res, &err);
+  if (!enumerator) {
+    if (!g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_warning("Failed to read working directory: %s", err->message);
+    }
+    g_error_free(err);
+    return;
+  }
+  request_next_files(user_data, enumerator);
+}
+
+static void
+query_info_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+  GFileInfo *info;
+  GError *err = NULL;
+  info = g_file_query_info_finish(G_FILE(source), res, &err);
+  if (!info) {
+    /* The file may already be gone again, the monitor will tell */
+    g_error_free(err);
+    return;
+  }
+  add_info(user_data, info);
+  g_object_unref(info);
+}
+
+static void
+monitor_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+		GFileMonitorEvent event_type, WorkingDirIndex *index)
+{
+  gchar *name = g_file_get_basename(file);
+  switch(event_type) {
+  case G_FILE_MONITOR_EVENT_CREATED:
+  case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+  case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+    if (working_dir_index_parse_name(name, NULL, NULL, NULL, NULL, NULL)) {
+      g_file_query_info_async(file, QUERY_ATTRIBUTES,
+			      G_FILE_QUERY_INFO_NONE, G_PRIORITY_LOW,
+			      index->cancellable, query_info_cb, index);
+    }
+    break;
+  case G_FILE_MONITOR_EVENT_DELETED:
+    remove_name(index, name);
+    break;
+  default:
+    break;
+  }
+  g_free(name);
+}
+
+WorkingDirIndex *
+working_dir_index_new(GFile *directory)
+{
+  GError *err = NULL;
+  WorkingDirIndex *index = g_object_new(WORKING_DIR_INDEX_TYPE, NULL);
+  index->directory = directory;
+  g_object_ref(directory);
+  /* Start monitoring first so no change is missed while reading */
+  index->monitor = g_file_monitor_directory(directory, G_FILE_MONITOR_NONE,
+					    index->cancellable, &err);
+  if (index->monitor) {
+    g_signal_connect(index->monitor, "changed",
+		     G_CALLBACK(monitor_changed), index);
+  } else {
+    g_warning("Can't monitor working directory: %s", err->message);
+    g_clear_error(&err);
+  }
+  g_file_enumerate_children_async(directory, QUERY_ATTRIBUTES,
+				  G_FILE_QUERY_INFO_NONE, G_PRIORITY_LOW,
+				  index->cancellable, enumerate_cb, index);
+  return index;
+}
+
+gboolean
+working_dir_index_is_ready(WorkingDirIndex *index)
+{
+  return index->ready;
+}
+
+const WorkingDirIndexEntry *
+working_dir_index_lookup(WorkingDirIndex *index, const gchar *name)
+{
+  return g_hash_table_lookup(index->files, name);
+}
+
+guint
+working_dir_index_next_version(WorkingDirIndex *index,
+			       const gchar *reel, const gchar *spot)
+{
+  gchar *key = version_key(reel, spot);
+  SpotVersions *versions = g_hash_table_lookup(index->versions, key);
+  g_free(key);
+  return (versions ? versions->max : 0) + 1;
+}
+
+void
+working_dir_index_add_name(WorkingDirIndex *index, const gchar *name)
+{
+  get_entry(index, name);
+}
+
+void
+working_dir_index_remove_name(WorkingDirIndex *index, const gchar *name)
+{
+  remove_name(index, name);
+}
+
+void
+working_dir_index_foreach(WorkingDirIndex *index, WorkingDirIndexFunc func,
+			  gpointer user_data)
+{
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, index->files);
+  while(g_hash_table_iter_next(&iter, NULL, &value)) {
+    func(value, user_data);
+  }
+}
@@ -0,0 +1,108 @@
+#ifndef __WORKING_DIR_INDEX_H__P5JD2CW8NE__
+#define __WORKING_DIR_INDEX_H__P5JD2CW8NE__
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+/* Index of the clip files (reel_spot_N.wav and reel_spot_N_raw.wav,
+   with _mK after the version for microphone K of a multi-mic take)
+   in a working directory. The directory is read asynchronously and
+   kept current with a file monitor, so lookups never touch the disk. */
+
+#define WORKING_DIR_INDEX_TYPE (working_dir_index_get_type ())
+#define WORKING_DIR_INDEX(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), WORKING_DIR_INDEX_TYPE, WorkingDirIndex))
+#define IS_WORKING_DIR_INDEX(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), WORKING_DIR_INDEX_TYPE))
+#define WORKING_DIR_INDEX_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), WORKING_DIR_INDEX_TYPE, WorkingDirIndexClass))
+#define IS_WORKING_DIR_INDEX_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), WORKING_DIR_INDEX_TYPE))
+#define WORKING_DIR_INDEX_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), WORKING_DIR_INDEX_TYPE, WorkingDirIndexClass))
+
+typedef struct _WorkingDirIndex        WorkingDirIndex;
+typedef struct _WorkingDirIndexClass   WorkingDirIndexClass;
+typedef struct _WorkingDirIndexEntry   WorkingDirIndexEntry;
+
+struct _WorkingDirIndexEntry
+{
+  gchar *name; /* File name without directory */
+  gchar *reel;
+  gchar *spot;
+  guint version;
+  guint mic; /* Microphone of a multi-mic take, otherwise 0 */
+  gboolean raw; /* Unprocessed recording */
+  goffset size;
+  guint64 mtime; /* Seconds since the epoch */
+};
+
+struct _WorkingDirIndex
+{
+  GObject parent_instance;
+
+  /* instance members */
+  GFile *directory;
+  GFileMonitor *monitor;
+  GCancellable *cancellable;
+  GHashTable *files; /* Name -> WorkingDirIndexEntry */
+  GHashTable *versions; /* "reel_spot" -> versions present for the spot */
+  gboolean ready;
+};
+
+struct _WorkingDirIndexClass
+{
+  GObjectClass parent_class;
+
+  /* Signals */
+  /* The whole directory has been read */
+  void (*ready)(WorkingDirIndex *index, gpointer user_data);
+  /* A clip file was added, changed or removed */
+  void (*changed)(WorkingDirIndex *index, const gchar *name,
+		  gpointer user_data);
+};
+
+GType working_dir_index_get_type (void);
+
+typedef void (*WorkingDirIndexFunc)(const WorkingDirIndexEntry *entry,
+				    gpointer user_data);
+
+WorkingDirIndex *
+working_dir_index_new(GFile *directory);
+
+gboolean
+working_dir_index_is_ready(WorkingDirIndex *index);
+
+/* NULL if the file isn't a known clip */
+const WorkingDirIndexEntry *
+working_dir_index_lookup(WorkingDirIndex *index, const gchar *name);
+
+/* The lowest version higher than all existing takes of the spot. Only
+   valid when the index is ready. */
+guint
+working_dir_index_next_version(WorkingDirIndex *index,
+			       const gchar *reel, const gchar *spot);
+
+/* Record a file that is about to be created, so that its version
+   isn't handed out again before the monitor reports it */
+void
+working_dir_index_add_name(WorkingDirIndex *index, const gchar *name);
+
+/* Forget a name recorded with working_dir_index_add_name() when the
+   file won't be created after all */
+void
+working_dir_index_remove_name(WorkingDirIndex *index, const gchar *name);
+
+void
+working_dir_index_foreach(WorkingDirIndex *index, WorkingDirIndexFunc func,
+			  gpointer user_data);
+
+/* Split a name of the form reel_spot_N.wav or reel_spot_N_raw.wav,
+   optionally with _mK after N. mic is 0 without it. The reel may
+   contain underscores, so the name is parsed from the right. Returns
+   FALSE if the name doesn't match. */
+gboolean
+working_dir_index_parse_name(const gchar *name, gchar **reel, gchar **spot,
+			     guint *version, guint *mic, gboolean *raw);
+
+#endif /* __WORKING_DIR_INDEX_H__P5JD2CW8NE__ */
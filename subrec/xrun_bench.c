@@ -0,0 +1,450 @@
+/* Stress benchmark for capture dropouts.
+
+   Plays a WAV file through a fake capture source, paced in real time.
+   The source is built on GstAudioSrc like alsasrc, so it has the same
+   ring buffer and honours buffer-time and latency-time. Load is added
+   with CPU burning threads and with random stalls in the streaming
+   thread, and the dropouts found by the dropout detector are counted.
+
+   Without --input a 10 s tone is generated. Run it with different
+   buffer and latency times to find the smallest ones that survive the
+   load. */
+
+#include <dropout_detector.h>
+#include <wav_file.h>
+#include <gst/gst.h>
+#include <gst/audio/gstaudiosrc.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#define SAMPLE_RATE 48000
+
+static gchar *input_path = NULL;
+static gint64 buffer_time = 200000;
+static gint64 latency_time = 10000;
+static gdouble duration = 30.0;
+static gint load_threads = -1;
+static gdouble load = 0.9;
+static gint stall_ms = 0;
+static gdouble stall_interval = 1.0;
+static gint seed = 4711;
+
+static GOptionEntry entries[] = {
+  {"input", 'i', 0, G_OPTION_ARG_FILENAME, &input_path,
+   "Mono 16 bit 48kHz WAV file to play", "FILE"},
+  {"buffer-time", 'b', 0, G_OPTION_ARG_INT64, &buffer_time,
+   "Capture buffer size in microseconds", "US"},
+  {"latency-time", 'l', 0, G_OPTION_ARG_INT64, &latency_time,
+   "Capture period in microseconds", "US"},
+  {"duration", 'd', 0, G_OPTION_ARG_DOUBLE, &duration,
+   "Seconds to run", "S"},
+  {"threads", 't', 0, G_OPTION_ARG_INT, &load_threads,
+   "Number of load threads, default one per processor", "N"},
+  {"load", 'L', 0, G_OPTION_ARG_DOUBLE, &load,
+   "Fraction of time each load thread is busy", "F"},
+  {"stall", 's', 0, G_OPTION_ARG_INT, &stall_ms,
+   "Stall the streaming thread this long", "MS"},
+  {"stall-interval", 'S', 0, G_OPTION_ARG_DOUBLE, &stall_interval,
+   "Mean seconds between stalls", "S"},
+  {"seed", 'r', 0, G_OPTION_ARG_INT, &seed,
+   "Random seed for the stalls", "N"},
+  {NULL}
+};
+
+/* Fake capture source */
+
+#define FILE_AUDIO_SRC_TYPE (file_audio_src_get_type())
+
+typedef struct
+{
+  GstAudioSrc parent;
+  const guint8 *data; /* Looped */
+  gsize size;
+  gsize pos;
+  guint byte_rate;
+  gint64 start; /* Monotonic time of the first read */
+  guint64 delivered; /* Bytes */
+} FileAudioSrc;
+
+typedef struct
+{
+  GstAudioSrcClass parent_class;
+} FileAudioSrcClass;
+
+GType file_audio_src_get_type(void);
+
+G_DEFINE_TYPE (FileAudioSrc, file_audio_src, GST_TYPE_AUDIO_SRC)
+
+static GstStaticPadTemplate src_template =
+  GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+			   GST_STATIC_CAPS ("audio/x-raw-int, "
+					    "endianness = (int) 1234, "
+					    "signed = (boolean) true, "
+					    "width = (int) 16, "
+					    "depth = (int) 16, "
+					    "rate = (int) 48000, "
+					    "channels = (int) 1"));
+
+static gboolean
+file_audio_src_open(GstAudioSrc *src)
+{
+  return TRUE;
+}
+
+static gboolean
+file_audio_src_close(GstAudioSrc *src)
+{
+  return TRUE;
+}
+
+static gboolean
+file_audio_src_prepare(GstAudioSrc *src, GstRingBufferSpec *spec)
+{
+  FileAudioSrc *fsrc = (FileAudioSrc*)src;
+  fsrc->byte_rate = spec->rate * spec->bytes_per_sample;
+  fsrc->start = 0;
+  fsrc->delivered = 0;
+  return TRUE;
+}
+
+static gboolean
+file_audio_src_unprepare(GstAudioSrc *src)
+{
+  return TRUE;
+}
+
+/* Blocks until the data would have been captured */
+static guint
+file_audio_src_read(GstAudioSrc *src, gpointer data, guint length)
+{
+  FileAudioSrc *fsrc = (FileAudioSrc*)src;
+  guint8 *out = data;
+  guint left = length;
+  gint64 due;
+  gint64 now;
+  if (fsrc->start == 0) fsrc->start = g_get_monotonic_time();
+  fsrc->delivered += length;
+  due = fsrc->start + fsrc->delivered * G_USEC_PER_SEC / fsrc->byte_rate;
+  now = g_get_monotonic_time();
+  if (due > now) g_usleep(due - now);
+  while(left > 0) {
+    gsize n = MIN(left, fsrc->size - fsrc->pos);
+    memcpy(out, fsrc->data + fsrc->pos, n);
+    out += n;
+    left -= n;
+    fsrc->pos = (fsrc->pos + n) % fsrc->size;
+  }
+  return length;
+}
+
+static guint
+file_audio_src_delay(GstAudioSrc *src)
+{
+  return 0;
+}
+
+static void
+file_audio_src_reset(GstAudioSrc *src)
+{
+}
+
+static void
+file_audio_src_class_init(FileAudioSrcClass *klass)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+  GstAudioSrcClass *audio_src_class = GST_AUDIO_SRC_CLASS(klass);
+  gst_element_class_add_pad_template(element_class,
+				     gst_static_pad_template_get(&src_template));
+  gst_element_class_set_details_simple(element_class,
+				       "File audio source", "Source/Audio",
+				       "Plays a file in real time",
+				       "subrec");
+  audio_src_class->open = file_audio_src_open;
+  audio_src_class->prepare = file_audio_src_prepare;
+  audio_src_class->unprepare = file_audio_src_unprepare;
+  audio_src_class->close = file_audio_src_close;
+  audio_src_class->read = file_audio_src_read;
+  audio_src_class->delay = file_audio_src_delay;
+  audio_src_class->reset = file_audio_src_reset;
+}
+
+static void
+file_audio_src_init(FileAudioSrc *fsrc)
+{
+  fsrc->data = NULL;
+  fsrc->size = 0;
+  fsrc->pos = 0;
+}
+
+/* Load */
+
+static volatile gint stop_load = 0;
+
+static gpointer
+burn_cpu(gpointer data)
+{
+  volatile gdouble x = 0.0;
+  while(!g_atomic_int_get(&stop_load)) {
+    gint64 busy_end = g_get_monotonic_time() + (gint64)(load * 10000);
+    while(g_get_monotonic_time() < busy_end) {
+      x = sin(x + 1.0);
+    }
+    if (load < 1.0) g_usleep((1.0 - load) * 10000);
+  }
+  return NULL;
+}
+
+typedef struct
+{
+  GRand *rand;
+  gint64 next_stall;
+  guint stalls;
+} StallState;
+
+static gint64
+stall_gap(GRand *rand)
+{
+  return -stall_interval * log(1.0 - g_rand_double(rand)) * G_USEC_PER_SEC;
+}
+
+/* Called from the streaming thread */
+static gboolean
+stall_probe(GstPad *pad, GstBuffer *buffer, gpointer user_data)
+{
+  StallState *state = user_data;
+  gint64 now = g_get_monotonic_time();
+  if (now >= state->next_stall) {
+    g_usleep(stall_ms * 1000);
+    state->stalls++;
+    state->next_stall = g_get_monotonic_time() + stall_gap(state->rand);
+  }
+  return TRUE;
+}
+
+/* Results */
+
+static GMainLoop *main_loop = NULL;
+static guint n_dropouts = 0;
+static guint n_unknown = 0; /* Dropouts of unknown length */
+static GstClockTime missing = 0;
+static GstClockTime longest = 0;
+static gboolean run_failed = FALSE;
+
+static gboolean
+bus_call(GstBus *bus, GstMessage *msg, gpointer data)
+{
+  switch (GST_MESSAGE_TYPE(msg)) {
+  case GST_MESSAGE_EOS:
+    g_main_loop_quit(main_loop);
+    break;
+  case GST_MESSAGE_ERROR: {
+    GError *err = NULL;
+    gst_message_parse_error(msg, &err, NULL);
+    g_printerr("Error: %s\n", err->message);
+    g_error_free(err);
+    run_failed = TRUE;
+    g_main_loop_quit(main_loop);
+    break;
+  }
+  case GST_MESSAGE_ELEMENT:
+    if (strcmp(gst_structure_get_name(msg->structure),
+	       DROPOUT_MESSAGE) == 0) {
+      GstClockTime length = 0;
+      gst_structure_get_clock_time(msg->structure, DROPOUT_MESSAGE_LENGTH,
+				   &length);
+      n_dropouts++;
+      if (length == 0) n_unknown++;
+      missing += length;
+      if (length > longest) longest = length;
+    }
+    break;
+  default:
+    break;
+  }
+  return TRUE;
+}
+
+static gboolean
+stop_run(gpointer data)
+{
+  GstElement *pipeline = data;
+  gst_element_send_event(pipeline, gst_event_new_eos());
+  return FALSE;
+}
+
+static guint32
+get_le32(const guint8 *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((guint32)p[3] << 24);
+}
+
+/* Finds the data chunk, returns NULL if there is none */
+static const guint8 *
+find_data(const gchar *contents, gsize length, gsize *size)
+{
+  const guint8 *p = (const guint8*)contents + 12;
+  const guint8 *end = (const guint8*)contents + length;
+  if (length < 12 || memcmp(contents, "RIFF", 4) != 0) return NULL;
+  while(p + 8 <= end) {
+    guint32 chunk = get_le32(p + 4);
+    if (memcmp(p, "data", 4) == 0) {
+      *size = MIN(chunk, (gsize)(end - p - 8)) & ~(gsize)1;
+      return p + 8;
+    }
+    p += 8 + chunk + (chunk & 1);
+  }
+  return NULL;
+}
+
+static gchar *
+generate_tone(GError **err)
+{
+  gchar *path;
+  GFile *file;
+  gint16 *samples = g_new(gint16, 10 * SAMPLE_RATE);
+  gint fd;
+  guint i;
+  gboolean ok;
+  fd = g_file_open_tmp("xrun_bench_XXXXXX.wav", &path, err);
+  if (fd < 0) {
+    g_free(samples);
+    return NULL;
+  }
+  close(fd);
+  for (i = 0; i < 10 * SAMPLE_RATE; i++) {
+    samples[i] = 8000 * sin(2 * G_PI * 440 * i / SAMPLE_RATE);
+  }
+  file = g_file_new_for_path(path);
+  ok = wav_file_write_s16(file, samples, 10 * SAMPLE_RATE, 1, SAMPLE_RATE,
+			  err);
+  g_object_unref(file);
+  g_free(samples);
+  if (!ok) {
+    g_unlink(path);
+    g_free(path);
+    return NULL;
+  }
+  return path;
+}
+
+int
+main(int argc, char *argv[])
+{
+  GOptionContext *context;
+  GError *err = NULL;
+  gchar *path;
+  gchar *contents;
+  gsize length;
+  GstElement *pipeline;
+  GstElement *input;
+  GstElement *convert;
+  GstElement *sink;
+  GstBus *bus;
+  GstPad *pad;
+  GThread **threads;
+  StallState stall;
+  gint i;
+  gdouble elapsed;
+  gint64 start_time;
+
+  context = g_option_context_new(" - capture dropout benchmark");
+  g_option_context_add_main_entries(context, entries, NULL);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &err)) {
+    g_printerr("%s\n", err->message);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+  if (load_threads < 0) load_threads = g_get_num_processors();
+  load = CLAMP(load, 0.0, 1.0);
+
+  path = input_path ? g_strdup(input_path) : generate_tone(&err);
+  if (!path || !g_file_get_contents(path, &contents, &length, &err)) {
+    g_printerr("Failed to read input: %s\n", err->message);
+    return EXIT_FAILURE;
+  }
+  if (!input_path) g_unlink(path);
+
+  pipeline = gst_pipeline_new("capture");
+  input = g_object_new(FILE_AUDIO_SRC_TYPE, "name", "input", NULL);
+  ((FileAudioSrc*)input)->data = find_data(contents, length,
+					   &((FileAudioSrc*)input)->size);
+  if (!((FileAudioSrc*)input)->data || ((FileAudioSrc*)input)->size == 0) {
+    g_printerr("No audio data in %s\n", path);
+    return EXIT_FAILURE;
+  }
+  g_object_set(input,
+	       "buffer-time", buffer_time,
+	       "latency-time", latency_time,
+	       NULL);
+  dropout_detector_attach(input);
+  convert = gst_element_factory_make("audioconvert", "convert");
+  sink = gst_element_factory_make("fakesink", "sink");
+  if (!convert || !sink) {
+    g_printerr("Failed to create elements\n");
+    return EXIT_FAILURE;
+  }
+  g_object_set(sink, "sync", FALSE, NULL);
+  gst_bin_add_many(GST_BIN(pipeline), input, convert, sink, NULL);
+  if (!gst_element_link_many(input, convert, sink, NULL)) {
+    g_printerr("Failed to link pipeline\n");
+    return EXIT_FAILURE;
+  }
+
+  stall.rand = g_rand_new_with_seed(seed);
+  stall.next_stall = g_get_monotonic_time() + stall_gap(stall.rand);
+  stall.stalls = 0;
+  if (stall_ms > 0) {
+    pad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_buffer_probe(pad, G_CALLBACK(stall_probe), &stall);
+    gst_object_unref(pad);
+  }
+
+  main_loop = g_main_loop_new(NULL, FALSE);
+  bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+  gst_bus_add_watch(bus, bus_call, NULL);
+  gst_object_unref(bus);
+
+  g_print("Buffer time %.1f ms, latency time %.1f ms\n",
+	  buffer_time * 1e-3, latency_time * 1e-3);
+  g_print("%d load threads at %.0f%%, %d ms stalls every %.1f s\n",
+	  load_threads, load * 100, stall_ms, stall_interval);
+
+  threads = g_new(GThread*, load_threads);
+  for (i = 0; i < load_threads; i++) {
+    threads[i] = g_thread_new("load", burn_cpu, NULL);
+  }
+
+  start_time = g_get_monotonic_time();
+  if (gst_element_set_state(pipeline, GST_STATE_PLAYING)
+      == GST_STATE_CHANGE_FAILURE) {
+    g_printerr("Failed to start pipeline\n");
+    return EXIT_FAILURE;
+  }
+  g_timeout_add(duration * 1000, stop_run, pipeline);
+  g_main_loop_run(main_loop);
+  elapsed = (g_get_monotonic_time() - start_time) * 1e-6;
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+
+  g_atomic_int_set(&stop_load, 1);
+  for (i = 0; i < load_threads; i++) {
+    g_thread_join(threads[i]);
+  }
+
+  g_print("Ran %.1f s, %u stalls\n", elapsed, stall.stalls);
+  g_print("Dropouts: %u (%u of unknown length)\n", n_dropouts, n_unknown);
+  g_print("Missing: %.1f ms (%.3f%%), longest %.1f ms\n",
+	  missing * 1e-6, missing * 1e-7 / elapsed, longest * 1e-6);
+  g_print("Dropouts per minute: %.2f\n", n_dropouts * 60.0 / elapsed);
+
+  gst_object_unref(pipeline);
+  g_main_loop_unref(main_loop);
+  g_rand_free(stall.rand);
+  g_free(threads);
+  g_free(contents);
+  g_free(path);
+  return run_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}